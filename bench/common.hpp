@@ -0,0 +1,156 @@
+#ifndef TCX_BENCH_COMMON_HPP
+#define TCX_BENCH_COMMON_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <pthread.h>
+
+#include <tcx/services/uring_statistics.hpp>
+
+/**
+ * Utilities shared by the benchmarks, options are given as `--name=value` and lists as `--name=a,b,c`
+ */
+namespace bench {
+
+using histogram = tcx::latency_histogram_snapshot;
+
+inline std::uint64_t now() noexcept
+{
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+inline void merge(histogram &into, histogram const &from) noexcept
+{
+    for (std::size_t i = 0; i < histogram::bucket_count; ++i)
+        into.counts[i] += from.counts[i];
+}
+
+inline void record(histogram &into, std::uint64_t nanoseconds) noexcept
+{
+    ++into.counts[histogram::bucket_index(nanoseconds)];
+}
+
+/**
+ * @brief keeps the compiler from optimizing away the computation of `value`
+ */
+template <typename T>
+inline void do_not_optimize(T &value) noexcept
+{
+    asm volatile("" : "+m"(value) : : "memory");
+}
+
+/**
+ * @brief CPU time consumed by `thread` so far, in nanoseconds
+ */
+inline std::uint64_t thread_cpu_time(pthread_t thread)
+{
+    clockid_t clock;
+    if (int const error = pthread_getcpuclockid(thread, &clock); error != 0)
+        throw std::system_error(error, std::system_category(), "pthread_getcpuclockid");
+    timespec ts {};
+    clock_gettime(clock, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1'000'000'000u + static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+/**
+ * @brief CPU time consumed by the whole process so far, in nanoseconds
+ */
+inline std::uint64_t process_cpu_time()
+{
+    timespec ts {};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1'000'000'000u + static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+class options {
+public:
+    options(int argc, char **argv)
+        : m_args(argv + 1, argv + argc)
+    {
+    }
+
+    [[nodiscard]] bool flag(std::string_view name) const
+    {
+        for (std::string_view arg : m_args) {
+            if (arg.starts_with("--") && arg.substr(2) == name)
+                return true;
+        }
+        return false;
+    }
+
+    [[nodiscard]] std::string get(std::string_view name, std::string fallback) const
+    {
+        for (std::string_view arg : m_args) {
+            if (arg.starts_with("--") && arg.substr(2).starts_with(name) && arg.substr(2 + name.size()).starts_with('='))
+                return std::string(arg.substr(3 + name.size()));
+        }
+        return fallback;
+    }
+
+    [[nodiscard]] double get(std::string_view name, double fallback) const
+    {
+        auto const value = get(name, std::string());
+        return value.empty() ? fallback : std::strtod(value.c_str(), nullptr);
+    }
+
+    [[nodiscard]] std::vector<std::string> list(std::string_view name, std::string fallback) const
+    {
+        auto const value = get(name, std::move(fallback));
+        std::vector<std::string> result;
+        std::size_t begin = 0;
+        while (begin <= value.size()) {
+            auto end = value.find(',', begin);
+            if (end == std::string::npos)
+                end = value.size();
+            if (end != begin)
+                result.emplace_back(value, begin, end - begin);
+            begin = end + 1;
+        }
+        return result;
+    }
+
+    /**
+     * @brief list of sizes, accepting `K`, `M` and `G` suffixes
+     */
+    [[nodiscard]] std::vector<std::size_t> sizes(std::string_view name, std::string fallback) const
+    {
+        std::vector<std::size_t> result;
+        for (auto const &item : list(name, std::move(fallback))) {
+            char *end = nullptr;
+            auto value = std::strtoull(item.c_str(), &end, 10);
+            switch (*end) {
+            case 'G':
+            case 'g':
+                value *= 1024;
+                [[fallthrough]];
+            case 'M':
+            case 'm':
+                value *= 1024;
+                [[fallthrough]];
+            case 'K':
+            case 'k':
+                value *= 1024;
+                break;
+            default:
+                break;
+            }
+            result.push_back(static_cast<std::size_t>(value));
+        }
+        return result;
+    }
+
+private:
+    std::vector<std::string_view> m_args;
+};
+
+} // namespace bench
+
+#endif
@@ -0,0 +1,399 @@
+/**
+ * Microbenchmarks of the pieces every completion goes through.
+ *
+ * - `function`: `tcx::unique_function` against `std::function` and `std::move_only_function`,
+ *   constructing, moving, invoking and swapping, with captures that fit the inline storage and captures that don't.
+ * - `executor`: `post()` to `run()` throughput and latency of both execution contexts.
+ *   The unsynchronized context posts batches and runs them from the same thread,
+ *   the synchronized one has `--producers` threads posting while a single thread blocks in `run()`.
+ *   `tcx::thread_pool` with `--workers` threads runs `--queue-limit` chains of handlers that each post the next one,
+ *   started from outside the pool, so most posts land on the posting worker and idle workers steal.
+ * - `framing`: splitting a buffer of `--message-sizes` byte messages on `\n`, `\r\n` and `\r\n\r\n`
+ *   with `tcx::utilities::find_delimiter()` for every instruction set the CPU supports, against a byte loop and `memmem()`.
+ *
+ * Producers stop posting while `--queue-limit` handlers are queued, which bounds the measured latency.
+ *
+ * Usage: bench_micro [--suites=function,executor,framing] [--iterations=1000000] [--producers=1,2,4,8] [--workers=1,2,4]
+ *                    [--queue-limit=256] [--message-sizes=16,64,1K] [--duration=1] [--json]
+ */
+
+#include "common.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include <tcx/synchronized_execution_context.hpp>
+#include <tcx/strand.hpp>
+#include <tcx/thread_pool.hpp>
+#include <tcx/unique_function.hpp>
+#include <tcx/unsynchronized_execution_context.hpp>
+#include <tcx/utilities/find_delimiter.hpp>
+
+namespace {
+
+bool json = false;
+bool first_result = true;
+
+void report(char const *suite, char const *name, char const *variant, char const *metric, double value)
+{
+    if (json) {
+        std::printf("%s  {\"suite\":\"%s\",\"name\":\"%s\",\"variant\":\"%s\",\"%s\":%.3f}", first_result ? "" : ",\n", suite, name, variant, metric, value);
+    } else {
+        std::printf("%-9s %-22s %-26s %12.3f %s\n", suite, name, variant, value, metric);
+    }
+    std::fflush(stdout);
+    first_result = false;
+}
+
+// best of a few repetitions, in nanoseconds per iteration
+template <typename F>
+double measure(std::size_t iterations, F &&body)
+{
+    double best = 1e300;
+    for (int repetition = 0; repetition < 5; ++repetition) {
+        std::uint64_t const begin = bench::now();
+        for (std::size_t i = 0; i < iterations; ++i)
+            body();
+        std::uint64_t const end = bench::now();
+        best = std::min(best, static_cast<double>(end - begin) / static_cast<double>(iterations));
+    }
+    return best;
+}
+
+struct inline_capture {
+    std::uint64_t *counter;
+    std::uint64_t increment = 1;
+
+    void operator()() const noexcept
+    {
+        *counter += increment;
+    }
+};
+
+struct heap_capture {
+    std::uint64_t *counter;
+    std::array<char, 120> payload {};
+
+    void operator()() const noexcept
+    {
+        *counter += static_cast<std::uint64_t>(payload[0]) + 1;
+    }
+};
+
+template <typename Function, typename Callable>
+void run_function_suite(char const *name, char const *variant, std::size_t iterations)
+{
+    std::uint64_t counter = 0;
+    Callable const callable { &counter };
+
+    report("function", name, variant, "ns/construct", measure(iterations, [&] {
+        Function f(callable);
+        bench::do_not_optimize(f);
+    }));
+
+    Function a(callable);
+    Function b(callable);
+    report("function", name, variant, "ns/move", measure(iterations, [&] {
+        b = std::move(a);
+        bench::do_not_optimize(b);
+        a = std::move(b);
+        bench::do_not_optimize(a);
+    }) / 2);
+
+    report("function", name, variant, "ns/invoke", measure(iterations, [&] {
+        a();
+        bench::do_not_optimize(a);
+    }));
+
+    Function c(callable);
+    report("function", name, variant, "ns/swap", measure(iterations, [&] {
+        using std::swap;
+        swap(a, c);
+        bench::do_not_optimize(a);
+    }));
+    bench::do_not_optimize(counter);
+}
+
+template <typename Callable>
+void run_function_suites(char const *variant, std::size_t iterations)
+{
+    run_function_suite<tcx::unique_function<void()>, Callable>("tcx::unique_function", variant, iterations);
+    run_function_suite<std::function<void()>, Callable>("std::function", variant, iterations);
+#if defined(__cpp_lib_move_only_function)
+    run_function_suite<std::move_only_function<void()>, Callable>("std::move_only_function", variant, iterations);
+#endif
+}
+
+void run_unsynchronized(double duration)
+{
+    // latency includes waiting for the rest of the batch to be posted
+    constexpr std::size_t batch_size = 64;
+    tcx::unsynchronized_execution_context executor;
+    bench::histogram latency;
+    std::uint64_t executed = 0;
+
+    std::uint64_t const begin = bench::now();
+    std::uint64_t const deadline = begin + static_cast<std::uint64_t>(duration * 1e9);
+    std::uint64_t end;
+    do {
+        for (std::size_t i = 0; i < batch_size; ++i) {
+            executor.post([&latency, &executed, posted = bench::now()] {
+                bench::record(latency, bench::now() - posted);
+                ++executed;
+            });
+        }
+        executor.run();
+        end = bench::now();
+    } while (end < deadline);
+
+    char const *const name = "unsynchronized";
+    report("executor", name, "1 producer", "handlers/s", static_cast<double>(executed) / (static_cast<double>(end - begin) / 1e9));
+    report("executor", name, "1 producer", "p50 ns", static_cast<double>(latency.percentile(0.5)));
+    report("executor", name, "1 producer", "p99 ns", static_cast<double>(latency.percentile(0.99)));
+}
+
+void run_synchronized(std::size_t producer_count, std::int64_t max_queued, double duration)
+{
+    tcx::synchronized_execution_context executor;
+    bench::histogram latency;
+    std::atomic_int64_t queued = 0;
+    std::atomic_bool stop = false;
+    std::uint64_t executed = 0;
+    std::uint64_t counted = 0;
+
+    std::uint64_t const begin = bench::now();
+    std::uint64_t const deadline = begin + static_cast<std::uint64_t>(duration * 1e9);
+    std::uint64_t end = 0;
+
+    std::vector<std::thread> producers;
+    for (std::size_t i = 0; i < producer_count; ++i) {
+        producers.emplace_back([&] {
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (queued.load(std::memory_order_relaxed) >= max_queued) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                queued.fetch_add(1, std::memory_order_relaxed);
+                executor.post([&, posted = bench::now()] {
+                    std::uint64_t const time = bench::now();
+                    queued.fetch_sub(1, std::memory_order_relaxed);
+                    if (end != 0)
+                        return;
+                    bench::record(latency, time - posted);
+                    ++executed;
+                    // run() only returns once stopped, so the producers have to be stopped from here
+                    if (time >= deadline) {
+                        end = time;
+                        counted = executed;
+                        stop.store(true, std::memory_order_relaxed);
+                        executor.stop();
+                    }
+                });
+            }
+        });
+    }
+
+    // only this thread runs handlers, so they can record without synchronization
+    (void)executor.run();
+
+    for (auto &producer : producers)
+        producer.join();
+    (void)executor.poll();
+
+    char variant[32];
+    std::snprintf(variant, sizeof(variant), "%zu producer%s", producer_count, producer_count == 1 ? "" : "s");
+    char const *const name = "synchronized";
+    report("executor", name, variant, "handlers/s", static_cast<double>(counted) / (static_cast<double>(end - begin) / 1e9));
+    report("executor", name, variant, "p50 ns", static_cast<double>(latency.percentile(0.5)));
+    report("executor", name, variant, "p99 ns", static_cast<double>(latency.percentile(0.99)));
+}
+
+void run_thread_pool(std::size_t worker_count, std::size_t chains, double duration)
+{
+    std::atomic_uint64_t executed = 0;
+    std::atomic_bool stop = false;
+    std::atomic_size_t finished = 0;
+    tcx::thread_pool pool(worker_count);
+
+    struct link {
+        tcx::thread_pool *pool;
+        std::atomic_uint64_t *executed;
+        std::atomic_bool *stop;
+        std::atomic_size_t *finished;
+
+        void operator()() const
+        {
+            executed->fetch_add(1, std::memory_order_relaxed);
+            if (stop->load(std::memory_order_relaxed))
+                finished->fetch_add(1, std::memory_order_release);
+            else
+                pool->post(*this);
+        }
+    };
+
+    std::uint64_t const begin = bench::now();
+    for (std::size_t i = 0; i < chains; ++i)
+        pool.post(link { &pool, &executed, &stop, &finished });
+    std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+    std::uint64_t const counted = executed.load(std::memory_order_relaxed);
+    std::uint64_t const end = bench::now();
+    stop.store(true, std::memory_order_relaxed);
+    while (finished.load(std::memory_order_acquire) != chains)
+        std::this_thread::yield();
+
+    char variant[32];
+    std::snprintf(variant, sizeof(variant), "%zu worker%s", worker_count, worker_count == 1 ? "" : "s");
+    report("executor", "thread_pool", variant, "handlers/s", static_cast<double>(counted) / (static_cast<double>(end - begin) / 1e9));
+}
+
+// every chain goes through a single strand, so handlers run one at a time whatever the number of workers
+void run_strand(std::size_t worker_count, std::size_t batch, std::size_t chains, double duration)
+{
+    std::atomic_uint64_t executed = 0;
+    std::atomic_bool stop = false;
+    std::atomic_size_t finished = 0;
+    tcx::thread_pool pool(worker_count);
+    tcx::strand strand(pool, batch);
+
+    struct link {
+        tcx::strand<tcx::thread_pool> *strand;
+        std::atomic_uint64_t *executed;
+        std::atomic_bool *stop;
+        std::atomic_size_t *finished;
+
+        void operator()() const
+        {
+            executed->fetch_add(1, std::memory_order_relaxed);
+            if (stop->load(std::memory_order_relaxed))
+                finished->fetch_add(1, std::memory_order_release);
+            else
+                strand->post(*this);
+        }
+    };
+
+    std::uint64_t const begin = bench::now();
+    for (std::size_t i = 0; i < chains; ++i)
+        strand.post(link { &strand, &executed, &stop, &finished });
+    std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+    std::uint64_t const counted = executed.load(std::memory_order_relaxed);
+    std::uint64_t const end = bench::now();
+    stop.store(true, std::memory_order_relaxed);
+    while (finished.load(std::memory_order_acquire) != chains)
+        std::this_thread::yield();
+    // the strand's last batch may still be returning
+    pool.stop();
+
+    char variant[64];
+    std::snprintf(variant, sizeof(variant), "%zu worker%s, batch %zu", worker_count, worker_count == 1 ? "" : "s", batch);
+    report("executor", "strand", variant, "handlers/s", static_cast<double>(counted) / (static_cast<double>(end - begin) / 1e9));
+}
+
+// splits the buffer into the messages in it with `find`, in bytes per nanosecond
+template <typename Find>
+double measure_framing(std::vector<char> const &buffer, std::string_view delimiter, std::size_t messages, Find &&find)
+{
+    std::size_t const iterations = std::max<std::size_t>(1, (64u << 20) / buffer.size());
+    double const nanoseconds = measure(iterations, [&] {
+        std::size_t found = 0;
+        for (std::size_t offset = 0; offset < buffer.size();) {
+            std::size_t const at = find(buffer.data() + offset, buffer.size() - offset, delimiter);
+            if (at == tcx::utilities::delimiter_not_found)
+                break;
+            offset += at + delimiter.size();
+            ++found;
+        }
+        if (found != messages)
+            throw std::logic_error("framing found the wrong number of messages");
+        bench::do_not_optimize(found);
+    });
+    return static_cast<double>(buffer.size()) / nanoseconds;
+}
+
+void run_framing(std::size_t message_size)
+{
+    constexpr std::size_t buffer_size = 1 << 20;
+    for (std::string_view const delimiter : { std::string_view("\n"), std::string_view("\r\n"), std::string_view("\r\n\r\n") }) {
+        if (message_size <= delimiter.size())
+            continue;
+        // printable bytes, with lone `\r` in the multi byte cases so the candidates aren't all matches
+        std::vector<char> buffer;
+        std::size_t messages = 0;
+        while (buffer.size() + message_size <= buffer_size) {
+            for (std::size_t i = 0; i < message_size - delimiter.size(); ++i)
+                buffer.push_back(delimiter.size() > 1 && i % 61 == 60 ? '\r' : static_cast<char>('a' + (i * 7 + messages) % 26));
+            buffer.insert(buffer.end(), delimiter.begin(), delimiter.end());
+            ++messages;
+        }
+
+        char variant[64];
+        std::snprintf(variant, sizeof(variant), "%zu B messages, %zu B delim", message_size, delimiter.size());
+
+        report("framing", "byte loop", variant, "bytes/ns", measure_framing(buffer, delimiter, messages, [](char const *data, std::size_t size, std::string_view delimiter) {
+            for (std::size_t i = 0; i + delimiter.size() <= size; ++i) {
+                if (std::memcmp(data + i, delimiter.data(), delimiter.size()) == 0)
+                    return i;
+            }
+            return tcx::utilities::delimiter_not_found;
+        }));
+        report("framing", "memmem", variant, "bytes/ns", measure_framing(buffer, delimiter, messages, [](char const *data, std::size_t size, std::string_view delimiter) {
+            auto const *const found = static_cast<char const *>(::memmem(data, size, delimiter.data(), delimiter.size()));
+            return found ? static_cast<std::size_t>(found - data) : tcx::utilities::delimiter_not_found;
+        }));
+
+        using isa = tcx::utilities::find_delimiter_isa;
+        std::pair<isa, char const *> const implementations[] = { { isa::scalar, "find_delimiter scalar" }, { isa::sse2, "find_delimiter sse2" }, { isa::avx2, "find_delimiter avx2" } };
+        for (auto const &[implementation, name] : implementations) {
+            if (implementation > tcx::utilities::find_delimiter_dispatch())
+                continue;
+            report("framing", name, variant, "bytes/ns", measure_framing(buffer, delimiter, messages, [implementation](char const *data, std::size_t size, std::string_view delimiter) {
+                return tcx::utilities::find_delimiter(implementation, data, size, delimiter.data(), delimiter.size());
+            }));
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    bench::options const options(argc, argv);
+    auto const suites = options.list("suites", "function,executor,framing");
+    auto const iterations = static_cast<std::size_t>(options.get("iterations", 1e6));
+    auto const producers = options.sizes("producers", "1,2,4,8");
+    auto const workers = options.sizes("workers", "1,2,4");
+    auto const message_sizes = options.sizes("message-sizes", "16,64,1K");
+    double const duration = options.get("duration", 1.0);
+    auto const queue_limit = static_cast<std::int64_t>(options.get("queue-limit", 256.0));
+    json = options.flag("json");
+
+    if (json)
+        std::puts("[");
+    for (auto const &suite : suites) {
+        if (suite == "function") {
+            run_function_suites<inline_capture>("inline capture", iterations);
+            run_function_suites<heap_capture>("heap capture", iterations);
+        } else if (suite == "executor") {
+            run_unsynchronized(duration);
+            for (auto const count : producers)
+                run_synchronized(count, queue_limit, duration);
+            for (auto const count : workers)
+                run_thread_pool(count, static_cast<std::size_t>(queue_limit), duration);
+            for (auto const count : workers) {
+                run_strand(count, 1, static_cast<std::size_t>(queue_limit), duration);
+                run_strand(count, tcx::strand<tcx::thread_pool>::default_batch, static_cast<std::size_t>(queue_limit), duration);
+            }
+        } else if (suite == "framing") {
+            for (auto const size : message_sizes)
+                run_framing(size);
+        }
+    }
+    if (json)
+        std::puts("\n]");
+}
@@ -0,0 +1,478 @@
+/**
+ * Loopback TCP benchmark comparing the io_uring, epoll and poll backends.
+ *
+ * A server thread runs the backend under test, while client threads drive load through plain non-blocking sockets,
+ * so the client side costs the same for every backend.
+ *
+ * - `echo`: the server writes back whatever it reads, every connection keeps `--depth` messages in flight.
+ * - `rr`: request/response, the server waits for a whole message before answering it, one message in flight per connection.
+ *
+ * Latency is measured by the clients, from writing the first byte of a message until the last byte of it comes back.
+ * CPU per message only accounts the server thread.
+ *
+ * Usage: bench_net [--backends=unsynchronized_uring,synchronized_uring,epoll,poll] [--modes=echo,rr]
+ *                  [--connections=1,16,128] [--sizes=64,4K,64K] [--depth=16] [--duration=1] [--warmup=0.2] [--json]
+ */
+
+#include "common.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <variant>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <tcx/async/ioring.hpp>
+#include <tcx/dispatch.hpp>
+#include <tcx/services/epoll_service.hpp>
+#include <tcx/services/poll_service.hpp>
+#include <tcx/synchronized_execution_context.hpp>
+#include <tcx/unsynchronized_execution_context.hpp>
+
+namespace {
+
+[[noreturn]] void fail(char const *what)
+{
+    throw std::system_error(errno, std::system_category(), what);
+}
+
+void set_nonblocking(int fd)
+{
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0)
+        fail("fcntl");
+}
+
+void set_nodelay(int fd)
+{
+    int const one = 1;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) < 0)
+        fail("setsockopt");
+}
+
+// returns {client, server} pairs of connected sockets
+std::vector<std::pair<int, int>> connect_pairs(std::size_t count)
+{
+    int const listener = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0)
+        fail("socket");
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (::bind(listener, reinterpret_cast<sockaddr *>(&addr), len) < 0 || ::listen(listener, SOMAXCONN) < 0 || ::getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len) < 0)
+        fail("listen");
+
+    std::vector<std::pair<int, int>> result;
+    for (std::size_t i = 0; i < count; ++i) {
+        int const client = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (client < 0 || ::connect(client, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+            fail("connect");
+        int const server = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (server < 0)
+            fail("accept4");
+        set_nodelay(client);
+        set_nodelay(server);
+        set_nonblocking(client);
+        set_nonblocking(server);
+        result.emplace_back(client, server);
+    }
+    ::close(listener);
+    return result;
+}
+
+// backends adapt each service to the same callback interface, results are a byte count or a negated errno
+
+template <typename Ring, typename Executor>
+struct uring_backend {
+    Ring &ring;
+    Executor &executor;
+
+    template <typename F>
+    void recv(int fd, char *buf, std::size_t len, F &&f)
+    {
+        tcx::async_recv(executor, ring, fd, buf, len, 0, [f = std::forward<F>(f)](std::variant<std::error_code, std::size_t> result) mutable {
+            f(result.index() == 0 ? -static_cast<ssize_t>(std::get<0>(result).value()) : static_cast<ssize_t>(std::get<1>(result)));
+        });
+    }
+
+    template <typename F>
+    void send(int fd, char const *buf, std::size_t len, F &&f)
+    {
+        tcx::async_send(executor, ring, fd, buf, len, MSG_NOSIGNAL, [f = std::forward<F>(f)](std::variant<std::error_code, std::size_t> result) mutable {
+            f(result.index() == 0 ? -static_cast<ssize_t>(std::get<0>(result).value()) : static_cast<ssize_t>(std::get<1>(result)));
+        });
+    }
+
+    void run_once()
+    {
+        if (auto result = ring.run_once(); result.has_error())
+            throw std::system_error(result.error(), std::system_category(), "run_once");
+        if constexpr (requires { executor.poll(); })
+            (void)executor.poll();
+    }
+};
+
+// readiness based backends try the operation right away, and only wait for readiness when it would block
+template <typename Service, auto In, auto Out>
+struct readiness_backend {
+    Service &service;
+    tcx::unsynchronized_execution_context &executor;
+
+    template <typename F>
+    void recv(int fd, char *buf, std::size_t len, F &&f)
+    {
+        ssize_t const result = ::recv(fd, buf, len, 0);
+        if (result >= 0 || errno != EAGAIN) {
+            executor.post([f = std::forward<F>(f), result = result < 0 ? -errno : result]() mutable { f(result); });
+        } else {
+            service.async_poll_add(fd, In, [this, fd, buf, len, f = std::forward<F>(f)](auto events) mutable {
+                if (events < 0)
+                    executor.post([f = std::move(f), events]() mutable { f(events); });
+                else
+                    recv(fd, buf, len, std::move(f));
+            });
+        }
+    }
+
+    template <typename F>
+    void send(int fd, char const *buf, std::size_t len, F &&f)
+    {
+        ssize_t const result = ::send(fd, buf, len, MSG_NOSIGNAL);
+        if (result >= 0 || errno != EAGAIN) {
+            executor.post([f = std::forward<F>(f), result = result < 0 ? -errno : result]() mutable { f(result); });
+        } else {
+            service.async_poll_add(fd, Out, [this, fd, buf, len, f = std::forward<F>(f)](auto events) mutable {
+                if (events < 0)
+                    executor.post([f = std::move(f), events]() mutable { f(events); });
+                else
+                    send(fd, buf, len, std::move(f));
+            });
+        }
+    }
+
+    void run_once()
+    {
+        // a ready file may have been handled without waiting, then there's nothing to wait for
+        if (executor.pending() == 0)
+            service.poll(100);
+        executor.run();
+    }
+};
+
+using epoll_backend = readiness_backend<tcx::epoll_service, std::uint32_t { EPOLLIN }, std::uint32_t { EPOLLOUT }>;
+using poll_backend = readiness_backend<tcx::poll_service, short { POLLIN }, short { POLLOUT }>;
+
+template <typename Backend>
+class server {
+public:
+    server(Backend &backend, std::vector<int> const &fds, std::size_t message_size, bool framed)
+        : m_backend(backend)
+        , m_message_size(message_size)
+        , m_framed(framed)
+    {
+        for (int fd : fds)
+            m_sessions.push_back(std::make_unique<session>(session { fd, std::vector<char>(framed ? message_size : std::max<std::size_t>(message_size, 16384)), 0 }));
+        m_open = m_sessions.size();
+    }
+
+    // runs until every client has closed it's connection
+    void run()
+    {
+        for (auto &s : m_sessions)
+            read(*s);
+        while (m_open != 0)
+            m_backend.run_once();
+    }
+
+private:
+    struct session {
+        int fd;
+        std::vector<char> buffer;
+        std::size_t filled;
+    };
+
+    void read(session &s)
+    {
+        m_backend.recv(s.fd, s.buffer.data() + s.filled, s.buffer.size() - s.filled, [this, &s](ssize_t result) {
+            if (result <= 0) {
+                ::close(s.fd);
+                --m_open;
+                return;
+            }
+            s.filled += static_cast<std::size_t>(result);
+            if (m_framed && s.filled < m_message_size)
+                return read(s);
+            write(s, 0);
+        });
+    }
+
+    void write(session &s, std::size_t offset)
+    {
+        m_backend.send(s.fd, s.buffer.data() + offset, s.filled - offset, [this, &s, offset](ssize_t result) {
+            if (result <= 0) {
+                ::close(s.fd);
+                --m_open;
+                return;
+            }
+            if (offset + static_cast<std::size_t>(result) < s.filled)
+                return write(s, offset + static_cast<std::size_t>(result));
+            s.filled = 0;
+            read(s);
+        });
+    }
+
+    Backend &m_backend;
+    std::size_t m_message_size;
+    bool m_framed;
+    std::vector<std::unique_ptr<session>> m_sessions;
+    std::size_t m_open = 0;
+};
+
+struct client_stats {
+    std::uint64_t messages = 0;
+    bench::histogram latency;
+};
+
+// drives a set of connections from a single thread, keeping `depth` messages in flight on each
+void run_clients(std::vector<int> fds, std::size_t message_size, std::size_t depth, std::atomic_int const &phase, client_stats &stats)
+{
+    struct connection {
+        int fd;
+        std::deque<std::uint64_t> sent; // start time of every message in flight
+        std::size_t send_offset = 0; // of the message being written
+        std::size_t received = 0; // bytes of the oldest message in flight
+        bool want_write = false;
+    };
+
+    int const ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep < 0)
+        fail("epoll_create1");
+    std::vector<connection> connections;
+    connections.reserve(fds.size());
+    for (int fd : fds)
+        connections.push_back(connection { fd, {} });
+    for (auto &c : connections) {
+        epoll_event event { .events = EPOLLIN, .data = { .ptr = &c } };
+        if (epoll_ctl(ep, EPOLL_CTL_ADD, c.fd, &event) < 0)
+            fail("epoll_ctl");
+    }
+
+    std::vector<char> out(message_size, 'x');
+    std::vector<char> in(std::max<std::size_t>(message_size, 65536));
+
+    auto fill = [&](connection &c) {
+        while (phase.load(std::memory_order_relaxed) < 2 && (c.sent.size() < depth || c.send_offset != 0)) {
+            if (c.send_offset == 0)
+                c.sent.push_back(bench::now());
+            ssize_t const result = ::send(c.fd, out.data() + c.send_offset, message_size - c.send_offset, MSG_NOSIGNAL);
+            if (result < 0) {
+                if (errno != EAGAIN)
+                    fail("send");
+                break;
+            }
+            c.send_offset = (c.send_offset + static_cast<std::size_t>(result)) % message_size;
+        }
+        bool const want_write = c.send_offset != 0;
+        if (want_write != c.want_write) {
+            epoll_event event { .events = EPOLLIN | (want_write ? EPOLLOUT : 0u), .data = { .ptr = &c } };
+            if (epoll_ctl(ep, EPOLL_CTL_MOD, c.fd, &event) < 0)
+                fail("epoll_ctl");
+            c.want_write = want_write;
+        }
+    };
+
+    for (auto &c : connections)
+        fill(c);
+
+    epoll_event events[64];
+    while (phase.load(std::memory_order_relaxed) < 2) {
+        int const count = epoll_wait(ep, events, 64, 10);
+        if (count < 0 && errno != EINTR)
+            fail("epoll_wait");
+        bool const measuring = phase.load(std::memory_order_relaxed) == 1;
+        for (int i = 0; i < count; ++i) {
+            auto &c = *static_cast<connection *>(events[i].data.ptr);
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                for (;;) {
+                    ssize_t const result = ::recv(c.fd, in.data(), in.size(), 0);
+                    if (result < 0 && errno == EAGAIN)
+                        break;
+                    if (result <= 0)
+                        fail("recv");
+                    c.received += static_cast<std::size_t>(result);
+                    std::uint64_t const time = bench::now();
+                    while (c.received >= message_size && !c.sent.empty()) {
+                        if (measuring) {
+                            bench::record(stats.latency, time - c.sent.front());
+                            ++stats.messages;
+                        }
+                        c.sent.pop_front();
+                        c.received -= message_size;
+                    }
+                }
+            }
+            fill(c);
+        }
+    }
+
+    // the server stops once every connection is closed
+    for (auto &c : connections)
+        ::close(c.fd);
+    ::close(ep);
+}
+
+struct result {
+    double seconds;
+    std::uint64_t messages;
+    std::uint64_t server_cpu;
+    bench::histogram latency;
+};
+
+template <typename MakeBackend>
+result run(MakeBackend make_backend, std::size_t connection_count, std::size_t message_size, std::size_t depth, bool framed, double warmup, double duration)
+{
+    auto pairs = connect_pairs(connection_count);
+    std::vector<int> server_fds;
+    for (auto const &pair : pairs)
+        server_fds.push_back(pair.second);
+
+    std::atomic_int phase = 0; // 0 warming up, 1 measuring, 2 stopping
+    std::thread server_thread([&] {
+        make_backend([&](auto &backend) {
+            server<std::remove_reference_t<decltype(backend)>> s(backend, server_fds, message_size, framed);
+            s.run();
+        });
+    });
+
+    std::size_t const thread_count = std::min<std::size_t>(connection_count, std::max(1u, std::thread::hardware_concurrency() / 2));
+    std::vector<client_stats> stats(thread_count);
+    std::vector<std::thread> clients;
+    for (std::size_t t = 0; t < thread_count; ++t) {
+        std::vector<int> fds;
+        for (std::size_t i = t; i < pairs.size(); i += thread_count)
+            fds.push_back(pairs[i].first);
+        clients.emplace_back(run_clients, std::move(fds), message_size, depth, std::cref(phase), std::ref(stats[t]));
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(warmup));
+    std::uint64_t const cpu_begin = bench::thread_cpu_time(server_thread.native_handle());
+    std::uint64_t const begin = bench::now();
+    phase.store(1, std::memory_order_relaxed);
+    std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+    phase.store(2, std::memory_order_relaxed);
+    std::uint64_t const end = bench::now();
+    std::uint64_t const cpu_end = bench::thread_cpu_time(server_thread.native_handle());
+
+    for (auto &client : clients)
+        client.join();
+    server_thread.join();
+
+    result r { static_cast<double>(end - begin) / 1e9, 0, cpu_end - cpu_begin, {} };
+    for (auto const &s : stats) {
+        r.messages += s.messages;
+        bench::merge(r.latency, s.latency);
+    }
+    return r;
+}
+
+template <typename F>
+void with_backend(std::string const &name, F &&f)
+{
+    if (name == "unsynchronized_uring") {
+        tcx::unsynchronized_execution_context executor;
+        auto ring = tcx::unsynchronized_uring_context<>::create(4096);
+        if (ring.has_error())
+            throw std::system_error(ring.error(), std::system_category(), "io_uring_queue_init");
+        uring_backend<tcx::unsynchronized_uring_context<>, tcx::unsynchronized_execution_context> backend { ring.value(), executor };
+        f(backend);
+    } else if (name == "inline_uring") {
+        tcx::inline_executor executor;
+        auto ring = tcx::unsynchronized_uring_context<>::create(4096);
+        if (ring.has_error())
+            throw std::system_error(ring.error(), std::system_category(), "io_uring_queue_init");
+        uring_backend<tcx::unsynchronized_uring_context<>, tcx::inline_executor> backend { ring.value(), executor };
+        f(backend);
+    } else if (name == "synchronized_uring") {
+        tcx::synchronized_execution_context executor;
+        auto storage = tcx::uring_context_storage::create(4096, 0u);
+        if (storage.has_error())
+            throw std::system_error(storage.error(), std::system_category(), "io_uring_queue_init");
+        tcx::synchronized_uring_context<> ring(std::move(storage).value());
+        uring_backend<tcx::synchronized_uring_context<>, tcx::synchronized_execution_context> backend { ring, executor };
+        f(backend);
+    } else if (name == "epoll") {
+        tcx::unsynchronized_execution_context executor;
+        tcx::epoll_service service;
+        epoll_backend backend { service, executor };
+        f(backend);
+    } else if (name == "poll") {
+        tcx::unsynchronized_execution_context executor;
+        tcx::poll_service service;
+        poll_backend backend { service, executor };
+        f(backend);
+    } else {
+        throw std::invalid_argument("unknown backend " + name);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    bench::options const options(argc, argv);
+    auto const backends = options.list("backends", "unsynchronized_uring,inline_uring,synchronized_uring,epoll,poll");
+    auto const modes = options.list("modes", "echo,rr");
+    auto const connections = options.sizes("connections", "1,16,128");
+    auto const sizes = options.sizes("sizes", "64,4K,64K");
+    auto const depth = static_cast<std::size_t>(options.get("depth", 16.0));
+    double const duration = options.get("duration", 1.0);
+    double const warmup = options.get("warmup", 0.2);
+    bool const json = options.flag("json");
+
+    if (json)
+        std::puts("[");
+    else
+        std::printf("%-21s %-4s %6s %8s %12s %10s %9s %9s %9s %10s\n", "backend", "mode", "conns", "size", "msg/s", "MiB/s", "p50 us", "p99 us", "p999 us", "cpu us/msg");
+
+    bool first = true;
+    for (auto const &mode : modes) {
+        bool const framed = mode == "rr";
+        for (auto const connection_count : connections) {
+            for (auto const size : sizes) {
+                for (auto const &backend : backends) {
+                    auto const r = run([&](auto &&f) { with_backend(backend, f); }, connection_count, size, framed ? 1 : depth, framed, warmup, duration);
+                    double const rate = static_cast<double>(r.messages) / r.seconds;
+                    double const mib = rate * static_cast<double>(size) / (1024.0 * 1024.0);
+                    double const cpu = r.messages != 0 ? static_cast<double>(r.server_cpu) / 1e3 / static_cast<double>(r.messages) : 0.0;
+                    double const p50 = static_cast<double>(r.latency.percentile(0.5)) / 1e3;
+                    double const p99 = static_cast<double>(r.latency.percentile(0.99)) / 1e3;
+                    double const p999 = static_cast<double>(r.latency.percentile(0.999)) / 1e3;
+                    if (json) {
+                        std::printf("%s  {\"backend\":\"%s\",\"mode\":\"%s\",\"connections\":%zu,\"size\":%zu,\"messages_per_second\":%.1f,\"mib_per_second\":%.2f,"
+                                    "\"p50_us\":%.2f,\"p99_us\":%.2f,\"p999_us\":%.2f,\"server_cpu_us_per_message\":%.3f}",
+                            first ? "" : ",\n", backend.c_str(), mode.c_str(), connection_count, size, rate, mib, p50, p99, p999, cpu);
+                    } else {
+                        std::printf("%-21s %-4s %6zu %8zu %12.0f %10.2f %9.2f %9.2f %9.2f %10.3f\n", backend.c_str(), mode.c_str(), connection_count, size, rate, mib, p50, p99, p999, cpu);
+                    }
+                    std::fflush(stdout);
+                    first = false;
+                }
+            }
+        }
+    }
+    if (json)
+        std::puts("\n]");
+}
@@ -0,0 +1,366 @@
+/**
+ * Storage benchmark, in the spirit of fio, through `tcx::async_read` and `tcx::async_write`.
+ *
+ * Every run keeps `qd` operations of `bs` bytes in flight against a temporary file, for `--duration` seconds.
+ * The same run is also done with liburing directly (`--apis=raw`),
+ * to tell apart the cost of the completion allocation and the executor hop from the cost of the I/O itself.
+ *
+ * Results are written to stdout as a JSON array, one object per run.
+ * Runs that fail (for example O_DIRECT on a filesystem that doesn't support it) report an `error` instead.
+ *
+ * Usage: bench_storage [--dir=/var/tmp] [--file-size=256M] [--patterns=randread,randwrite,read,write]
+ *                      [--qd=1,4,16,64,256] [--bs=4K,64K,1M] [--modes=buffered,direct]
+ *                      [--buffers=plain,fixed] [--apis=tcx,raw] [--duration=0.5]
+ */
+
+#include "common.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <variant>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <tcx/async/ioring.hpp>
+#include <tcx/unsynchronized_execution_context.hpp>
+
+namespace {
+
+struct run_config {
+    bool write;
+    bool random;
+    bool fixed;
+    std::size_t queue_depth;
+    std::size_t block_size;
+    std::uint64_t file_size;
+    double duration;
+};
+
+struct run_result {
+    std::uint64_t operations = 0;
+    std::uint64_t bytes = 0;
+    double seconds = 0;
+    std::uint64_t cpu = 0;
+    bench::histogram latency;
+    int error = 0;
+};
+
+struct aligned_free {
+    void operator()(void *ptr) const noexcept
+    {
+        std::free(ptr);
+    }
+};
+
+// one slot per operation in flight, each with it's own buffer
+class slots {
+public:
+    slots(std::size_t count, std::size_t block_size)
+        : m_block_size(block_size)
+        , m_memory(std::aligned_alloc(4096, count * block_size))
+    {
+        if (m_memory == nullptr)
+            throw std::bad_alloc();
+        std::memset(m_memory.get(), 0x5a, count * block_size);
+        for (std::size_t i = 0; i < count; ++i)
+            m_iovecs.push_back(iovec { data(i), block_size });
+    }
+
+    [[nodiscard]] char *data(std::size_t slot) const noexcept
+    {
+        return static_cast<char *>(m_memory.get()) + slot * m_block_size;
+    }
+
+    [[nodiscard]] std::span<iovec const> iovecs() const noexcept
+    {
+        return m_iovecs;
+    }
+
+private:
+    std::size_t m_block_size;
+    std::unique_ptr<void, aligned_free> m_memory;
+    std::vector<iovec> m_iovecs;
+};
+
+// picks the offset of the next operation
+class offsets {
+public:
+    offsets(run_config const &config)
+        : m_blocks(config.file_size / config.block_size)
+        , m_block_size(config.block_size)
+        , m_random(config.random)
+    {
+    }
+
+    std::uint64_t next() noexcept
+    {
+        std::uint64_t block;
+        if (m_random) {
+            // xorshift64, good enough to defeat read-ahead
+            m_state ^= m_state << 13;
+            m_state ^= m_state >> 7;
+            m_state ^= m_state << 17;
+            block = m_state % m_blocks;
+        } else {
+            block = m_cursor++ % m_blocks;
+        }
+        return block * m_block_size;
+    }
+
+private:
+    std::uint64_t m_blocks;
+    std::uint64_t m_block_size;
+    bool m_random;
+    std::uint64_t m_state = 0x9e3779b97f4a7c15u;
+    std::uint64_t m_cursor = 0;
+};
+
+run_result run_tcx(int fd, run_config const &config)
+{
+    run_result result;
+    auto ring = tcx::unsynchronized_uring_context<>::create(static_cast<std::uint32_t>(config.queue_depth));
+    if (ring.has_error()) {
+        result.error = ring.error();
+        return result;
+    }
+    auto &service = ring.value();
+    tcx::unsynchronized_execution_context executor;
+    slots buffers(config.queue_depth, config.block_size);
+    offsets next_offset(config);
+    if (config.fixed) {
+        if (auto registered = service.register_buffers(buffers.iovecs()); registered.has_error()) {
+            result.error = registered.error();
+            return result;
+        }
+    }
+
+    std::uint64_t const begin = bench::now();
+    std::uint64_t const deadline = begin + static_cast<std::uint64_t>(config.duration * 1e9);
+    std::uint64_t const cpu_begin = bench::process_cpu_time();
+    bool stopping = false;
+
+    // every completion issues the next operation of it's slot, until the deadline or an error
+    auto issue = [&](auto &self, std::size_t slot) -> void {
+        std::uint64_t const start = bench::now();
+        auto on_complete = [&, slot, start](std::variant<std::error_code, std::size_t> r) {
+            std::uint64_t const end = bench::now();
+            if (r.index() == 0) {
+                result.error = std::get<0>(r).value();
+                stopping = true;
+                return;
+            }
+            bench::record(result.latency, end - start);
+            ++result.operations;
+            result.bytes += std::get<1>(r);
+            if (!stopping && end < deadline)
+                self(self, slot);
+        };
+        auto const offset = static_cast<off_t>(next_offset.next());
+        char *const buf = buffers.data(slot);
+        int const index = static_cast<int>(slot);
+        if (config.write && config.fixed)
+            tcx::async_write_fixed(executor, service, fd, buf, config.block_size, offset, index, std::move(on_complete));
+        else if (config.write)
+            tcx::async_write(executor, service, fd, buf, config.block_size, offset, std::move(on_complete));
+        else if (config.fixed)
+            tcx::async_read_fixed(executor, service, fd, buf, config.block_size, offset, index, std::move(on_complete));
+        else
+            tcx::async_read(executor, service, fd, buf, config.block_size, offset, std::move(on_complete));
+    };
+
+    for (std::size_t slot = 0; slot < config.queue_depth; ++slot)
+        issue(issue, slot);
+    while (service.pending() != 0) {
+        if (auto r = service.run_once(); r.has_error()) {
+            result.error = r.error();
+            break;
+        }
+        executor.run();
+    }
+
+    result.seconds = static_cast<double>(bench::now() - begin) / 1e9;
+    result.cpu = bench::process_cpu_time() - cpu_begin;
+    return result;
+}
+
+// the same loop without the library, as the baseline
+run_result run_raw(int fd, run_config const &config)
+{
+    run_result result;
+    io_uring ring;
+    if (int const error = io_uring_queue_init(static_cast<unsigned>(config.queue_depth), &ring, 0); error < 0) {
+        result.error = -error;
+        return result;
+    }
+    slots buffers(config.queue_depth, config.block_size);
+    offsets next_offset(config);
+    if (config.fixed) {
+        if (int const error = io_uring_register_buffers(&ring, buffers.iovecs().data(), static_cast<unsigned>(config.queue_depth)); error < 0) {
+            result.error = -error;
+            io_uring_queue_exit(&ring);
+            return result;
+        }
+    }
+
+    std::vector<std::uint64_t> started(config.queue_depth);
+    auto issue = [&](std::size_t slot) {
+        io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+        auto const offset = next_offset.next();
+        auto const len = static_cast<unsigned>(config.block_size);
+        char *const buf = buffers.data(slot);
+        int const index = static_cast<int>(slot);
+        if (config.write && config.fixed)
+            io_uring_prep_write_fixed(sqe, fd, buf, len, offset, index);
+        else if (config.write)
+            io_uring_prep_write(sqe, fd, buf, len, offset);
+        else if (config.fixed)
+            io_uring_prep_read_fixed(sqe, fd, buf, len, offset, index);
+        else
+            io_uring_prep_read(sqe, fd, buf, len, offset);
+        io_uring_sqe_set_data64(sqe, slot);
+        started[slot] = bench::now();
+    };
+
+    std::uint64_t const begin = bench::now();
+    std::uint64_t const deadline = begin + static_cast<std::uint64_t>(config.duration * 1e9);
+    std::uint64_t const cpu_begin = bench::process_cpu_time();
+    std::size_t in_flight = config.queue_depth;
+    for (std::size_t slot = 0; slot < config.queue_depth; ++slot)
+        issue(slot);
+
+    while (in_flight != 0) {
+        if (int const error = io_uring_submit_and_wait(&ring, 1); error < 0 && error != -EINTR) {
+            result.error = -error;
+            break;
+        }
+        unsigned head;
+        unsigned seen = 0;
+        io_uring_cqe *cqe;
+        io_uring_for_each_cqe(&ring, head, cqe)
+        {
+            ++seen;
+            --in_flight;
+            std::uint64_t const end = bench::now();
+            auto const slot = static_cast<std::size_t>(io_uring_cqe_get_data64(cqe));
+            if (cqe->res < 0) {
+                result.error = -cqe->res;
+                continue;
+            }
+            bench::record(result.latency, end - started[slot]);
+            ++result.operations;
+            result.bytes += static_cast<std::uint64_t>(cqe->res);
+            if (result.error == 0 && end < deadline) {
+                issue(slot);
+                ++in_flight;
+            }
+        }
+        io_uring_cq_advance(&ring, seen);
+    }
+
+    result.seconds = static_cast<double>(bench::now() - begin) / 1e9;
+    result.cpu = bench::process_cpu_time() - cpu_begin;
+    io_uring_queue_exit(&ring);
+    return result;
+}
+
+// creates a temporary file filled with data, so that reads aren't served from holes
+std::pair<int, int> create_file(std::string const &dir, std::uint64_t size)
+{
+    std::string path = dir + "/tcx_bench_storage.XXXXXX";
+    int const fd = ::mkstemp(path.data());
+    if (fd < 0)
+        throw std::system_error(errno, std::system_category(), "mkstemp");
+    // may fail, in which case the direct runs report the error
+    int const direct_fd = ::open(path.c_str(), O_RDWR | O_DIRECT | O_CLOEXEC);
+    int const direct_error = errno;
+    ::unlink(path.c_str());
+
+    std::vector<char> chunk(1 << 20, 0x5a);
+    for (std::uint64_t written = 0; written < size;) {
+        auto const len = static_cast<std::size_t>(std::min<std::uint64_t>(chunk.size(), size - written));
+        ssize_t const result = ::pwrite(fd, chunk.data(), len, static_cast<off_t>(written));
+        if (result < 0)
+            throw std::system_error(errno, std::system_category(), "pwrite");
+        written += static_cast<std::uint64_t>(result);
+    }
+    ::fsync(fd);
+    return { fd, direct_fd < 0 ? -direct_error : direct_fd };
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    bench::options const options(argc, argv);
+    auto const dir = options.get("dir", std::string("/var/tmp"));
+    auto const file_size = options.sizes("file-size", "256M").at(0);
+    auto const patterns = options.list("patterns", "randread,randwrite,read,write");
+    auto const depths = options.sizes("qd", "1,4,16,64,256");
+    auto const block_sizes = options.sizes("bs", "4K,64K,1M");
+    auto const modes = options.list("modes", "buffered,direct");
+    auto const buffer_kinds = options.list("buffers", "plain,fixed");
+    auto const apis = options.list("apis", "tcx,raw");
+    double const duration = options.get("duration", 0.5);
+
+    auto const [buffered_fd, direct_fd] = create_file(dir, file_size);
+
+    std::puts("[");
+    bool first = true;
+    for (auto const &pattern : patterns) {
+        for (auto const &mode : modes) {
+            for (auto const block_size : block_sizes) {
+                for (auto const depth : depths) {
+                    for (auto const &buffer_kind : buffer_kinds) {
+                        for (auto const &api : apis) {
+                            run_config const config {
+                                .write = pattern.ends_with("write"),
+                                .random = pattern.starts_with("rand"),
+                                .fixed = buffer_kind == "fixed",
+                                .queue_depth = depth,
+                                .block_size = block_size,
+                                .file_size = file_size,
+                                .duration = duration,
+                            };
+
+                            int const fd = mode == "direct" ? direct_fd : buffered_fd;
+                            run_result r;
+                            if (fd < 0)
+                                r.error = -fd;
+                            else if (block_size > file_size)
+                                r.error = EINVAL;
+                            else
+                                r = api == "raw" ? run_raw(fd, config) : run_tcx(fd, config);
+
+                            std::printf("%s  {\"api\":\"%s\",\"pattern\":\"%s\",\"mode\":\"%s\",\"buffers\":\"%s\",\"qd\":%zu,\"bs\":%zu,",
+                                first ? "" : ",\n", api.c_str(), pattern.c_str(), mode.c_str(), buffer_kind.c_str(), depth, block_size);
+                            if (r.error != 0) {
+                                std::printf("\"error\":\"%s\"}", std::strerror(r.error));
+                            } else {
+                                double const iops = static_cast<double>(r.operations) / r.seconds;
+                                std::printf("\"iops\":%.1f,\"mib_per_second\":%.2f,\"p50_us\":%.2f,\"p99_us\":%.2f,\"p999_us\":%.2f,\"cpu_us_per_io\":%.3f}",
+                                    iops,
+                                    static_cast<double>(r.bytes) / r.seconds / (1024.0 * 1024.0),
+                                    static_cast<double>(r.latency.percentile(0.5)) / 1e3,
+                                    static_cast<double>(r.latency.percentile(0.99)) / 1e3,
+                                    static_cast<double>(r.latency.percentile(0.999)) / 1e3,
+                                    r.operations != 0 ? static_cast<double>(r.cpu) / 1e3 / static_cast<double>(r.operations) : 0.0);
+                            }
+                            std::fflush(stdout);
+                            first = false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    std::puts("\n]");
+
+    ::close(buffered_fd);
+    if (direct_fd >= 0)
+        ::close(direct_fd);
+}
@@ -0,0 +1,352 @@
+/**
+ * Loopback UDP benchmark of `tcx::udp_socket` against one datagram per operation and the plain batched syscalls.
+ *
+ * - `receive`: a blaster thread floods the receiver with `sendmmsg()`, the receiver under test counts what it gets.
+ *   - `recvmmsg`: blocking `recvmmsg()` of 64 datagrams at a time
+ *   - `recvmsg`: one `IORING_OP_RECVMSG` per datagram, 64 in flight
+ *   - `multishot`: `tcx::udp_socket` receiving through a buffer ring, without GRO
+ *   - `multishot-gro`: the same with `UDP_GRO`
+ * - `send`: the sender under test sends to a socket nobody reads, the kernel drops what doesn't fit.
+ *   - `sendmmsg`: 64 datagrams per `sendmmsg()`
+ *   - `sendmsg`: one `IORING_OP_SENDMSG` per datagram, 64 in flight
+ *   - `gso`: `tcx::udp_socket` flushing batches of 64 datagrams as `UDP_SEGMENT` super datagrams
+ *
+ * Datagrams are counted by the side under test, CPU per datagram only accounts it's thread.
+ * Receiving variants also report the datagrams the blaster sent that never arrived.
+ *
+ * Usage: bench_udp [--modes=receive,send] [--receivers=recvmmsg,recvmsg,multishot,multishot-gro]
+ *                  [--senders=sendmmsg,sendmsg,gso] [--sizes=64,512,1400] [--duration=1] [--json]
+ */
+
+#include "common.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <tcx/net/udp.hpp>
+#include <tcx/services/buffer_ring.hpp>
+#include <tcx/services/uring_service.hpp>
+
+namespace {
+
+constexpr std::size_t batch = 64;
+
+[[noreturn]] void fail(char const *what)
+{
+    throw std::system_error(errno, std::system_category(), what);
+}
+
+int bound_socket(tcx::endpoint &local, int buffer_size = 0)
+{
+    int const fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        fail("socket");
+    if (buffer_size != 0)
+        (void)::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    local = tcx::endpoint::loopback(0);
+    socklen_t size = tcx::endpoint::capacity();
+    if (::bind(fd, local.data(), local.size()) < 0 || ::getsockname(fd, local.data(), &size) < 0)
+        fail("bind");
+    local.resize(size);
+    return fd;
+}
+
+// sends batches of datagrams of `size` to `to` until `stop`, returns how many were sent
+std::uint64_t blast(int fd, tcx::endpoint const &to, std::size_t size, std::atomic_bool const &stop)
+{
+    std::vector<char> payload(size, 'x');
+    iovec iov { payload.data(), size };
+    mmsghdr messages[batch] {};
+    for (auto &message : messages) {
+        message.msg_hdr.msg_name = const_cast<sockaddr *>(to.data());
+        message.msg_hdr.msg_namelen = to.size();
+        message.msg_hdr.msg_iov = &iov;
+        message.msg_hdr.msg_iovlen = 1;
+    }
+    std::uint64_t sent = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        int const result = ::sendmmsg(fd, messages, batch, 0);
+        if (result > 0)
+            sent += static_cast<std::uint64_t>(result);
+    }
+    return sent;
+}
+
+struct result {
+    double seconds = 0;
+    std::uint64_t datagrams = 0;
+    std::uint64_t cpu = 0;
+    std::uint64_t lost = 0;
+};
+
+// runs `body` on a thread of it's own for `duration`, `body` returns the datagrams it counted and takes the stop flag
+template <typename Body>
+result measure(double duration, Body body)
+{
+    std::atomic_bool stop = false;
+    result r;
+    std::uint64_t begin_cpu = 0;
+    std::thread worker([&] {
+        begin_cpu = bench::thread_cpu_time(pthread_self());
+        r.datagrams = body(stop);
+        r.cpu = bench::thread_cpu_time(pthread_self()) - begin_cpu;
+    });
+    std::uint64_t const begin = bench::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+    stop.store(true, std::memory_order_relaxed);
+    worker.join();
+    r.seconds = static_cast<double>(bench::now() - begin) / 1e9;
+    return r;
+}
+
+std::uint64_t receive_recvmmsg(int fd, std::size_t size, std::atomic_bool const &stop)
+{
+    std::vector<char> buffers(batch * size);
+    iovec iovs[batch];
+    mmsghdr messages[batch] {};
+    for (std::size_t i = 0; i < batch; ++i) {
+        iovs[i] = { buffers.data() + i * size, size };
+        messages[i].msg_hdr.msg_iov = &iovs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    std::uint64_t received = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        int const result = ::recvmmsg(fd, messages, batch, MSG_DONTWAIT, nullptr);
+        if (result > 0)
+            received += static_cast<std::uint64_t>(result);
+    }
+    return received;
+}
+
+std::uint64_t receive_recvmsg(int fd, std::size_t size, std::atomic_bool const &stop)
+{
+    auto ring = tcx::unsynchronized_uring_context<>::create(batch * 2).value();
+    struct slot {
+        std::vector<char> buffer;
+        iovec iov;
+        msghdr header {};
+    };
+    std::vector<slot> slots(batch);
+    std::uint64_t received = 0;
+    auto submit = [&](auto &self, slot &s) -> void {
+        ring.async_recvmsg(fd, &s.header, 0, [&, &s = s](auto &, io_uring_cqe const *cqe) {
+            if (cqe->res >= 0)
+                ++received;
+            if (!stop.load(std::memory_order_relaxed))
+                self(self, s);
+        });
+    };
+    for (auto &s : slots) {
+        s.buffer.resize(size);
+        s.iov = { s.buffer.data(), size };
+        s.header.msg_iov = &s.iov;
+        s.header.msg_iovlen = 1;
+        submit(submit, s);
+    }
+    while (!stop.load(std::memory_order_relaxed))
+        ring.run_once();
+    ring.async_cancel_fd(fd, IORING_ASYNC_CANCEL_ALL, [](auto &, io_uring_cqe const *) {});
+    while (ring.pending())
+        ring.run_once();
+    return received;
+}
+
+std::uint64_t receive_multishot(int fd, bool gro, std::atomic_bool const &stop)
+{
+    using ring_type = tcx::unsynchronized_uring_context<>;
+    auto ring = ring_type::create(batch * 2).value();
+    std::size_t const buffer_size = (gro ? 65536 : 2048) + tcx::udp_socket<ring_type>::receive_overhead;
+    auto buffers = tcx::buffer_ring::create(ring, 0, gro ? 256 : 1024, buffer_size);
+    if (buffers.has_error())
+        throw std::system_error(buffers.error(), std::system_category(), "io_uring_register_buf_ring");
+
+    std::uint64_t received = 0;
+    bool done = false;
+    {
+        tcx::udp_options options;
+        options.gro = gro;
+        // a duplicate of the descriptor the blaster already sends to, the socket closes it
+        tcx::udp_socket socket(ring, ::dup(fd), options);
+        auto const started = socket.start_receiving(buffers.value(), [&](std::variant<std::error_code, tcx::udp_datagram> datagram) {
+            if (datagram.index() == 0)
+                done = true;
+            else
+                ++received;
+        });
+        if (started.has_error())
+            throw std::system_error(started.error(), std::system_category(), "recvmsg");
+        while (!stop.load(std::memory_order_relaxed))
+            ring.run_once();
+        socket.stop_receiving();
+        while (!done)
+            ring.run_once();
+    }
+    while (ring.pending())
+        ring.run_once();
+    return received;
+}
+
+result run_receive(std::string const &receiver, std::size_t size, double duration)
+{
+    tcx::endpoint local;
+    int const fd = bound_socket(local, 8 * 1024 * 1024);
+    int const sender = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sender < 0)
+        fail("socket");
+
+    std::atomic_bool stop_blasting = false;
+    std::uint64_t sent = 0;
+    std::thread blaster([&] { sent = blast(sender, local, size, stop_blasting); });
+
+    auto r = measure(duration, [&](std::atomic_bool const &stop) -> std::uint64_t {
+        if (receiver == "recvmmsg")
+            return receive_recvmmsg(fd, size, stop);
+        if (receiver == "recvmsg")
+            return receive_recvmsg(fd, size, stop);
+        if (receiver == "multishot" || receiver == "multishot-gro")
+            return receive_multishot(fd, receiver == "multishot-gro", stop);
+        throw std::invalid_argument("unknown receiver " + receiver);
+    });
+    stop_blasting.store(true, std::memory_order_relaxed);
+    blaster.join();
+    r.lost = sent > r.datagrams ? sent - r.datagrams : 0;
+    ::close(sender);
+    ::close(fd);
+    return r;
+}
+
+std::uint64_t send_sendmmsg(tcx::endpoint const &to, std::size_t size, std::atomic_bool const &stop)
+{
+    int const fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        fail("socket");
+    auto const sent = blast(fd, to, size, stop);
+    ::close(fd);
+    return sent;
+}
+
+std::uint64_t send_sendmsg(tcx::endpoint const &to, std::size_t size, std::atomic_bool const &stop)
+{
+    int const fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        fail("socket");
+    auto ring = tcx::unsynchronized_uring_context<>::create(batch * 2).value();
+    std::vector<char> payload(size, 'x');
+    iovec iov { payload.data(), size };
+    msghdr header {};
+    header.msg_name = const_cast<sockaddr *>(to.data());
+    header.msg_namelen = to.size();
+    header.msg_iov = &iov;
+    header.msg_iovlen = 1;
+
+    std::uint64_t sent = 0;
+    auto submit = [&](auto &self) -> void {
+        ring.async_sendmsg(fd, &header, 0, [&](auto &, io_uring_cqe const *cqe) {
+            if (cqe->res >= 0)
+                ++sent;
+            if (!stop.load(std::memory_order_relaxed))
+                self(self);
+        });
+    };
+    for (std::size_t i = 0; i < batch; ++i)
+        submit(submit);
+    while (ring.pending())
+        ring.run_once();
+    ::close(fd);
+    return sent;
+}
+
+std::uint64_t send_gso(tcx::endpoint const &to, std::size_t size, std::atomic_bool const &stop)
+{
+    auto ring = tcx::unsynchronized_uring_context<>::create(batch * 2).value();
+    tcx::udp_socket socket(ring);
+    if (auto const error = socket.open())
+        throw std::system_error(error, "socket");
+    std::vector<char> payload(size, 'x');
+
+    std::uint64_t sent = 0;
+    std::size_t in_flight = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        // two batches in flight, one being sent while the other is queued
+        while (in_flight < 2) {
+            for (std::size_t i = 0; i < batch; ++i)
+                socket.queue(to, payload.data(), size);
+            ++in_flight;
+            socket.flush([&](std::error_code, std::size_t datagrams) {
+                sent += datagrams;
+                --in_flight;
+            });
+        }
+        ring.run_once();
+    }
+    while (in_flight != 0)
+        ring.run_once();
+    return sent;
+}
+
+result run_send(std::string const &sender, std::size_t size, double duration)
+{
+    tcx::endpoint sink;
+    int const fd = bound_socket(sink);
+    auto r = measure(duration, [&](std::atomic_bool const &stop) -> std::uint64_t {
+        if (sender == "sendmmsg")
+            return send_sendmmsg(sink, size, stop);
+        if (sender == "sendmsg")
+            return send_sendmsg(sink, size, stop);
+        if (sender == "gso")
+            return send_gso(sink, size, stop);
+        throw std::invalid_argument("unknown sender " + sender);
+    });
+    ::close(fd);
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    bench::options const options(argc, argv);
+    auto const modes = options.list("modes", "receive,send");
+    auto const receivers = options.list("receivers", "recvmmsg,recvmsg,multishot,multishot-gro");
+    auto const senders = options.list("senders", "sendmmsg,sendmsg,gso");
+    auto const sizes = options.sizes("sizes", "64,512,1400");
+    double const duration = options.get("duration", 1.0);
+    bool const json = options.flag("json");
+
+    if (json)
+        std::puts("[");
+    else
+        std::printf("%-8s %-14s %6s %12s %10s %12s %10s\n", "mode", "variant", "size", "dgram/s", "MiB/s", "cpu ns/dgram", "lost");
+
+    bool first = true;
+    for (auto const &mode : modes) {
+        auto const &variants = mode == "receive" ? receivers : senders;
+        for (auto const size : sizes) {
+            for (auto const &variant : variants) {
+                auto const r = mode == "receive" ? run_receive(variant, size, duration) : run_send(variant, size, duration);
+                double const rate = static_cast<double>(r.datagrams) / r.seconds;
+                double const mib = rate * static_cast<double>(size) / (1024.0 * 1024.0);
+                double const cpu = r.datagrams != 0 ? static_cast<double>(r.cpu) / static_cast<double>(r.datagrams) : 0.0;
+                if (json) {
+                    std::printf("%s  {\"mode\":\"%s\",\"variant\":\"%s\",\"size\":%zu,\"datagrams_per_second\":%.1f,\"mib_per_second\":%.2f,"
+                                "\"cpu_ns_per_datagram\":%.1f,\"lost\":%" PRIu64 "}",
+                        first ? "" : ",\n", mode.c_str(), variant.c_str(), size, rate, mib, cpu, r.lost);
+                } else {
+                    std::printf("%-8s %-14s %6zu %12.0f %10.2f %12.1f %10" PRIu64 "\n", mode.c_str(), variant.c_str(), size, rate, mib, cpu, r.lost);
+                }
+                std::fflush(stdout);
+                first = false;
+            }
+        }
+    }
+    if (json)
+        std::puts("\n]");
+}
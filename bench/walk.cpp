@@ -0,0 +1,156 @@
+/**
+ * Directory tree walk benchmark, `tcx::async_walk` against `nftw()`.
+ *
+ * Both walks stat every entry below `--root` without following symbolic links.
+ * With `--drop-caches` the page, dentry and inode caches are dropped before every walk (requires root),
+ * otherwise every walk after the first one runs with warm caches.
+ *
+ * Results are written to stdout as a table, or as a JSON array with `--json`.
+ *
+ * Usage: bench_walk [--root=/usr] [--walkers=nftw,tcx] [--in-flight=64,256,1024] [--readers=1,4]
+ *                   [--repetitions=3] [--drop-caches] [--json]
+ */
+
+#include "common.hpp"
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+
+#include <tcx/async/ioring.hpp>
+#include <tcx/unsynchronized_execution_context.hpp>
+
+namespace {
+
+bool json = false;
+bool first_result = true;
+
+struct walk_result {
+    std::uint64_t entries = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t elapsed = 0;
+};
+
+void drop_caches()
+{
+    ::sync();
+    int const fd = ::open("/proc/sys/vm/drop_caches", O_WRONLY | O_CLOEXEC);
+    if (fd < 0 || ::write(fd, "3", 1) != 1)
+        throw std::system_error(errno, std::system_category(), "/proc/sys/vm/drop_caches");
+    ::close(fd);
+}
+
+walk_result *nftw_result = nullptr;
+
+int nftw_visit(char const *, struct ::stat const *stat, int type, FTW *)
+{
+    ++nftw_result->entries;
+    if (type == FTW_F)
+        nftw_result->bytes += static_cast<std::uint64_t>(stat->st_size);
+    return FTW_CONTINUE;
+}
+
+walk_result run_nftw(std::string const &root)
+{
+    walk_result result;
+    nftw_result = &result;
+    std::uint64_t const begin = bench::now();
+    if (::nftw(root.c_str(), nftw_visit, 512, FTW_PHYS | FTW_ACTIONRETVAL) != 0)
+        throw std::system_error(errno, std::system_category(), "nftw");
+    result.elapsed = bench::now() - begin;
+    return result;
+}
+
+walk_result run_tcx(std::string const &root, std::size_t in_flight, std::size_t readers)
+{
+    tcx::unsynchronized_execution_context executor;
+    auto ring = tcx::unsynchronized_uring_context<>::create(static_cast<unsigned>(in_flight)).value();
+
+    walk_result result;
+    tcx::walk_options options;
+    options.max_in_flight = in_flight;
+    options.readers = readers;
+    options.mask = STATX_TYPE | STATX_MODE | STATX_SIZE;
+
+    bool done = false;
+    std::error_code error;
+    std::uint64_t const begin = bench::now();
+    tcx::async_walk(
+        executor, ring, root.c_str(), [&result](tcx::walk_entry const &entry) {
+            ++result.entries;
+            if (entry.stat && S_ISREG(entry.stat->stx_mode))
+                result.bytes += entry.stat->stx_size;
+        },
+        options, [&](auto const &walked) {
+            if (walked.index() == 0)
+                error = std::get<0>(walked);
+            done = true;
+        });
+    while (!done) {
+        if (auto r = ring.run_once(); r.has_error())
+            throw std::system_error(r.error(), std::system_category(), "run_once");
+        executor.run();
+    }
+    result.elapsed = bench::now() - begin;
+    if (error)
+        throw std::system_error(error, "async_walk");
+    return result;
+}
+
+void report(char const *walker, std::size_t in_flight, std::size_t readers, bool cold, walk_result const &result)
+{
+    double const seconds = static_cast<double>(result.elapsed) / 1e9;
+    double const rate = static_cast<double>(result.entries) / seconds;
+    if (json) {
+        std::printf("%s  {\"walker\":\"%s\",\"in_flight\":%zu,\"readers\":%zu,\"cache\":\"%s\",\"entries\":%" PRIu64 ",\"bytes\":%" PRIu64 ",\"seconds\":%.6f,\"entries_per_second\":%.0f}",
+            first_result ? "" : ",\n", walker, in_flight, readers, cold ? "cold" : "warm", result.entries, result.bytes, seconds, rate);
+    } else {
+        std::printf("%-5s %9zu %8zu %5s %10" PRIu64 " %10.3f ms %12.0f entries/s\n", walker, in_flight, readers, cold ? "cold" : "warm", result.entries, seconds * 1e3, rate);
+    }
+    std::fflush(stdout);
+    first_result = false;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    bench::options const options(argc, argv);
+    auto const root = options.get("root", std::string("/usr"));
+    auto const walkers = options.list("walkers", "nftw,tcx");
+    auto const in_flight = options.sizes("in-flight", "64,256,1024");
+    auto const readers = options.sizes("readers", "1,4");
+    auto const repetitions = static_cast<int>(options.get("repetitions", 3.0));
+    bool const cold = options.flag("drop-caches");
+    json = options.flag("json");
+
+    if (json)
+        std::puts("[");
+    else
+        std::printf("%-5s %9s %8s %5s %10s %13s\n", "walk", "in flight", "readers", "cache", "entries", "time");
+
+    for (auto const &walker : walkers) {
+        for (int repetition = 0; repetition < repetitions; ++repetition) {
+            if (walker == "nftw") {
+                if (cold)
+                    drop_caches();
+                report("nftw", 1, 1, cold, run_nftw(root));
+                continue;
+            }
+            for (auto const depth : in_flight) {
+                for (auto const count : readers) {
+                    if (cold)
+                        drop_caches();
+                    report("tcx", depth, count, cold, run_tcx(root, depth, count));
+                }
+            }
+        }
+    }
+    if (json)
+        std::puts("\n]");
+}
@@ -0,0 +1,124 @@
+#ifndef TCX_AFFINITY_HPP
+#define TCX_AFFINITY_HPP
+
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+#include <sched.h>
+
+#include <tcx/native/result.hpp>
+
+namespace tcx {
+
+/**
+ * @brief a set of CPUs a thread may run on, wraps `cpu_set_t`
+ */
+class cpu_set {
+public:
+    cpu_set() noexcept
+    {
+        CPU_ZERO(&m_set);
+    }
+
+    cpu_set(std::initializer_list<unsigned> cpus) noexcept
+        : cpu_set()
+    {
+        for (unsigned const cpu : cpus)
+            add(cpu);
+    }
+
+    void add(unsigned cpu) noexcept
+    {
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &m_set);
+    }
+
+    [[nodiscard]] bool contains(unsigned cpu) const noexcept
+    {
+        return cpu < CPU_SETSIZE && CPU_ISSET(cpu, &m_set);
+    }
+
+    [[nodiscard]] std::size_t count() const noexcept
+    {
+        return static_cast<std::size_t>(CPU_COUNT(&m_set));
+    }
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return count() == 0;
+    }
+
+    /**
+     * @brief the CPUs in the set, in ascending order
+     */
+    [[nodiscard]] std::vector<unsigned> cpus() const;
+
+    /**
+     * @brief the CPUs in both sets
+     */
+    [[nodiscard]] friend cpu_set operator&(cpu_set a, cpu_set const &b) noexcept
+    {
+        CPU_AND(&a.m_set, &a.m_set, &b.m_set);
+        return a;
+    }
+
+    [[nodiscard]] cpu_set_t &native() noexcept
+    {
+        return m_set;
+    }
+
+    [[nodiscard]] cpu_set_t const &native() const noexcept
+    {
+        return m_set;
+    }
+
+private:
+    cpu_set_t m_set;
+};
+
+/**
+ * @brief a NUMA node and it's CPUs
+ */
+struct numa_node {
+    unsigned id;
+    tcx::cpu_set cpus;
+};
+
+/**
+ * @brief the NUMA nodes with CPUs the calling thread may run on, read from `/sys/devices/system/node`
+ *
+ * Each node only has the CPUs allowed by the calling thread's affinity, so a cpuset or `taskset` is respected,
+ * and nodes left without any are skipped.
+ * Without NUMA support every CPU the calling thread may run on is reported as node 0.
+ */
+[[nodiscard]] std::vector<numa_node> numa_nodes();
+
+/**
+ * @brief the node the CPU belongs to, or 0 if it's not found
+ */
+[[nodiscard]] unsigned numa_node_of(unsigned cpu);
+
+/**
+ * @brief the CPU the calling thread is running on, which may change right after
+ */
+[[nodiscard]] unsigned current_cpu() noexcept;
+
+[[nodiscard]] native::result<cpu_set> this_thread_affinity() noexcept;
+
+/**
+ * @brief restricts the calling thread to the CPUs in `cpus`
+ */
+native::result<void> set_this_thread_affinity(cpu_set const &cpus) noexcept;
+
+/**
+ * @brief makes the memory the calling thread touches first be allocated from `node` when it has free memory
+ *
+ * Linux allocates a page on the node of the thread touching it first by default,
+ * this keeps it so after the scheduler moves the thread somewhere else.
+ */
+native::result<void> prefer_memory_node(unsigned node) noexcept;
+
+} // namespace tcx
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef TCX_ASYNC_BIND_PRIORITY_HPP
+#define TCX_ASYNC_BIND_PRIORITY_HPP
+
+#include <concepts>
+#include <stop_token>
+#include <type_traits>
+#include <utility>
+
+#include <tcx/async/concepts.hpp>
+#include <tcx/priority.hpp>
+
+namespace tcx {
+
+/**
+ * @brief A completion handler with an associated `tcx::priority`.
+
+ * The asynchronous operations post the handler to that lane of the executor,
+ * so the completions of latency sensitive operations don't wait behind bulk ones.
+
+ * @see tcx::bind_priority
+ */
+template <typename F>
+struct priority_binder {
+    using handler_type = F;
+
+    template <typename G>
+    priority_binder(tcx::priority priority, G &&handler)
+        : m_priority(priority)
+        , m_handler(std::forward<G>(handler))
+    {
+    }
+
+    [[nodiscard]] tcx::priority get_priority() const noexcept
+    {
+        return m_priority;
+    }
+
+    [[nodiscard]] handler_type &get() noexcept
+    {
+        return m_handler;
+    }
+
+    [[nodiscard]] handler_type const &get() const noexcept
+    {
+        return m_handler;
+    }
+
+    [[nodiscard]] std::stop_token get_stop_token() const noexcept requires tcx::impl::has_stop_token<F>
+    {
+        return m_handler.get_stop_token();
+    }
+
+    template <typename R>
+    requires tcx::impl::has_async_transform<F, R>
+    auto async_transform()
+    {
+        using transformed_type = decltype(m_handler.template async_transform<R>());
+        return priority_binder<transformed_type>(m_priority, m_handler.template async_transform<R>());
+    }
+
+    auto async_result() requires tcx::impl::has_async_result<F>
+    {
+        return m_handler.async_result();
+    }
+
+    template <typename... Args>
+    requires std::invocable<F &, Args...>
+    decltype(auto) operator()(Args &&...args)
+    {
+        return m_handler(std::forward<Args>(args)...);
+    }
+
+private:
+    tcx::priority m_priority;
+    F m_handler;
+};
+
+/**
+ * @brief Associates a `tcx::priority` with a completion handler.
+ * @ingroup completion_objects
+
+ * @code
+ * tcx::unsynchronized_execution_context ctx(3);
+ * tcx::async_recv(ctx, ring, control_fd, buf, len, tcx::bind_priority(tcx::high_priority, handler));
+ * @endcode
+
+ * @see tcx::priority_binder
+ */
+template <typename F>
+auto bind_priority(tcx::priority priority, F &&f)
+{
+    return priority_binder<std::remove_cvref_t<F>>(priority, std::forward<F>(f));
+}
+
+namespace impl {
+
+    /**
+     * @brief returns the priority associated with `f`, or `tcx::normal_priority` if there's none
+     */
+    template <typename F>
+    tcx::priority associated_priority(F const &f) noexcept
+    {
+        if constexpr (tcx::impl::has_priority<F>)
+            return f.get_priority();
+        else
+            return tcx::normal_priority;
+    }
+
+} // namespace impl
+
+} // namespace tcx
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef TCX_ASYNC_BIND_STOP_TOKEN_HPP
+#define TCX_ASYNC_BIND_STOP_TOKEN_HPP
+
+#include <concepts>
+#include <stop_token>
+#include <type_traits>
+#include <utility>
+
+#include <tcx/async/concepts.hpp>
+
+namespace tcx {
+
+/**
+ * @brief A completion handler with an associated `std::stop_token`.
+
+ * Requesting a stop on the associated `std::stop_source` cancels the pending operation,
+ * which then completes with `ECANCELED` (or with the partial result, if the operation had already made progress).
+
+ * @attention
+ * When used with a `tcx::unsynchronized_uring_context`, the stop must be requested from the thread
+ * that submits to and reaps from the ring, since the cancellation request is submitted from the thread calling `request_stop()`.
+
+ * @see tcx::bind_stop_token
+ */
+template <typename F>
+struct stop_token_binder {
+    using handler_type = F;
+
+    template <typename G>
+    stop_token_binder(std::stop_token token, G &&handler)
+        : m_token(std::move(token))
+        , m_handler(std::forward<G>(handler))
+    {
+    }
+
+    [[nodiscard]] std::stop_token get_stop_token() const noexcept
+    {
+        return m_token;
+    }
+
+    [[nodiscard]] handler_type &get() noexcept
+    {
+        return m_handler;
+    }
+
+    [[nodiscard]] handler_type const &get() const noexcept
+    {
+        return m_handler;
+    }
+
+    [[nodiscard]] auto get_priority() const noexcept requires tcx::impl::has_priority<F>
+    {
+        return m_handler.get_priority();
+    }
+
+    template <typename R>
+    requires tcx::impl::has_async_transform<F, R>
+    auto async_transform()
+    {
+        using transformed_type = decltype(m_handler.template async_transform<R>());
+        return stop_token_binder<transformed_type>(m_token, m_handler.template async_transform<R>());
+    }
+
+    auto async_result() requires tcx::impl::has_async_result<F>
+    {
+        return m_handler.async_result();
+    }
+
+    template <typename... Args>
+    requires std::invocable<F &, Args...>
+    decltype(auto) operator()(Args &&...args)
+    {
+        return m_handler(std::forward<Args>(args)...);
+    }
+
+private:
+    std::stop_token m_token;
+    F m_handler;
+};
+
+/**
+ * @brief Associates a `std::stop_token` with a completion handler.
+ * @ingroup completion_objects
+
+ * @code
+ * std::stop_source source;
+ * tcx::async_recv(ctx, ring, fd, buf, len, tcx::bind_stop_token(source.get_token(), handler));
+ * source.request_stop(); // handler receives ECANCELED
+ * @endcode
+
+ * @see tcx::stop_token_binder
+ */
+template <typename F>
+auto bind_stop_token(std::stop_token token, F &&f)
+{
+    return stop_token_binder<std::remove_cvref_t<F>>(std::move(token), std::forward<F>(f));
+}
+
+namespace impl {
+
+    /**
+     * @brief returns the stop token associated with `f`, or a token without a stop state if there's none
+     */
+    template <typename F>
+    std::stop_token associated_stop_token(F const &f) noexcept
+    {
+        if constexpr (tcx::impl::has_stop_token<F>)
+            return f.get_stop_token();
+        else
+            return std::stop_token {};
+    }
+
+} // namespace impl
+
+} // namespace tcx
+
+#endif
@@ -2,6 +2,8 @@
 #define TCX_ASYNC_impl_CONCEPTS_HPP
 
 #include <concepts>
+#include <cstdint>
+#include <stop_token>
 #include <system_error>
 #include <type_traits>
 #include <variant>
@@ -31,6 +33,31 @@ namespace impl {
         };
     };
 
+    template <typename F>
+    concept has_stop_token = requires(F const &f)
+    {
+        {
+            f.get_stop_token()
+            } -> std::convertible_to<std::stop_token>;
+    };
+
+    template <typename F>
+    concept has_priority = requires(F const &f)
+    {
+        {
+            f.get_priority()
+            } -> std::convertible_to<std::uint8_t>;
+    };
+
+    /**
+     * @brief a ring callback whose completion is posted to the executor as is, see `tcx::impl::fused_completion`
+     */
+    template <typename F>
+    concept fuses_completion = requires
+    {
+        typename F::fused_completion_tag;
+    };
+
     template <typename F, typename T>
     consteval bool is_completion_handler()
     {
@@ -3,6 +3,7 @@
 
 #include <sys/epoll.h>
 #include <system_error>
+#include <tcx/async/bind_priority.hpp>
 #include <tcx/async/wrap_op.hpp>
 #include <tcx/native/handle.hpp>
 #include <tcx/services/epoll_service.hpp>
@@ -22,9 +23,9 @@ namespace impl {
         template <typename E, typename F>
         static void call(E &executor, tcx::epoll_service &service, tcx::native::handle_type fd, sockaddr *addr, std::size_t *addr_len, int flags, F &&f)
         {
-
-            service.async_poll_add(fd, EPOLLIN, [&executor, f = std::forward<F>(f), addr, addr_len, flags, fd](std::int32_t result) mutable {
-                executor.post([f = std::move(f), result, addr, addr_len, flags, fd]() mutable {
+            auto const priority = tcx::impl::associated_priority(f);
+            service.async_poll_add(fd, EPOLLIN, [&executor, priority, f = std::forward<F>(f), addr, addr_len, flags, fd](std::int32_t result) mutable {
+                tcx::impl::dispatch(executor, priority, [f = std::move(f), result, addr, addr_len, flags, fd]() mutable {
                     if (result < 0)
                         f(std::error_code { -result, std::system_category() }, tcx::native::invalid_handle);
                     else {
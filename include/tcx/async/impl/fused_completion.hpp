@@ -0,0 +1,85 @@
+#ifndef TCX_ASYNC_IMPL_FUSED_COMPLETION_HPP
+#define TCX_ASYNC_IMPL_FUSED_COMPLETION_HPP
+
+#include <cstdint>
+#include <stop_token>
+#include <type_traits>
+#include <utility>
+
+#include <liburing.h>
+
+#include <tcx/async/bind_priority.hpp>
+#include <tcx/async/concepts.hpp>
+#include <tcx/priority.hpp>
+#include <tcx/trace.hpp>
+
+namespace tcx::impl {
+
+/**
+ * @brief the ring callback of a single shot operation, holding the handler and the executor it runs on
+ *
+ * A ring recognizes it (see `tcx::impl::fuses_completion`) and posts the completion itself to the executor,
+ * as a task only holding a pointer to it, instead of moving the handler out to a task of it's own.
+ * The operation then costs a single allocation, the ring's completion, which is kept alive until the handler ran.
+ * `finish` turns the result of the completion entry into the call to the handler.
+ */
+template <typename E, typename F, typename Finish>
+class fused_completion {
+public:
+    using fused_completion_tag = void;
+
+    template <typename G>
+    fused_completion(E &executor, G &&handler, Finish finish)
+        : m_executor(&executor)
+        , m_priority(tcx::impl::associated_priority(handler))
+        , m_handler(std::forward<G>(handler))
+        , m_finish(std::move(finish))
+    {
+    }
+
+    [[nodiscard]] std::stop_token get_stop_token() const noexcept requires tcx::impl::has_stop_token<F>
+    {
+        return m_handler.get_stop_token();
+    }
+
+    /**
+     * @brief stores `result` and hands `task` to the executor, `task` must end up calling `run()`
+     */
+    template <typename Task>
+    void dispatch(std::uint64_t id, std::int32_t result, Task &&task)
+    {
+        m_result = result;
+        tcx::trace::dispatch(*m_executor, id, m_priority, std::forward<Task>(task));
+    }
+
+    void run()
+    {
+        m_finish(m_handler, m_result);
+    }
+
+    // for rings that don't fuse completions, the handler is moved out to a task of it's own
+    template <typename Service>
+    void operator()(Service &, io_uring_cqe const *cqe)
+    {
+        tcx::trace::dispatch(*m_executor, cqe->user_data, m_priority, [handler = std::move(m_handler), finish = std::move(m_finish), result = cqe->res]() mutable {
+            finish(handler, result);
+        });
+    }
+
+private:
+    E *m_executor;
+    tcx::priority m_priority;
+    F m_handler;
+    [[no_unique_address]] Finish m_finish;
+    std::int32_t m_result = 0;
+};
+
+template <typename E, typename F, typename Finish>
+auto fuse_completion(E &executor, F &&handler, Finish finish)
+{
+    return fused_completion<E, std::remove_cvref_t<F>, Finish>(executor, std::forward<F>(handler), std::move(finish));
+}
+
+} // namespace tcx::impl
+
+#endif
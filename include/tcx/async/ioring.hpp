@@ -6,13 +6,17 @@
 #include <tcx/services/uring_service.hpp>
 
 #include <tcx/async/ioring/accept.hpp>
+#include <tcx/async/ioring/cancel.hpp>
 #include <tcx/async/ioring/close.hpp>
 #include <tcx/async/ioring/connect.hpp>
 #include <tcx/async/ioring/open.hpp>
 #include <tcx/async/ioring/poll.hpp>
 #include <tcx/async/ioring/read.hpp>
+#include <tcx/async/ioring/read_until.hpp>
 #include <tcx/async/ioring/recv.hpp>
 #include <tcx/async/ioring/send.hpp>
+#include <tcx/async/ioring/send_file.hpp>
 #include <tcx/async/ioring/sleep.hpp>
 #include <tcx/async/ioring/stat.hpp>
+#include <tcx/async/ioring/walk.hpp>
 #include <tcx/async/ioring/write.hpp>
@@ -1,12 +1,18 @@
 #ifndef TCX_ASYNC_IORING_ACCEPT_HPP
 #define TCX_ASYNC_IORING_ACCEPT_HPP
 
+#include <tcx/async/concepts.hpp>
+#include <tcx/async/impl/fused_completion.hpp>
 #include <tcx/async/wrap_op.hpp>
 #include <tcx/native/handle.hpp>
 #include <tcx/services/uring_service.hpp>
+#include <tcx/trace.hpp>
 
+#include <cstdint>
 #include <memory>
+#include <system_error>
 #include <utility>
+#include <variant>
 
 #include <sys/socket.h> // struct ::sockaddr, using ::socklen_t
 
@@ -18,29 +24,27 @@ namespace impl {
         template <typename E, typename F>
         static auto call(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, sockaddr *addr, std::size_t *addr_len, int flags, F &&f)
         {
+            using variant_type = std::variant<std::error_code, result_type>;
+
             if (addr_len == nullptr) {
-                return service.async_accept(fd, addr, nullptr, flags, [&executor, f = std::forward<F>(f)](std::int32_t result) mutable {
-                    return executor.post([f = std::move(f), result]() mutable {
-                        if (result < 0)
-                            return f(std::error_code { -result, std::system_category() }, tcx::native::invalid_handle);
-                        else
-                            return f(std::error_code {}, result);
-                    });
-                });
+                return service.async_accept(fd, addr, nullptr, flags, tcx::impl::fuse_completion(executor, std::forward<F>(f), [](auto &f, std::int32_t result) {
+                    if (result < 0)
+                        return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+                    else
+                        return f(variant_type(std::in_place_index<1>, result));
+                }));
             } else {
-                auto sock_len = std::make_unique<socklen_t>();
+                auto sock_len = std::make_unique<socklen_t>(static_cast<socklen_t>(*addr_len));
                 auto const p = sock_len.get();
-                return service.async_accept(fd, addr, p, flags, [sock_len = std::move(sock_len), addr_len, &executor, f = std::forward<F>(f)](std::int32_t result) mutable {
-                    return executor.post([sock_len = std::move(sock_len), addr_len, f = std::move(f), result]() mutable {
-                        if (result < 0)
-                            return f(std::error_code { -result, std::system_category() }, tcx::native::invalid_handle);
-                        else {
-                            *addr_len = *sock_len;
-                            sock_len.reset();
-                            return f(std::error_code {}, result);
-                        }
-                    });
-                });
+                return service.async_accept(fd, addr, p, flags, tcx::impl::fuse_completion(executor, std::forward<F>(f), [sock_len = std::move(sock_len), addr_len](auto &f, std::int32_t result) mutable {
+                    if (result < 0)
+                        return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+                    else {
+                        *addr_len = *sock_len;
+                        sock_len.reset();
+                        return f(variant_type(std::in_place_index<1>, result));
+                    }
+                }));
             }
         }
     };
@@ -0,0 +1,112 @@
+#ifndef TCX_ASYNC_IORING_CANCEL_HPP
+#define TCX_ASYNC_IORING_CANCEL_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <system_error>
+#include <utility>
+#include <variant>
+
+#include <tcx/async/bind_priority.hpp>
+#include <tcx/async/concepts.hpp>
+#include <tcx/async/wrap_op.hpp>
+#include <tcx/native/handle.hpp>
+#include <tcx/services/uring_service.hpp>
+#include <tcx/trace.hpp>
+
+namespace tcx {
+namespace impl {
+
+    // completes with the number of operations cancelled, not finding any isn't an error for a group cancellation
+    template <typename E, typename F>
+    auto cancel_callback(E &executor, F &&f)
+    {
+        using variant_type = std::variant<std::error_code, std::size_t>;
+
+        auto const priority = tcx::impl::associated_priority(f);
+        return [&executor, priority, f = std::forward<F>(f)](tcx::uring_context auto &, io_uring_cqe const *result) mutable {
+            return tcx::trace::dispatch(executor, result->user_data, priority, [f = std::move(f), result = result->res]() mutable {
+                if (result < 0 && result != -ENOENT)
+                    return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+                else
+                    return f(variant_type(std::in_place_index<1>, static_cast<std::size_t>(result < 0 ? 0 : result)));
+            });
+        };
+    }
+
+    struct ioring_cancel_fd_operation {
+        using result_type = std::size_t;
+
+        template <typename E, typename F>
+        static tcx::native::result<tcx::uring_context_storage::operation_t> call(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, F &&f)
+        {
+            using variant_type = std::variant<std::error_code, result_type>;
+
+            if (fd == tcx::native::invalid_handle) {
+                // a closed or moved from handle has nothing to cancel, it must not reach the operations of other files
+                auto const priority = tcx::impl::associated_priority(f);
+                tcx::impl::post(executor, priority, [f = std::forward<F>(f)]() mutable {
+                    return f(variant_type(std::in_place_index<0>, EBADF, std::system_category()));
+                });
+                return tcx::native::result<tcx::uring_context_storage::operation_t>::from_error(EBADF);
+            }
+            return service.async_cancel_all(fd, tcx::impl::cancel_callback(executor, std::forward<F>(f)));
+        }
+    };
+
+    struct ioring_cancel_any_operation {
+        using result_type = std::size_t;
+
+        template <typename E, typename F>
+        static auto call(E &executor, tcx::uring_context auto &service, F &&f)
+        {
+            return service.async_cancel_any(tcx::impl::cancel_callback(executor, std::forward<F>(f)));
+        }
+    };
+
+} // namespace impl
+
+/**
+ * @ingroup ioring_service
+ * @brief Cancels every pending operation issued on `fd` with a single submission.
+
+ * Useful when tearing down a connection, as it avoids keeping track of each individual operation.
+ * The cancelled operations complete with `ECANCELED`.
+ * The result is the number of operations that were cancelled.
+ * Fails with `EBADF` if `fd` is `tcx::native::invalid_handle`.
+ */
+template <typename E, typename F>
+requires tcx::completion_handler<F, tcx::impl::ioring_cancel_fd_operation::result_type>
+auto async_cancel_fd(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, F &&f)
+{
+    return tcx::impl::wrap_op<tcx::impl::ioring_cancel_fd_operation>::call(executor, service, std::forward<F>(f), fd);
+}
+
+/**
+ * @ingroup ioring_service
+ * @brief same as `tcx::async_cancel_fd()`
+ */
+template <typename E, typename F>
+requires tcx::completion_handler<F, tcx::impl::ioring_cancel_fd_operation::result_type>
+auto async_cancel(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, F &&f)
+{
+    return tcx::async_cancel_fd(executor, service, fd, std::forward<F>(f));
+}
+
+/**
+ * @ingroup ioring_service
+ * @brief Cancels every pending operation in `service` with a single submission, whatever it was issued on.
+
+ * The cancelled operations complete with `ECANCELED`.
+ * The result is the number of operations that were cancelled.
+ */
+template <typename E, typename F>
+requires tcx::completion_handler<F, tcx::impl::ioring_cancel_any_operation::result_type>
+auto async_cancel_any(E &executor, tcx::uring_context auto &service, F &&f)
+{
+    return tcx::impl::wrap_op<tcx::impl::ioring_cancel_any_operation>::call(executor, service, std::forward<F>(f));
+}
+
+} // namespace tcx
+
+#endif
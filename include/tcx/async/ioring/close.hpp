@@ -2,9 +2,11 @@
 #define TCX_ASYNC_IORING_CLOSE_HPP
 
 #include <tcx/async/concepts.hpp>
+#include <tcx/async/impl/fused_completion.hpp>
 #include <tcx/async/wrap_op.hpp>
 #include <tcx/native/handle.hpp>
 #include <tcx/services/uring_service.hpp>
+#include <tcx/trace.hpp>
 
 namespace tcx {
 namespace impl {
@@ -15,14 +17,14 @@ namespace impl {
         template <typename E, typename F>
         static auto call(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, F &&f)
         {
-            return service.async_close(fd, [&executor, f = std::forward<F>(f)](tcx::uring_context auto &, io_uring_cqe const *result) mutable {
-                return executor.post([f = std::move(f), result = result->res]() mutable {
-                    if (result < 0)
-                        return f(std::error_code { -result, std::system_category() });
-                    else
-                        return f(std::error_code {});
-                });
-            });
+            using variant_type = std::variant<std::error_code, std::monostate>;
+
+            return service.async_close(fd, tcx::impl::fuse_completion(executor, std::forward<F>(f), [](auto &f, std::int32_t result) {
+                if (result < 0)
+                    return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+                else
+                    return f(variant_type(std::in_place_index<1>));
+            }));
         }
     };
 
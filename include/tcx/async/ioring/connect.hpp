@@ -2,11 +2,17 @@
 #define TCX_ASYNC_IORING_CONNECT_HPP
 
 #include <sys/socket.h>
+#include <tcx/async/concepts.hpp>
+#include <tcx/async/impl/fused_completion.hpp>
 #include <tcx/async/wrap_op.hpp>
 #include <tcx/native/handle.hpp>
 #include <tcx/services/uring_service.hpp>
+#include <tcx/trace.hpp>
 
+#include <cstdint>
+#include <system_error>
 #include <utility>
+#include <variant>
 
 namespace tcx {
 namespace impl {
@@ -17,28 +23,16 @@ namespace impl {
         template <typename E, typename F>
         static auto call(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, sockaddr const *addr, std::size_t const *addr_len, F &&f)
         {
-            if (addr_len == nullptr) [[unlikely]] {
-                return service.async_connect(fd, addr, nullptr, [&executor, f = std::forward<F>(f)](std::int32_t result) mutable {
-                    return executor.post([f = std::move(f), result]() mutable {
-                        if (result < 0)
-                            return f(std::error_code { -result, std::system_category() });
-                        else
-                            return f(std::error_code {});
-                    });
-                });
-            } else {
-                auto sock_len = std::make_unique<socklen_t>(addr_len);
-                auto const p = sock_len.get();
-                return service.async_connect(fd, addr, p, [sock_len = std::move(sock_len), &executor, f = std::forward<F>(f)](std::int32_t result) mutable {
-                    sock_len.reset();
-                    return executor.post([f = std::move(f), result]() mutable {
-                        if (result < 0)
-                            return f(std::error_code { -result, std::system_category() }, static_cast<std::size_t>(0));
-                        else
-                            return f(std::error_code {});
-                    });
-                });
-            }
+            using variant_type = std::variant<std::error_code, std::monostate>;
+
+            // the kernel copies the address when the request is issued, so it doesn't have to outlive the call
+            auto const sock_len = addr_len == nullptr ? socklen_t {} : static_cast<socklen_t>(*addr_len);
+            return service.async_connect(fd, addr, sock_len, tcx::impl::fuse_completion(executor, std::forward<F>(f), [](auto &f, std::int32_t result) {
+                if (result < 0)
+                    return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+                else
+                    return f(variant_type(std::in_place_index<1>));
+            }));
         }
     };
 
@@ -55,7 +49,7 @@ template <typename E, typename F>
 requires tcx::completion_handler<F, tcx::impl::ioring_connect_operation::result_type>
 auto async_connect(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, F &&f)
 {
-    return tcx::async_connect(executor, service, fd, nullptr, nullptr, 0, std::forward<F>(f));
+    return tcx::async_connect(executor, service, fd, nullptr, nullptr, std::forward<F>(f));
 }
 
 } // namespace tcx
@@ -1,6 +1,7 @@
 #ifndef TCX_ASYNC_IORING_OPEN_HPP
 #define TCX_ASYNC_IORING_OPEN_HPP
 
+#include <cstdint>
 #include <stdexcept>
 #include <system_error>
 #include <type_traits>
@@ -9,10 +10,15 @@
 
 #include <fcntl.h>
 
+#include <tcx/async/bind_priority.hpp>
 #include <tcx/async/concepts.hpp>
+#include <tcx/async/impl/fused_completion.hpp>
 #include <tcx/async/wrap_op.hpp>
 #include <tcx/native/handle.hpp>
+#include <tcx/native/string.hpp>
+#include <tcx/services/file_cache.hpp>
 #include <tcx/services/uring_service.hpp>
+#include <tcx/trace.hpp>
 
 namespace tcx {
 namespace impl {
@@ -24,12 +30,30 @@ namespace impl {
         {
             using variant_type = std::variant<std::error_code, result_type>;
 
-            return service.async_open(path, flags, mode, [&executor, f = std::forward<F>(f)](tcx::uring_context auto &, io_uring_cqe const *result) mutable {
-                return executor.post([f = std::move(f), result = result->res]() mutable {
-                    if (result < 0)
-                        return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+            return service.async_open(path, flags, mode, tcx::impl::fuse_completion(executor, std::forward<F>(f), [](auto &f, std::int32_t result) {
+                if (result < 0)
+                    return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+                else
+                    return f(variant_type(std::in_place_index<1>, result));
+            }));
+        }
+    };
+
+    struct file_cache_open_operation {
+        using result_type = tcx::cached_file;
+
+        template <typename E, typename Service, typename F>
+        static void call(E &executor, tcx::file_cache<Service> &cache, char const *path, F &&f)
+        {
+            using variant_type = std::variant<std::error_code, result_type>;
+
+            auto const priority = tcx::impl::associated_priority(f);
+            cache.open(path, [&executor, priority, f = std::forward<F>(f)](std::error_code error, tcx::cached_file file) mutable {
+                tcx::impl::post(executor, priority, [f = std::move(f), error, file = std::move(file)]() mutable {
+                    if (error)
+                        return f(variant_type(std::in_place_index<0>, error));
                     else
-                        return f(variant_type(std::in_place_index<1>, result));
+                        return f(variant_type(std::in_place_index<1>, std::move(file)));
                 });
             });
         }
@@ -92,6 +116,18 @@ auto async_open(E &executor, tcx::uring_context auto &service, char const *path,
     return tcx::async_open(executor, service, path, flags, DEFFILEMODE, std::forward<F>(f));
 }
 
+/**
+ * @ingroup ioring_service
+ * @brief opens `path` through `cache`, reusing the open file when it's still the one at `path`
+ * @see tcx::file_cache
+ */
+template <typename E, typename Service, typename F>
+requires tcx::completion_handler<F, tcx::impl::file_cache_open_operation::result_type>
+auto async_open(E &executor, tcx::file_cache<Service> &cache, tcx::native::c_string path, F &&f)
+{
+    return tcx::impl::wrap_op<tcx::impl::file_cache_open_operation>::call(executor, cache, std::forward<F>(f), path);
+}
+
 } // namespace tcx
 
 #endif
@@ -1,10 +1,16 @@
 #ifndef TCX_ASYNC_IORING_POLL_HPP
 #define TCX_ASYNC_IORING_POLL_HPP
 
+#include <cstdint>
+#include <system_error>
+#include <variant>
+
 #include <tcx/async/concepts.hpp>
+#include <tcx/async/impl/fused_completion.hpp>
 #include <tcx/async/wrap_op.hpp>
 #include <tcx/native/handle.hpp>
 #include <tcx/services/uring_service.hpp>
+#include <tcx/trace.hpp>
 
 namespace tcx {
 namespace impl {
@@ -15,14 +21,14 @@ namespace impl {
         template <typename E, typename F>
         static auto call(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, std::uint32_t events, F &&f)
         {
-            return service.async_poll_add(fd, events, [&executor, f = std::forward<F>(f)](std::int32_t result) mutable {
-                return executor.post([f = std::move(f), result]() mutable {
-                    if (result < 0)
-                        return f(std::error_code { -result, std::system_category() }, 0);
-                    else
-                        return f(std::error_code {}, result);
-                });
-            });
+            using variant_type = std::variant<std::error_code, result_type>;
+
+            return service.async_poll_add(fd, events, tcx::impl::fuse_completion(executor, std::forward<F>(f), [](auto &f, std::int32_t result) {
+                if (result < 0)
+                    return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+                else
+                    return f(variant_type(std::in_place_index<1>, static_cast<result_type>(result)));
+            }));
         }
     };
 
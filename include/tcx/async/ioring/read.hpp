@@ -1,15 +1,20 @@
 #ifndef TCX_ASYNC_IORING_READ_HPP
 #define TCX_ASYNC_IORING_READ_HPP
 
+#include <cstdint>
 #include <cstdio>
 #include <span>
 #include <system_error>
 #include <utility>
 
+#include <tcx/async/bind_priority.hpp>
 #include <tcx/async/concepts.hpp>
+#include <tcx/async/impl/fused_completion.hpp>
 #include <tcx/async/wrap_op.hpp>
 #include <tcx/native/handle.hpp>
+#include <tcx/services/buffered_stream.hpp>
 #include <tcx/services/uring_service.hpp>
+#include <tcx/trace.hpp>
 
 namespace tcx {
 namespace impl {
@@ -22,12 +27,47 @@ namespace impl {
         {
             using variant_type = std::variant<std::error_code, result_type>;
 
-            return service.async_read(fd, buf, len, offset, [&executor, f = std::forward<F>(f)](tcx::uring_context auto &, io_uring_cqe const *result) mutable {
-                return executor.post([f = std::move(f), result = result->res]() mutable {
-                    if (result < 0)
-                        return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+            return service.async_read(fd, buf, len, offset, tcx::impl::fuse_completion(executor, std::forward<F>(f), [](auto &f, std::int32_t result) {
+                if (result < 0)
+                    return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+                else
+                    return f(variant_type(std::in_place_index<1>, static_cast<std::size_t>(result)));
+            }));
+        }
+    };
+
+    struct ioring_read_fixed_operation {
+        using result_type = std::size_t;
+
+        template <typename E, typename F>
+        static auto call(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, void *buf, std::size_t len, off_t offset, int buf_index, F &&f)
+        {
+            using variant_type = std::variant<std::error_code, result_type>;
+
+            return service.async_read_fixed(fd, buf, len, offset, buf_index, tcx::impl::fuse_completion(executor, std::forward<F>(f), [](auto &f, std::int32_t result) {
+                if (result < 0)
+                    return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+                else
+                    return f(variant_type(std::in_place_index<1>, static_cast<std::size_t>(result)));
+            }));
+        }
+    };
+
+    struct buffered_stream_read_operation {
+        using result_type = std::size_t;
+
+        template <typename E, typename Service, typename F>
+        static void call(E &executor, tcx::buffered_stream<Service> &stream, void *buf, std::size_t len, std::size_t minimum, F &&f)
+        {
+            using variant_type = std::variant<std::error_code, result_type>;
+
+            auto const priority = tcx::impl::associated_priority(f);
+            stream.read(buf, len, minimum, [&executor, priority, f = std::forward<F>(f)](std::error_code error, std::size_t read) mutable {
+                tcx::impl::post(executor, priority, [f = std::move(f), error, read]() mutable {
+                    if (error)
+                        return f(variant_type(std::in_place_index<0>, error));
                     else
-                        return f(variant_type(std::in_place_index<1>, static_cast<std::size_t>(result)));
+                        return f(variant_type(std::in_place_index<1>, read));
                 });
             });
         }
@@ -74,6 +114,44 @@ auto async_read(E &executor, tcx::uring_context auto &service, tcx::native::hand
     return tcx::async_read(executor, service, fd, bytes.data(), bytes.size(), -1, std::forward<F>(f));
 }
 
+/**
+ * @ingroup ioring_service
+ * @brief like `tcx::async_read()`, but `buf` must be within the buffer registered at `buf_index`
+ * @see tcx::uring_context_storage::register_buffers()
+ */
+template <typename E, typename F>
+requires tcx::completion_handler<F, tcx::impl::ioring_read_fixed_operation::result_type>
+auto async_read_fixed(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, void *buf, std::size_t len, off_t offset, int buf_index, F &&f)
+{
+    return tcx::impl::wrap_op<tcx::impl::ioring_read_fixed_operation>::call(executor, service, std::forward<F>(f), fd, buf, len, offset, buf_index);
+}
+
+/**
+ * @ingroup ioring_service
+ * @brief reads up to `len` bytes from `stream`, completing as soon as any are available
+ *
+ * Completes with zero bytes at the end of the stream.
+ * @see tcx::buffered_stream
+ */
+template <typename E, typename Service, typename F>
+requires tcx::completion_handler<F, tcx::impl::buffered_stream_read_operation::result_type>
+auto async_read_some(E &executor, tcx::buffered_stream<Service> &stream, void *buf, std::size_t len, F &&f)
+{
+    return tcx::impl::wrap_op<tcx::impl::buffered_stream_read_operation>::call(executor, stream, std::forward<F>(f), buf, len, std::size_t(1));
+}
+
+/**
+ * @ingroup ioring_service
+ * @brief reads exactly `len` bytes from `stream`, or less if the end of the stream is reached first
+ * @see tcx::buffered_stream
+ */
+template <typename E, typename Service, typename F>
+requires tcx::completion_handler<F, tcx::impl::buffered_stream_read_operation::result_type>
+auto async_read(E &executor, tcx::buffered_stream<Service> &stream, void *buf, std::size_t len, F &&f)
+{
+    return tcx::impl::wrap_op<tcx::impl::buffered_stream_read_operation>::call(executor, stream, std::forward<F>(f), buf, len, len);
+}
+
 } // namespace tcx
 
 #endif
@@ -0,0 +1,177 @@
+#ifndef TCX_ASYNC_IORING_READ_UNTIL_HPP
+#define TCX_ASYNC_IORING_READ_UNTIL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <variant>
+
+#include <tcx/async/bind_priority.hpp>
+#include <tcx/async/bind_stop_token.hpp>
+#include <tcx/async/concepts.hpp>
+#include <tcx/async/wrap_op.hpp>
+#include <tcx/dynamic_buffer.hpp>
+#include <tcx/native/handle.hpp>
+#include <tcx/services/uring_service.hpp>
+#include <tcx/trace.hpp>
+#include <tcx/utilities/find_delimiter.hpp>
+
+namespace tcx {
+namespace impl {
+
+    /**
+     * @brief receives into a `tcx::dynamic_buffer` until it contains the delimiter, only the final result is posted to the executor
+     *
+     * Every byte is scanned once, only the last `delimiter.size() - 1` bytes of a receive are scanned again with the next one.
+     */
+    template <typename E, typename Service, typename F>
+    class read_until_operation : public std::enable_shared_from_this<read_until_operation<E, Service, F>> {
+        using variant_type = std::variant<std::error_code, std::size_t>;
+
+        // receives ask for at least this much space, so a slow trickle of bytes doesn't grow the buffer one byte at a time
+        constexpr static std::size_t receive_size = 16 * 1024;
+
+    public:
+        template <typename G>
+        read_until_operation(E &executor, Service &service, int fd, tcx::dynamic_buffer &buffer, std::string delimiter, G &&handler)
+            : m_executor(executor)
+            , m_service(service)
+            , m_fd(fd)
+            , m_buffer(buffer)
+            , m_delimiter(std::move(delimiter))
+            , m_handler(std::forward<G>(handler))
+            , m_token(tcx::impl::associated_stop_token(m_handler))
+        {
+        }
+
+        read_until_operation(read_until_operation const &) = delete;
+        read_until_operation &operator=(read_until_operation const &) = delete;
+
+        void start()
+        {
+            scan(0);
+        }
+
+    private:
+        void scan(std::uint64_t id)
+        {
+            std::size_t const size = m_buffer.size();
+            std::size_t const found = tcx::utilities::find_delimiter(m_buffer.data() + m_scanned, size - m_scanned, m_delimiter.data(), m_delimiter.size());
+            if (found != tcx::utilities::delimiter_not_found)
+                return finish(id, m_scanned + found + m_delimiter.size());
+            if (size >= m_delimiter.size())
+                m_scanned = std::max(m_scanned, size - m_delimiter.size() + 1);
+
+            if (m_token.stop_requested())
+                m_error = std::error_code(ECANCELED, std::system_category());
+            else if (size >= m_buffer.max_size())
+                m_error = std::make_error_code(std::errc::no_buffer_space);
+            if (m_error)
+                return finish(id, 0);
+
+            auto const space = m_buffer.prepare(std::max(receive_size, m_buffer.capacity() - size));
+            auto const submitted = m_service.async_recv(m_fd, space.data(), space.size(), 0, [self = this->shared_from_this()](Service &, io_uring_cqe const *result) {
+                self->on_received(result->user_data, result->res);
+            });
+            if (submitted.has_error()) {
+                m_error = std::error_code(submitted.error(), std::system_category());
+                finish(id, 0);
+            }
+        }
+
+        void on_received(std::uint64_t id, int result)
+        {
+            if (result < 0) {
+                m_error = std::error_code(-result, std::system_category());
+                return finish(id, 0);
+            }
+            if (result == 0)
+                return finish(id, 0);
+            m_buffer.commit(static_cast<std::size_t>(result));
+            scan(id);
+        }
+
+        void finish(std::uint64_t id, std::size_t length)
+        {
+            tcx::trace::dispatch(m_executor, id, tcx::impl::associated_priority(m_handler), [self = this->shared_from_this(), length]() mutable {
+                auto &handler = self->m_handler;
+                if (self->m_error)
+                    return handler(variant_type(std::in_place_index<0>, self->m_error));
+                else
+                    return handler(variant_type(std::in_place_index<1>, length));
+            });
+        }
+
+        E &m_executor;
+        Service &m_service;
+        int m_fd;
+        tcx::dynamic_buffer &m_buffer;
+        std::string m_delimiter;
+        std::size_t m_scanned = 0;
+
+        F m_handler;
+        std::stop_token m_token;
+        std::error_code m_error;
+    };
+
+    struct ioring_read_until_operation {
+        using result_type = std::size_t;
+
+        template <typename E, typename F>
+        static void call(E &executor, tcx::uring_context auto &service, int fd, tcx::dynamic_buffer &buffer, std::string_view delimiter, F &&f)
+        {
+            if (delimiter.empty()) {
+                // it would be found right away, completing with zero like a closed connection
+                using variant_type = std::variant<std::error_code, result_type>;
+                auto const priority = tcx::impl::associated_priority(f);
+                tcx::impl::post(executor, priority, [f = std::forward<F>(f)]() mutable {
+                    return f(variant_type(std::in_place_index<0>, std::make_error_code(std::errc::invalid_argument)));
+                });
+                return;
+            }
+
+            using service_type = std::remove_reference_t<decltype(service)>;
+            using operation_type = read_until_operation<E, service_type, std::remove_cvref_t<F>>;
+            std::make_shared<operation_type>(executor, service, fd, buffer, std::string(delimiter), std::forward<F>(f))->start();
+        }
+    };
+
+} // namespace impl
+
+/**
+ * @ingroup ioring_service
+ * @brief receives from `fd` into `buffer` until it contains `delimiter`
+ *
+ * The completion is invoked with the length of the first message in `buffer`, including the delimiter,
+ * or with zero if the peer closed the connection before sending it.
+ * Bytes received after the delimiter are left in `buffer` after the message, so the caller should `consume()` the message
+ * and call this again, which completes without receiving if the next message is already there.
+ * Fails with `std::errc::no_buffer_space` if `buffer` reaches its `max_size()` without a delimiter,
+ * and with `std::errc::invalid_argument` if `delimiter` is empty.
+ * `buffer` must stay valid until the operation completes.
+ */
+template <typename E, typename F>
+requires tcx::completion_handler<F, tcx::impl::ioring_read_until_operation::result_type>
+auto async_read_until(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, tcx::dynamic_buffer &buffer, std::string_view delimiter, F &&f)
+{
+    return tcx::impl::wrap_op<tcx::impl::ioring_read_until_operation>::call(executor, service, std::forward<F>(f), fd, buffer, delimiter);
+}
+
+/**
+ * @ingroup ioring_service
+ * @brief like the above, with a single byte delimiter
+ */
+template <typename E, typename F>
+requires tcx::completion_handler<F, tcx::impl::ioring_read_until_operation::result_type>
+auto async_read_until(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, tcx::dynamic_buffer &buffer, char delimiter, F &&f)
+{
+    return tcx::async_read_until(executor, service, fd, buffer, std::string_view(&delimiter, 1), std::forward<F>(f));
+}
+
+} // namespace tcx
+
+#endif
@@ -2,29 +2,35 @@
 #define TCX_ASYNC_IORING_RECV_HPP
 
 #include <cstddef>
+#include <cstdint>
+#include <tcx/async/concepts.hpp>
+#include <tcx/async/impl/fused_completion.hpp>
 #include <tcx/async/wrap_op.hpp>
 #include <tcx/native/handle.hpp>
 #include <tcx/services/uring_service.hpp>
+#include <tcx/trace.hpp>
 
 #include <span>
+#include <system_error>
 #include <utility>
+#include <variant>
 
 namespace tcx {
 namespace impl {
     struct ioring_recv_operation {
         using result_type = std::size_t;
 
-        template <typename E, typename S, typename F>
+        template <typename E, typename F>
         static auto call(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, void *buf, std::size_t buf_len, int flags, F &&f)
         {
-            return service.async_recv(fd, buf, buf_len, flags, [&executor, f = std::forward<F>(f)](std::int32_t result) mutable {
-                return executor.post([f = std::move(f), result]() mutable {
-                    if (result < 0)
-                        return f(std::error_code { -result, std::system_category() }, static_cast<std::size_t>(0));
-                    else
-                        return f(std::error_code {}, static_cast<std::size_t>(result));
-                });
-            });
+            using variant_type = std::variant<std::error_code, result_type>;
+
+            return service.async_recv(fd, buf, buf_len, flags, tcx::impl::fuse_completion(executor, std::forward<F>(f), [](auto &f, std::int32_t result) {
+                if (result < 0)
+                    return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+                else
+                    return f(variant_type(std::in_place_index<1>, static_cast<result_type>(result)));
+            }));
         }
     };
 } // namespace impl
@@ -46,7 +52,7 @@ template <typename E, typename F>
 requires tcx::completion_handler<F, tcx::impl::ioring_recv_operation::result_type>
 auto async_recv(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, void *buf, std::size_t buf_len, F &&f)
 {
-    return tcx::impl::wrap_op<tcx::impl::ioring_recv_operation>::call(executor, service, std::forward<F>(f), fd, buf, buf_len);
+    return tcx::impl::wrap_op<tcx::impl::ioring_recv_operation>::call(executor, service, std::forward<F>(f), fd, buf, buf_len, 0);
 }
 
 /**
@@ -1,12 +1,18 @@
 #ifndef TCX_ASYNC_IORING_SEND_HPP
 #define TCX_ASYNC_IORING_SEND_HPP
 
+#include <tcx/async/concepts.hpp>
+#include <tcx/async/impl/fused_completion.hpp>
 #include <tcx/async/wrap_op.hpp>
 #include <tcx/native/handle.hpp>
 #include <tcx/services/uring_service.hpp>
+#include <tcx/trace.hpp>
 
+#include <cstdint>
 #include <span>
+#include <system_error>
 #include <utility>
+#include <variant>
 
 namespace tcx {
 namespace impl {
@@ -16,14 +22,14 @@ namespace impl {
         template <typename E, typename F>
         static auto call(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, void const *buf, std::size_t buf_len, int flags, F &&f)
         {
-            return service.async_send(fd, buf, buf_len, flags, [&executor, f = std::forward<F>(f)](std::int32_t result) mutable {
-                return executor.post([f = std::move(f), result]() mutable {
-                    if (result < 0)
-                        return f(std::error_code { -result, std::system_category() }, static_cast<std::size_t>(0));
-                    else
-                        return f(std::error_code {}, static_cast<std::size_t>(result));
-                });
-            });
+            using variant_type = std::variant<std::error_code, result_type>;
+
+            return service.async_send(fd, buf, buf_len, flags, tcx::impl::fuse_completion(executor, std::forward<F>(f), [](auto &f, std::int32_t result) {
+                if (result < 0)
+                    return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+                else
+                    return f(variant_type(std::in_place_index<1>, static_cast<result_type>(result)));
+            }));
         }
     };
 } // namespace impl
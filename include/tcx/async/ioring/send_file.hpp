@@ -0,0 +1,344 @@
+#ifndef TCX_ASYNC_IORING_SEND_FILE_HPP
+#define TCX_ASYNC_IORING_SEND_FILE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <system_error>
+#include <utility>
+#include <variant>
+
+#include <fcntl.h>
+#include <poll.h>
+
+#include <tcx/async/bind_priority.hpp>
+#include <tcx/async/bind_stop_token.hpp>
+#include <tcx/async/concepts.hpp>
+#include <tcx/async/wrap_op.hpp>
+#include <tcx/native/handle.hpp>
+#include <tcx/pipe_pool.hpp>
+#include <tcx/services/file_cache.hpp>
+#include <tcx/services/uring_service.hpp>
+#include <tcx/trace.hpp>
+
+namespace tcx {
+namespace impl {
+
+    /**
+     * @brief sends a range of a file one chunk at a time, only the final result is posted to the executor
+     *
+     * Each chunk is spliced from the file into a pipe and from the pipe into the socket by two linked operations.
+     * Whatever is left in the pipe after a short splice is drained before the next chunk.
+     * Files that can't be spliced from are read into a buffer and sent with `IORING_OP_SEND_ZC` (or `IORING_OP_SEND`).
+     */
+    template <typename E, typename Service, typename F>
+    class send_file_operation : public std::enable_shared_from_this<send_file_operation<E, Service, F>> {
+        using variant_type = std::variant<std::error_code, std::size_t>;
+
+        // chunk size when copying through user memory
+        constexpr static std::size_t buffer_size = 64 * 1024;
+
+        enum class mode {
+            splice,
+            send_zc,
+            send,
+        };
+
+    public:
+        template <typename G>
+        send_file_operation(E &executor, Service &service, tcx::pipe_pool &pool, int socket, int file, off64_t offset, std::size_t length, tcx::cached_file keep_alive, G &&handler)
+            : m_executor(executor)
+            , m_service(service)
+            , m_pool(pool)
+            , m_socket(socket)
+            , m_file(file)
+            , m_offset(offset)
+            , m_remaining(length)
+            , m_keep_alive(std::move(keep_alive))
+            , m_handler(std::forward<G>(handler))
+            , m_token(tcx::impl::associated_stop_token(m_handler))
+        {
+        }
+
+        send_file_operation(send_file_operation const &) = delete;
+        send_file_operation &operator=(send_file_operation const &) = delete;
+
+        ~send_file_operation()
+        {
+            if (m_pipe.read != tcx::native::invalid_handle)
+                m_pool.release(m_pipe, m_in_pipe == 0);
+        }
+
+        void start()
+        {
+            if (auto pipe = m_pool.acquire(); pipe.has_value())
+                m_pipe = pipe.value();
+            else
+                m_mode = mode::send_zc;
+            step(0);
+        }
+
+    private:
+        void step(std::uint64_t id)
+        {
+            if (!m_error && m_token.stop_requested())
+                m_error = std::error_code(ECANCELED, std::system_category());
+            if (m_error || (m_remaining == 0 && m_in_pipe == 0 && m_buffered == 0))
+                return finish(id);
+
+            if (m_wait_writable) {
+                m_wait_writable = false;
+                submit_or_fail(m_service.async_poll_add(m_socket, POLLOUT, [self = this->shared_from_this()](Service &, io_uring_cqe const *result) {
+                    if (result->res < 0)
+                        self->m_error = std::error_code(-result->res, std::system_category());
+                    self->step(result->user_data);
+                }));
+            } else if (m_mode == mode::splice) {
+                splice();
+            } else {
+                copy();
+            }
+        }
+
+        void splice()
+        {
+            if (m_in_pipe != 0) {
+                io_uring_sqe op {};
+                io_uring_prep_splice(&op, m_pipe.read, -1, m_socket, -1, static_cast<unsigned>(m_in_pipe), SPLICE_F_MOVE);
+                submit_or_fail(m_service.submit(&op, [self = this->shared_from_this()](Service &, io_uring_cqe const *result) {
+                    self->on_sent(result->res);
+                    self->step(result->user_data);
+                }));
+                return;
+            }
+
+            std::size_t const length = std::min(m_remaining, m_pipe.capacity);
+            io_uring_sqe in {};
+            io_uring_prep_splice(&in, m_file, m_offset, m_pipe.write, -1, static_cast<unsigned>(length), SPLICE_F_MOVE);
+            io_uring_sqe out {};
+            io_uring_prep_splice(&out, m_pipe.read, -1, m_socket, -1, static_cast<unsigned>(length), SPLICE_F_MOVE);
+
+            // the second half of the chunk continues, whichever completion is reaped last
+            m_outstanding.store(2, std::memory_order_relaxed);
+            auto const result = m_service.submit_linked(
+                &in, [self = this->shared_from_this()](Service &, io_uring_cqe const *result) {
+                    self->m_spliced_in = result->res;
+                    if (self->m_outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                        self->on_chunk(result->user_data);
+                },
+                &out, [self = this->shared_from_this()](Service &, io_uring_cqe const *result) {
+                    self->m_spliced_out = result->res;
+                    if (self->m_outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                        self->on_chunk(result->user_data);
+                });
+            if (result.has_error()) {
+                m_error = std::error_code(result.error(), std::system_category());
+                finish(0);
+            }
+        }
+
+        void on_chunk(std::uint64_t id)
+        {
+            if (m_spliced_in < 0) {
+                if (m_sent == 0 && m_spliced_in == -EINVAL) {
+                    // the file can't be spliced from, nothing was moved yet
+                    m_mode = mode::send_zc;
+                    return step(id);
+                }
+                m_error = std::error_code(-m_spliced_in, std::system_category());
+                return finish(id);
+            }
+            if (m_spliced_in == 0) {
+                // the file is shorter than the range
+                m_remaining = 0;
+            } else {
+                m_offset += m_spliced_in;
+                m_remaining -= static_cast<std::size_t>(m_spliced_in);
+                m_in_pipe += static_cast<std::size_t>(m_spliced_in);
+            }
+            // a short splice into the pipe cancels the splice out of it, what's left is drained by the next step
+            if (m_spliced_out != -ECANCELED)
+                on_sent(m_spliced_out);
+            step(id);
+        }
+
+        void on_sent(int result)
+        {
+            if (result == -EAGAIN) {
+                // non blocking socket with a full send buffer, the next step waits until it's writable
+                m_wait_writable = true;
+            } else if (result < 0) {
+                m_error = std::error_code(-result, std::system_category());
+            } else {
+                m_in_pipe -= static_cast<std::size_t>(result);
+                m_sent += static_cast<std::size_t>(result);
+            }
+        }
+
+        void copy()
+        {
+            if (m_buffered == 0) {
+                if (!m_buffer)
+                    m_buffer = std::make_unique<char[]>(buffer_size);
+                std::size_t const length = std::min(m_remaining, buffer_size);
+                submit_or_fail(m_service.async_read(m_file, m_buffer.get(), length, m_offset, [self = this->shared_from_this()](Service &, io_uring_cqe const *result) {
+                    if (result->res < 0) {
+                        self->m_error = std::error_code(-result->res, std::system_category());
+                    } else if (result->res == 0) {
+                        self->m_remaining = 0;
+                    } else {
+                        self->m_offset += result->res;
+                        self->m_remaining -= static_cast<std::size_t>(result->res);
+                        self->m_buffered = static_cast<std::size_t>(result->res);
+                        self->m_buffer_offset = 0;
+                    }
+                    self->step(result->user_data);
+                }));
+                return;
+            }
+
+            auto *const data = m_buffer.get() + m_buffer_offset;
+            if (m_mode == mode::send) {
+                submit_or_fail(m_service.async_send(m_socket, data, m_buffered, MSG_NOSIGNAL, [self = this->shared_from_this()](Service &, io_uring_cqe const *result) {
+                    self->on_copied(result->res);
+                    self->step(result->user_data);
+                }));
+                return;
+            }
+
+            // the buffer can't be reused until the notification, so the next step waits for it
+            submit_or_fail(m_service.async_send_zc(m_socket, data, m_buffered, MSG_NOSIGNAL, 0, [self = this->shared_from_this()](Service &, io_uring_cqe const *result) {
+                if (result->flags & IORING_CQE_F_NOTIF) {
+                    self->step(result->user_data);
+                    return;
+                }
+                if (self->m_sent == 0 && (result->res == -EINVAL || result->res == -EOPNOTSUPP)) {
+                    // zero copy isn't supported by the kernel, or by the socket
+                    self->m_mode = mode::send;
+                } else {
+                    self->on_copied(result->res);
+                }
+                if (!(result->flags & IORING_CQE_F_MORE))
+                    self->step(result->user_data);
+            }));
+        }
+
+        void on_copied(int result)
+        {
+            if (result == -EAGAIN) {
+                m_wait_writable = true;
+            } else if (result < 0) {
+                m_error = std::error_code(-result, std::system_category());
+            } else {
+                m_buffer_offset += static_cast<std::size_t>(result);
+                m_buffered -= static_cast<std::size_t>(result);
+                m_sent += static_cast<std::size_t>(result);
+            }
+        }
+
+        void submit_or_fail(native::result<uring_context_storage::operation_t> const &result)
+        {
+            if (result.has_error()) {
+                m_error = std::error_code(result.error(), std::system_category());
+                finish(0);
+            }
+        }
+
+        void finish(std::uint64_t id)
+        {
+            tcx::trace::dispatch(m_executor, id, tcx::impl::associated_priority(m_handler), [self = this->shared_from_this()]() mutable {
+                auto &handler = self->m_handler;
+                if (self->m_error)
+                    return handler(variant_type(std::in_place_index<0>, self->m_error));
+                else
+                    return handler(variant_type(std::in_place_index<1>, self->m_sent));
+            });
+        }
+
+        E &m_executor;
+        Service &m_service;
+        tcx::pipe_pool &m_pool;
+        tcx::pipe_pool::pipe m_pipe;
+        mode m_mode = mode::splice;
+
+        int m_socket;
+        int m_file;
+        off64_t m_offset;
+        std::size_t m_remaining;
+        std::size_t m_sent = 0;
+        tcx::cached_file m_keep_alive;
+
+        std::size_t m_in_pipe = 0;
+        std::atomic_int m_outstanding = 0;
+        int m_spliced_in = 0;
+        int m_spliced_out = 0;
+        bool m_wait_writable = false;
+
+        std::unique_ptr<char[]> m_buffer;
+        std::size_t m_buffer_offset = 0;
+        std::size_t m_buffered = 0;
+
+        F m_handler;
+        std::stop_token m_token;
+        std::error_code m_error;
+    };
+
+    struct ioring_send_file_operation {
+        using result_type = std::size_t;
+
+        template <typename E, typename F>
+        static void call(E &executor, tcx::uring_context auto &service, tcx::pipe_pool &pool, int socket, int file, off64_t offset, std::size_t length, tcx::cached_file keep_alive, F &&f)
+        {
+            using service_type = std::remove_reference_t<decltype(service)>;
+            using operation_type = send_file_operation<E, service_type, std::remove_cvref_t<F>>;
+            std::make_shared<operation_type>(executor, service, pool, socket, file, offset, length, std::move(keep_alive), std::forward<F>(f))->start();
+        }
+    };
+
+} // namespace impl
+
+/**
+ * @ingroup ioring_service
+ * @brief sends `length` bytes of `file`, starting at `offset`, to `socket`
+ *
+ * The data is spliced through a pipe taken from `pool`, so it's never copied to user memory.
+ * If `file` doesn't support splicing it's read into a buffer and sent with zero copy sends instead.
+ * The completion is invoked once, with the number of bytes sent, which is less than `length` only if the file is shorter.
+ */
+template <typename E, typename F>
+requires tcx::completion_handler<F, tcx::impl::ioring_send_file_operation::result_type>
+auto async_send_file(E &executor, tcx::uring_context auto &service, tcx::pipe_pool &pool, tcx::native::handle_type socket, tcx::native::handle_type file, off64_t offset, std::size_t length, F &&f)
+{
+    return tcx::impl::wrap_op<tcx::impl::ioring_send_file_operation>::call(executor, service, std::forward<F>(f), pool, socket, file, offset, length, tcx::cached_file());
+}
+
+/**
+ * @ingroup ioring_service
+ * @brief like the above, with the pipes of `tcx::pipe_pool::shared()`
+ */
+template <typename E, typename F>
+requires tcx::completion_handler<F, tcx::impl::ioring_send_file_operation::result_type>
+auto async_send_file(E &executor, tcx::uring_context auto &service, tcx::native::handle_type socket, tcx::native::handle_type file, off64_t offset, std::size_t length, F &&f)
+{
+    return tcx::async_send_file(executor, service, tcx::pipe_pool::shared(), socket, file, offset, length, std::forward<F>(f));
+}
+
+/**
+ * @ingroup ioring_service
+ * @brief like the above, sending from a file opened through a `tcx::file_cache`
+ *
+ * The range is clamped to the size the file had when it was opened, and `file` is kept open until the operation completes.
+ */
+template <typename E, typename F>
+requires tcx::completion_handler<F, tcx::impl::ioring_send_file_operation::result_type>
+auto async_send_file(E &executor, tcx::uring_context auto &service, tcx::native::handle_type socket, tcx::cached_file const &file, off64_t offset, std::size_t length, F &&f)
+{
+    auto const size = static_cast<off64_t>(file.stat().stx_size);
+    length = offset >= size ? 0 : std::min<std::size_t>(length, static_cast<std::size_t>(size - offset));
+    return tcx::impl::wrap_op<tcx::impl::ioring_send_file_operation>::call(executor, service, std::forward<F>(f), tcx::pipe_pool::shared(), socket, file.native_handle(), offset, length, file);
+}
+
+} // namespace tcx
+
+#endif
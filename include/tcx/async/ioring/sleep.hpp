@@ -1,12 +1,18 @@
 #ifndef TCX_ASYNC_IORING_SLEEP_HPP
 #define TCX_ASYNC_IORING_SLEEP_HPP
 
+#include <cerrno>
 #include <chrono>
+#include <cstdint>
 #include <memory>
+#include <system_error>
+#include <variant>
 
 #include <tcx/async/concepts.hpp>
+#include <tcx/async/impl/fused_completion.hpp>
 #include <tcx/async/wrap_op.hpp>
 #include <tcx/services/uring_service.hpp>
+#include <tcx/trace.hpp>
 
 namespace tcx {
 
@@ -16,17 +22,18 @@ namespace impl {
         using result_type = void;
 
         template <typename E, typename F>
-        static auto call(E &executor, tcx::uring_context auto &service, std::unique_ptr<__kernel_timespec> spec, int flags, F &&f)
+        static auto call(E &executor, tcx::uring_context auto &service, std::unique_ptr<__kernel_timespec> spec, unsigned flags, F &&f)
         {
-            return service.async_timeout(spec.get(), flags, [spec = std::move(spec), &executor, f = std::forward<F>(f)](std::int32_t result) mutable {
-                spec.reset();
-                return executor.post([f = std::move(f), result]() mutable {
-                    if (result < 0)
-                        return f(std::error_code { -result, std::system_category() });
-                    else
-                        return f(std::error_code {});
-                });
-            });
+            using variant_type = std::variant<std::error_code, std::monostate>;
+
+            auto const p = spec.get();
+            return service.async_timeout(p, 0, flags, tcx::impl::fuse_completion(executor, std::forward<F>(f), [spec = std::move(spec)](auto &f, std::int32_t result) {
+                // a pure timeout always completes with ETIME once it expires
+                if (result < 0 && result != -ETIME)
+                    return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+                else
+                    return f(variant_type(std::in_place_index<1>));
+            }));
         }
     };
 } // namespace impl
@@ -50,7 +57,7 @@ auto async_sleep_for(E &executor, tcx::uring_context auto &service, std::chrono:
 
     auto spec = std::make_unique<__kernel_timespec>(__kernel_timespec { secs.count(), nsecs.count() });
 
-    return tcx::impl::wrap_op<tcx::impl::ioring_timeout_operation>::call(executor, service, std::forward<F>(f), 0, std::move(spec));
+    return tcx::impl::wrap_op<tcx::impl::ioring_timeout_operation>::call(executor, service, std::forward<F>(f), std::move(spec), 0u);
 }
 
 /**
@@ -69,7 +76,7 @@ auto async_sleep_until(E &executor, tcx::uring_context auto &service, std::chron
 
     auto spec = std::make_unique<__kernel_timespec>(__kernel_timespec { secs.count(), nsecs.count() });
 
-    return tcx::impl::wrap_op<tcx::impl::ioring_timeout_operation>::call(executor, service, std::forward<F>(f), IORING_TIMEOUT_ABS, std::move(spec));
+    return tcx::impl::wrap_op<tcx::impl::ioring_timeout_operation>::call(executor, service, std::forward<F>(f), std::move(spec), IORING_TIMEOUT_ABS);
 }
 
 /**
@@ -88,7 +95,7 @@ auto async_sleep_until(E &executor, tcx::uring_context auto &service, std::chron
 
     auto spec = std::make_unique<__kernel_timespec>(__kernel_timespec { secs.count(), nsecs.count() });
 
-    return tcx::impl::wrap_op<tcx::impl::ioring_timeout_operation>::call(executor, service, std::forward<F>(f), IORING_TIMEOUT_ABS | IORING_TIMEOUT_REALTIME, std::move(spec));
+    return tcx::impl::wrap_op<tcx::impl::ioring_timeout_operation>::call(executor, service, std::forward<F>(f), std::move(spec), IORING_TIMEOUT_ABS | IORING_TIMEOUT_REALTIME);
 }
 
 // there's no standard clock for CLOCK_BOOTTIME
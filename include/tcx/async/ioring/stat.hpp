@@ -1,14 +1,17 @@
 #ifndef TCX_ASYNC_IORING_STAT_HPP
 #define TCX_ASYNC_IORING_STAT_HPP
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 
 #include <tcx/async/concepts.hpp>
+#include <tcx/async/impl/fused_completion.hpp>
 #include <tcx/async/wrap_op.hpp>
 #include <tcx/native/handle.hpp>
 #include <tcx/native/string.hpp>
 #include <tcx/services/uring_service.hpp>
+#include <tcx/trace.hpp>
 
 namespace tcx {
 namespace impl {
@@ -23,7 +26,7 @@ namespace impl {
 
             auto statxbuf = std::make_unique<struct ::statx>();
             auto *const p = statxbuf.get();
-            return service.async_statx(dir_fd, pathname, flags, STATX_BASIC_STATS, p, [statxbuf = std::move(statxbuf), statbuf, &executor, f = std::forward<F>(f)](tcx::uring_context auto &, io_uring_cqe const *result) mutable {
+            return service.async_statx(dir_fd, pathname, flags, STATX_BASIC_STATS, p, tcx::impl::fuse_completion(executor, std::forward<F>(f), [statxbuf = std::move(statxbuf), statbuf](auto &f, std::int32_t result) mutable {
                 statbuf->st_dev = (static_cast<std::uint64_t>(statxbuf->stx_dev_major) << 32u) | statxbuf->stx_dev_minor;
                 statbuf->st_ino = statxbuf->stx_ino;
                 statbuf->st_nlink = statxbuf->stx_nlink;
@@ -42,13 +45,11 @@ namespace impl {
                 statbuf->st_ctim.tv_nsec = statxbuf->stx_ctime.tv_nsec;
                 statxbuf.reset();
 
-                return executor.post([f = std::move(f), result = result->res]() mutable {
-                    if (result < 0)
-                        return std::invoke(f, variant_type(std::in_place_index<0>, result, std::system_category()));
-                    else
-                        return std::invoke(f, variant_type(std::in_place_index<1>));
-                });
-            });
+                if (result < 0)
+                    return std::invoke(f, variant_type(std::in_place_index<0>, -result, std::system_category()));
+                else
+                    return std::invoke(f, variant_type(std::in_place_index<1>));
+            }));
         }
     };
 
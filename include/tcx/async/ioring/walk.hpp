@@ -0,0 +1,554 @@
+#ifndef TCX_ASYNC_IORING_WALK_HPP
+#define TCX_ASYNC_IORING_WALK_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <tcx/async/bind_priority.hpp>
+#include <tcx/async/bind_stop_token.hpp>
+#include <tcx/async/concepts.hpp>
+#include <tcx/async/wrap_op.hpp>
+#include <tcx/native/string.hpp>
+#include <tcx/services/uring_service.hpp>
+#include <tcx/trace.hpp>
+
+namespace tcx {
+
+/**
+ * @brief Tuning of `tcx::async_walk()`
+ */
+struct walk_options {
+    /** @brief maximum number of `statx()` operations in flight, at least 1 */
+    std::size_t max_in_flight = 256;
+    /** @brief number of threads reading directories */
+    std::size_t readers = 1;
+    /** @brief maximum number of directories kept open, read ahead of the `statx()` operations stops when reached */
+    std::size_t max_open_directories = 128;
+    /** @brief maximum depth to descend into, the root has a depth of 0 */
+    std::size_t max_depth = std::numeric_limits<std::size_t>::max();
+    /** @brief fields requested from `statx()` */
+    unsigned mask = STATX_BASIC_STATS;
+    /** @brief stat and descend through symbolic links, loops are not detected */
+    bool follow_symlinks = false;
+};
+
+/**
+ * @brief What `tcx::async_walk()` does after visiting an entry
+ */
+enum class walk_action {
+    /** @brief descend into the entry if it's a directory */
+    proceed,
+    /** @brief don't descend into the entry */
+    skip,
+    /** @brief don't visit any more entries */
+    stop,
+};
+
+/**
+ * @brief An entry visited by `tcx::async_walk()`
+ */
+struct walk_entry {
+    /** @brief the root joined with the path of the entry relative to it */
+    std::string_view path;
+    /** @brief number of directories between the root and the entry */
+    std::size_t depth;
+    /** @brief set when the entry couldn't be stat'ed, or when it's a directory that couldn't be read */
+    std::error_code error;
+    /** @brief the result of `statx()`, null when `error` is set */
+    struct ::statx const *stat;
+};
+
+namespace impl {
+
+    struct walk_readers;
+
+    /**
+     * @brief an open directory, closed when the last batch of names read from it is released
+     */
+    struct walk_directory {
+        walk_directory(walk_readers &readers, std::string path, std::size_t depth) noexcept
+            : readers(readers)
+            , path(std::move(path))
+            , depth(depth)
+        {
+        }
+
+        walk_directory(walk_directory const &) = delete;
+        walk_directory &operator=(walk_directory const &) = delete;
+
+        ~walk_directory();
+
+        walk_readers &readers;
+        std::string path;
+        std::size_t depth;
+        int fd = -1;
+    };
+
+    /**
+     * @brief names read from a directory, stored back to back and null terminated
+     */
+    struct walk_batch {
+        std::shared_ptr<walk_directory> directory;
+        std::string names;
+        std::vector<std::uint32_t> offsets;
+        std::error_code error;
+        bool last = false;
+    };
+
+    /**
+     * @brief threads reading directories and handing batches of names to the ring
+     *
+     * A batch being ready is signaled by writing to `event_fd`.
+     */
+    struct walk_readers {
+        walk_readers(walk_options const &options);
+        walk_readers(walk_readers const &) = delete;
+        walk_readers &operator=(walk_readers const &) = delete;
+        ~walk_readers();
+
+        /**
+         * @brief queues `path` to be read, must be called with `mutex` held
+         */
+        void push(std::string path, std::size_t depth);
+
+        /**
+         * @brief takes the ready batches, must be called with `mutex` held
+         */
+        void take(std::deque<std::shared_ptr<walk_batch>> &into);
+
+        /**
+         * @brief stops reading, the directories already queued are delivered as empty batches.
+         * Must be called with `mutex` held
+         */
+        void abandon();
+
+        void directory_closed() noexcept;
+
+        /**
+         * @brief completes a read of `event_fd`, even when no batch is ready
+         */
+        void signal() noexcept;
+
+        std::mutex mutex;
+        int event_fd;
+
+    private:
+        void close() noexcept;
+        void run();
+        void read(std::string path, std::size_t depth);
+        bool deliver(std::shared_ptr<walk_batch> batch);
+
+        std::condition_variable m_jobs_cv;
+        std::condition_variable m_space_cv;
+        std::deque<std::pair<std::string, std::size_t>> m_jobs;
+        std::deque<std::shared_ptr<walk_batch>> m_ready;
+        std::size_t m_ready_names = 0;
+        std::size_t m_max_ready_names;
+        std::size_t m_open_directories = 0;
+        std::size_t m_max_open_directories;
+        std::atomic_bool m_abandoned = false;
+        bool m_closing = false;
+        std::vector<std::thread> m_threads;
+    };
+
+    template <typename E, typename Service, typename Visitor, typename F>
+    class walker : public std::enable_shared_from_this<walker<E, Service, Visitor, F>> {
+        using variant_type = std::variant<std::error_code, std::monostate>;
+
+        struct slot {
+            struct ::statx stat;
+            std::shared_ptr<walk_batch> batch;
+            char const *name;
+        };
+
+    public:
+        template <typename G>
+        walker(E &executor, Service &service, std::string root, Visitor visitor, walk_options const &options, G &&handler)
+            : m_readers(options)
+            , m_executor(executor)
+            , m_service(service)
+            , m_root(std::move(root))
+            , m_visitor(std::move(visitor))
+            , m_options(options)
+            , m_handler(std::forward<G>(handler))
+            , m_token(tcx::impl::associated_stop_token(m_handler))
+            , m_slots(std::make_unique<slot[]>(std::max<std::size_t>(options.max_in_flight, 1)))
+        {
+            // the root takes a slot before anything else runs
+            std::size_t const slots = std::max<std::size_t>(options.max_in_flight, 1);
+            m_free.reserve(slots);
+            for (std::size_t i = slots; i-- > 0;)
+                m_free.push_back(i);
+        }
+
+        void start()
+        {
+            std::unique_lock lock(m_readers.mutex);
+            std::size_t const index = acquire();
+            m_slots[index].name = m_root.c_str();
+            submit(lock, index, AT_FDCWD);
+            if (!m_error)
+                return;
+
+            // the root couldn't be submitted, the handler can't run before this returns
+            m_finished = true;
+            lock.unlock();
+            auto const priority = tcx::impl::associated_priority(m_handler);
+            tcx::impl::post(m_executor, priority, [self = this->shared_from_this()]() mutable {
+                std::invoke(self->m_handler, variant_type(std::in_place_index<0>, self->m_error));
+            });
+        }
+
+    private:
+        [[nodiscard]] int statx_flags() const noexcept
+        {
+            return AT_STATX_SYNC_AS_STAT | (m_options.follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW);
+        }
+
+        std::size_t acquire() noexcept
+        {
+            std::size_t const index = m_free.back();
+            m_free.pop_back();
+            ++m_in_flight;
+            return index;
+        }
+
+        /**
+         * @brief submits the `statx()` of slot `index`, when that fails the slot is released and the walk stops with the error
+         */
+        void submit(std::unique_lock<std::mutex> &lock, std::size_t index, int dir_fd)
+        {
+            auto &entry = m_slots[index];
+            auto const submitted = m_service.async_statx(dir_fd, entry.name, statx_flags(), m_options.mask, &entry.stat, [self = this->shared_from_this(), index](tcx::uring_context auto &, io_uring_cqe const *result) mutable {
+                auto &executor = self->m_executor;
+                auto const priority = tcx::impl::associated_priority(self->m_handler);
+                return tcx::trace::dispatch(executor, result->user_data, priority, [self = std::move(self), index, result = result->res]() mutable {
+                    self->on_statx(index, result);
+                });
+            });
+            if (!submitted.has_error())
+                return;
+
+            auto batch = std::move(entry.batch);
+            m_free.push_back(index);
+            --m_in_flight;
+            fail(lock, submitted.error());
+
+            // releasing the batch may close it's directory, which takes the lock
+            lock.unlock();
+            batch.reset();
+            lock.lock();
+        }
+
+        void arm(std::unique_lock<std::mutex> &lock)
+        {
+            if (m_armed)
+                return;
+            m_armed = true;
+            auto const submitted = m_service.async_read(m_readers.event_fd, &m_event_value, sizeof(m_event_value), 0, [self = this->shared_from_this()](tcx::uring_context auto &, io_uring_cqe const *result) mutable {
+                auto &executor = self->m_executor;
+                auto const priority = tcx::impl::associated_priority(self->m_handler);
+                return tcx::trace::dispatch(executor, result->user_data, priority, [self = std::move(self)]() mutable {
+                    self->on_event();
+                });
+            });
+            if (!submitted.has_error())
+                return;
+
+            // the batches still to be read can't be waited for anymore
+            m_armed = false;
+            m_deaf = true;
+            fail(lock, submitted.error());
+        }
+
+        /**
+         * @brief stops the walk, which completes with `error` unless it already failed
+         */
+        void fail(std::unique_lock<std::mutex> &lock, tcx::native::error_type error)
+        {
+            if (!m_error)
+                m_error = std::error_code(error, std::system_category());
+            stop(lock);
+        }
+
+        void on_statx(std::size_t index, int result)
+        {
+            auto &entry = m_slots[index];
+            auto batch = std::move(entry.batch);
+            walk_directory const *const directory = batch ? batch->directory.get() : nullptr;
+
+            std::string path;
+            if (directory) {
+                path.reserve(directory->path.size() + 1 + std::strlen(entry.name));
+                path = directory->path;
+                if (!path.ends_with('/'))
+                    path += '/';
+                path += entry.name;
+            } else {
+                path = m_root;
+            }
+            std::size_t const depth = directory ? directory->depth + 1 : 0;
+
+            bool stopped;
+            {
+                std::lock_guard lock(m_readers.mutex);
+                stopped = m_stopped;
+            }
+
+            walk_action action = walk_action::proceed;
+            if (!directory && result < 0) {
+                // the root couldn't be stat'ed, this is the result of the whole walk
+                m_error = std::error_code(-result, std::system_category());
+                action = walk_action::stop;
+            } else if (!stopped) {
+                walk_entry visited {
+                    .path = path,
+                    .depth = depth,
+                    .error = result < 0 ? std::error_code(-result, std::system_category()) : std::error_code(),
+                    .stat = result < 0 ? nullptr : &entry.stat,
+                };
+                action = visit(visited);
+            }
+            bool const descend = result >= 0 && action == walk_action::proceed && S_ISDIR(entry.stat.stx_mode) && depth < m_options.max_depth;
+            batch.reset();
+
+            std::unique_lock lock(m_readers.mutex);
+            m_free.push_back(index);
+            --m_in_flight;
+            if (action == walk_action::stop || m_token.stop_requested()) {
+                stop(lock);
+            } else if (descend && !m_stopped) {
+                m_readers.push(std::move(path), depth);
+                ++m_outstanding;
+            }
+            pump(lock);
+        }
+
+        void on_event()
+        {
+            std::unique_lock lock(m_readers.mutex);
+            m_armed = false;
+            m_disarming = false;
+            if (m_token.stop_requested())
+                stop(lock);
+            pump(lock);
+        }
+
+        /**
+         * @brief takes the batches read so far, visiting the directories that couldn't be read
+         * @return whether any batch was taken
+         */
+        bool refill(std::unique_lock<std::mutex> &lock)
+        {
+            std::deque<std::shared_ptr<walk_batch>> taken;
+            m_readers.take(taken);
+            if (taken.empty())
+                return false;
+
+            std::vector<std::shared_ptr<walk_batch>> failed;
+            for (auto &batch : taken) {
+                if (batch->last)
+                    --m_outstanding;
+                if (batch->error && !m_stopped)
+                    failed.push_back(batch);
+                if (!batch->offsets.empty() && !m_stopped)
+                    m_pending.push_back(std::move(batch));
+            }
+
+            // releasing the batches may close directories, which takes the lock
+            lock.unlock();
+            taken.clear();
+            bool stopping = false;
+            for (auto const &batch : failed) {
+                walk_entry visited {
+                    .path = batch->directory->path,
+                    .depth = batch->directory->depth,
+                    .error = batch->error,
+                    .stat = nullptr,
+                };
+                if (visit(visited) == walk_action::stop) {
+                    stopping = true;
+                    break;
+                }
+            }
+            failed.clear();
+            lock.lock();
+
+            if (stopping)
+                stop(lock);
+            return true;
+        }
+
+        walk_action visit(walk_entry const &entry)
+        {
+            if constexpr (std::is_void_v<std::invoke_result_t<Visitor &, walk_entry const &>>) {
+                std::invoke(m_visitor, entry);
+                return walk_action::proceed;
+            } else {
+                return std::invoke(m_visitor, entry);
+            }
+        }
+
+        void stop(std::unique_lock<std::mutex> &lock)
+        {
+            if (m_stopped)
+                return;
+            m_stopped = true;
+            m_readers.abandon();
+
+            // releasing the batches may close directories, which takes the lock
+            auto pending = std::move(m_pending);
+            m_pending.clear();
+            m_cursor = 0;
+            lock.unlock();
+            pending.clear();
+            lock.lock();
+        }
+
+        void pump(std::unique_lock<std::mutex> &lock)
+        {
+            // batches are only taken once the previous ones are exhausted, so that readers can't run too far ahead
+            while (!m_stopped && !m_free.empty()) {
+                if (m_pending.empty()) {
+                    if (!refill(lock))
+                        break;
+                    continue;
+                }
+
+                auto &batch = m_pending.front();
+                if (m_cursor == batch->offsets.size()) {
+                    auto released = std::move(batch);
+                    m_pending.pop_front();
+                    m_cursor = 0;
+                    lock.unlock();
+                    released.reset();
+                    lock.lock();
+                    continue;
+                }
+                std::size_t const index = acquire();
+                auto &entry = m_slots[index];
+                entry.name = batch->names.data() + batch->offsets[m_cursor++];
+                entry.batch = batch;
+                submit(lock, index, batch->directory->fd);
+            }
+
+            // once stopped, batches are still taken until every directory that was pushed has been answered
+            while (m_stopped && refill(lock)) {
+            }
+            if (m_outstanding != 0 && !m_deaf)
+                arm(lock);
+            else if (m_armed && !m_disarming) {
+                // every directory was answered, nothing would complete the read left in flight
+                m_disarming = true;
+                m_readers.signal();
+            }
+
+            bool const done = m_in_flight == 0 && (m_outstanding == 0 || m_deaf) && !m_armed && (m_stopped || m_pending.empty());
+            if (!done || m_finished)
+                return;
+            m_finished = true;
+            lock.unlock();
+
+            if (m_error)
+                std::invoke(m_handler, variant_type(std::in_place_index<0>, m_error));
+            else if (m_token.stop_requested())
+                std::invoke(m_handler, variant_type(std::in_place_index<0>, ECANCELED, std::system_category()));
+            else
+                std::invoke(m_handler, variant_type(std::in_place_index<1>));
+        }
+
+        // first, so that it outlives the batches still referencing it
+        walk_readers m_readers;
+
+        E &m_executor;
+        Service &m_service;
+        std::string m_root;
+        Visitor m_visitor;
+        walk_options m_options;
+        F m_handler;
+        std::stop_token m_token;
+        std::error_code m_error;
+
+        std::unique_ptr<slot[]> m_slots;
+        std::vector<std::size_t> m_free;
+        std::size_t m_in_flight = 0;
+
+        std::deque<std::shared_ptr<walk_batch>> m_pending;
+        std::size_t m_cursor = 0;
+        std::size_t m_outstanding = 0;
+        std::uint64_t m_event_value = 0;
+        bool m_armed = false;
+        bool m_disarming = false;
+        // the read of the readers' eventfd couldn't be submitted
+        bool m_deaf = false;
+        bool m_stopped = false;
+        bool m_finished = false;
+    };
+
+    struct ioring_walk_operation {
+        using result_type = void;
+
+        template <typename E, typename Visitor, typename F>
+        static void call(E &executor, tcx::uring_context auto &service, std::string root, Visitor &&visitor, walk_options const &options, F &&f)
+        {
+            using service_type = std::remove_reference_t<decltype(service)>;
+            using walker_type = walker<E, service_type, std::remove_cvref_t<Visitor>, std::remove_cvref_t<F>>;
+            std::make_shared<walker_type>(executor, service, std::move(root), std::forward<Visitor>(visitor), options, std::forward<F>(f))->start();
+        }
+    };
+
+} // namespace impl
+
+/**
+ * @ingroup ioring_service
+ * @brief Visits `root` and every file below it.
+ *
+ * Directories are read from `options.readers` threads, while up to `options.max_in_flight` `statx()` operations,
+ * relative to the already open directory, are kept in flight in `service`.
+ * The visitor is invoked from `executor` with a `tcx::walk_entry` as soon as each `statx()` completes,
+ * so entries are visited in no particular order. It may return a `tcx::walk_action` to skip a directory or to stop the walk.
+ *
+ * The operation completes once every entry has been visited, with an error only if `root` itself couldn't be stat'ed
+ * or if an operation couldn't be submitted to `service`, which stops the walk; errors below `root` are passed to the visitor instead.
+ * @attention The visitor may be invoked concurrently if `executor` runs handlers from several threads.
+ */
+template <typename E, typename Visitor, typename F>
+requires std::invocable<Visitor &, walk_entry const &> && tcx::completion_handler<F, tcx::impl::ioring_walk_operation::result_type>
+auto async_walk(E &executor, tcx::uring_context auto &service, tcx::native::c_string root, Visitor &&visitor, walk_options const &options, F &&f)
+{
+    return tcx::impl::wrap_op<tcx::impl::ioring_walk_operation>::call(executor, service, std::forward<F>(f), std::string(root), std::forward<Visitor>(visitor), options);
+}
+
+/**
+ * @ingroup ioring_service
+ * @brief Like the above, with the default `tcx::walk_options`
+ */
+template <typename E, typename Visitor, typename F>
+requires std::invocable<Visitor &, walk_entry const &> && tcx::completion_handler<F, tcx::impl::ioring_walk_operation::result_type>
+auto async_walk(E &executor, tcx::uring_context auto &service, tcx::native::c_string root, Visitor &&visitor, F &&f)
+{
+    return tcx::async_walk(executor, service, root, std::forward<Visitor>(visitor), walk_options {}, std::forward<F>(f));
+}
+
+} // namespace tcx
+
+#endif
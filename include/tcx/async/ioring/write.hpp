@@ -1,14 +1,21 @@
 #ifndef TCX_ASYNC_IORING_WRITE_HPP
 #define TCX_ASYNC_IORING_WRITE_HPP
 
+#include <cstdint>
 #include <cstdio>
 #include <span>
+#include <system_error>
 #include <utility>
+#include <variant>
 
+#include <tcx/async/bind_priority.hpp>
 #include <tcx/async/concepts.hpp>
+#include <tcx/async/impl/fused_completion.hpp>
 #include <tcx/async/wrap_op.hpp>
 #include <tcx/native/handle.hpp>
+#include <tcx/services/buffered_stream.hpp>
 #include <tcx/services/uring_service.hpp>
+#include <tcx/trace.hpp>
 
 namespace tcx {
 namespace impl {
@@ -19,17 +26,53 @@ namespace impl {
         template <typename E, typename F>
         static auto call(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, void const *buf, std::size_t len, off_t offset, F &&f)
         {
-            return service.async_write(fd, buf, len, offset, [&executor, f = std::forward<F>(f)](std::int32_t result) mutable {
-                return executor.post([f = std::move(f), result]() mutable {
-                    if (result < 0)
-                        return f(std::error_code { -result, std::system_category() }, static_cast<std::size_t>(0));
+            using variant_type = std::variant<std::error_code, result_type>;
+
+            return service.async_write(fd, buf, len, offset, tcx::impl::fuse_completion(executor, std::forward<F>(f), [](auto &f, std::int32_t result) {
+                if (result < 0)
+                    return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+                else
+                    return f(variant_type(std::in_place_index<1>, static_cast<result_type>(result)));
+            }));
+        }
+    };
+
+    struct ioring_write_fixed_operation {
+        using result_type = std::size_t;
+
+        template <typename E, typename F>
+        static auto call(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, void const *buf, std::size_t len, off_t offset, int buf_index, F &&f)
+        {
+            using variant_type = std::variant<std::error_code, result_type>;
+
+            return service.async_write_fixed(fd, buf, len, offset, buf_index, tcx::impl::fuse_completion(executor, std::forward<F>(f), [](auto &f, std::int32_t result) {
+                if (result < 0)
+                    return f(variant_type(std::in_place_index<0>, -result, std::system_category()));
+                else
+                    return f(variant_type(std::in_place_index<1>, static_cast<result_type>(result)));
+            }));
+        }
+    };
+
+    struct buffered_stream_write_operation {
+        using result_type = std::size_t;
+
+        template <typename E, typename Service, typename F>
+        static void call(E &executor, tcx::buffered_stream<Service> &stream, void const *buf, std::size_t len, F &&f)
+        {
+            using variant_type = std::variant<std::error_code, result_type>;
+
+            auto const priority = tcx::impl::associated_priority(f);
+            stream.write(executor, buf, len, [&executor, priority, f = std::forward<F>(f)](std::error_code error, std::size_t written) mutable {
+                tcx::impl::post(executor, priority, [f = std::move(f), error, written]() mutable {
+                    if (error)
+                        return f(variant_type(std::in_place_index<0>, error));
                     else
-                        return f(std::error_code {}, static_cast<std::size_t>(result));
+                        return f(variant_type(std::in_place_index<1>, written));
                 });
             });
         }
     };
-
 } // namespace impl
 
 /**
@@ -72,6 +115,32 @@ auto async_write(E &executor, tcx::uring_context auto &service, tcx::native::han
     return tcx::async_write(executor, service, fd, bytes.data(), bytes.size(), -1, std::forward<F>(f));
 }
 
+/**
+ * @ingroup ioring_service
+ * @brief like `tcx::async_write()`, but `buf` must be within the buffer registered at `buf_index`
+ * @see tcx::uring_context_storage::register_buffers()
+ */
+template <typename E, typename F>
+requires tcx::completion_handler<F, tcx::impl::ioring_write_fixed_operation::result_type>
+auto async_write_fixed(E &executor, tcx::uring_context auto &service, tcx::native::handle_type fd, void const *buf, std::size_t len, off_t offset, int buf_index, F &&f)
+{
+    return tcx::impl::wrap_op<tcx::impl::ioring_write_fixed_operation>::call(executor, service, std::forward<F>(f), fd, buf, len, offset, buf_index);
+}
+
+/**
+ * @ingroup ioring_service
+ * @brief writes `len` bytes to `stream`, coalesced with the other writes made in the same turn of `executor`
+ *
+ * `buf` must stay valid until the write completes.
+ * @see tcx::buffered_stream
+ */
+template <typename E, typename Service, typename F>
+requires tcx::completion_handler<F, tcx::impl::buffered_stream_write_operation::result_type>
+auto async_write(E &executor, tcx::buffered_stream<Service> &stream, void const *buf, std::size_t len, F &&f)
+{
+    return tcx::impl::wrap_op<tcx::impl::buffered_stream_write_operation>::call(executor, stream, std::forward<F>(f), buf, len);
+}
+
 } // namespace tcx
 
 #endif
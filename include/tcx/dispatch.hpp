@@ -0,0 +1,133 @@
+#ifndef TCX_DISPATCH_HPP
+#define TCX_DISPATCH_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include <tcx/priority.hpp>
+#include <tcx/unique_function.hpp>
+
+namespace tcx {
+
+/**
+ * @brief handlers ran inline inside each other before the next one is queued instead
+ */
+inline constexpr std::size_t max_dispatch_depth = 16;
+
+namespace impl {
+
+    // handlers ran inline on this thread, one inside another
+    inline thread_local std::size_t dispatch_depth = 0;
+    // set while the outermost handler posted to an inline_executor on this thread runs
+    inline thread_local bool inline_executor_running = false;
+
+    struct dispatch_depth_guard {
+        dispatch_depth_guard() noexcept
+        {
+            ++dispatch_depth;
+        }
+
+        dispatch_depth_guard(dispatch_depth_guard const &) = delete;
+        dispatch_depth_guard &operator=(dispatch_depth_guard const &) = delete;
+
+        ~dispatch_depth_guard()
+        {
+            --dispatch_depth;
+        }
+    };
+
+    template <typename E>
+    concept knows_running_thread = requires(E const &executor)
+    {
+        {
+            executor.running_in_this_thread()
+            } -> std::convertible_to<bool>;
+    };
+
+    /**
+     * @brief runs `f` right away if `executor` is running on this thread, otherwise posts it to the lane `priority`
+     *
+     * Executors that can't tell if they are running on this thread always get `f` posted,
+     * and so do those that can once `tcx::max_dispatch_depth` handlers are running inline one inside another.
+     * A handler ran inline doesn't go through the lanes, so it runs before anything already queued.
+     */
+    template <typename E, typename F>
+    void dispatch(E &executor, tcx::priority priority, F &&f)
+    {
+        if constexpr (knows_running_thread<E>) {
+            if (dispatch_depth < max_dispatch_depth && executor.running_in_this_thread()) {
+                dispatch_depth_guard const guard;
+                std::forward<F>(f)();
+                return;
+            }
+        }
+        tcx::impl::post(executor, priority, std::forward<F>(f));
+    }
+
+} // namespace impl
+
+/**
+ * @brief runs `f` right away if `executor` is running on this thread, otherwise posts it
+ * @see tcx::impl::dispatch
+ */
+template <typename E, typename F>
+void dispatch(E &executor, F &&f) requires(std::is_invocable_r_v<void, F>)
+{
+    tcx::impl::dispatch(executor, tcx::normal_priority, std::forward<F>(f));
+}
+
+/**
+ * @brief An executor running the handlers posted to it right away, on the thread posting them
+ *
+ * Used as the executor of an asynchronous operation, the handler runs inside the callback of the ring reaping it,
+ * without being moved to a queue first.
+ * Once `tcx::max_dispatch_depth` handlers are running one inside another, the next ones are queued on the thread instead,
+ * and ran by the outermost one when it returns, so handlers posting each other don't overflow the stack.
+ */
+class inline_executor {
+public:
+    using function_storage = tcx::unique_function<void()>;
+
+    template <typename F>
+    void post(F &&f) requires(std::is_invocable_r_v<void, F>)
+    {
+        if (!impl::inline_executor_running) {
+            outermost_guard const outermost;
+            {
+                impl::dispatch_depth_guard const guard;
+                std::forward<F>(f)();
+            }
+            run_deferred();
+        } else if (impl::dispatch_depth < max_dispatch_depth) {
+            impl::dispatch_depth_guard const guard;
+            std::forward<F>(f)();
+        } else {
+            defer(function_storage(std::forward<F>(f)));
+        }
+    }
+
+private:
+    // marks the outermost handler of this thread, the one running the queued ones
+    struct outermost_guard {
+        outermost_guard() noexcept
+        {
+            impl::inline_executor_running = true;
+        }
+
+        outermost_guard(outermost_guard const &) = delete;
+        outermost_guard &operator=(outermost_guard const &) = delete;
+
+        ~outermost_guard()
+        {
+            impl::inline_executor_running = false;
+        }
+    };
+
+    static void defer(function_storage f);
+    static void run_deferred();
+};
+
+} // namespace tcx
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef TCX_DYNAMIC_BUFFER_HPP
+#define TCX_DYNAMIC_BUFFER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <utility>
+
+namespace tcx {
+
+/**
+ * @brief A growable byte buffer with readable bytes at the front and writable space at the back
+ *
+ * Bytes are appended by writing into `prepare()` and making them readable with `commit()`,
+ * and removed from the front with `consume()`, which only moves an offset.
+ * The readable bytes are moved back to the start of the storage only when space is needed,
+ * so consuming small messages one at a time doesn't copy the rest of the buffer each time.
+ */
+class dynamic_buffer {
+public:
+    explicit dynamic_buffer(std::size_t max_size = std::numeric_limits<std::size_t>::max()) noexcept
+        : m_max_size(max_size)
+    {
+    }
+
+    dynamic_buffer(dynamic_buffer &&other) noexcept
+        : m_storage(std::move(other.m_storage))
+        , m_capacity(std::exchange(other.m_capacity, 0))
+        , m_begin(std::exchange(other.m_begin, 0))
+        , m_end(std::exchange(other.m_end, 0))
+        , m_max_size(other.m_max_size)
+    {
+    }
+
+    dynamic_buffer &operator=(dynamic_buffer &&other) noexcept
+    {
+        m_storage = std::move(other.m_storage);
+        m_capacity = std::exchange(other.m_capacity, 0);
+        m_begin = std::exchange(other.m_begin, 0);
+        m_end = std::exchange(other.m_end, 0);
+        m_max_size = other.m_max_size;
+        return *this;
+    }
+
+    [[nodiscard]] std::byte *data() noexcept
+    {
+        return m_storage.get() + m_begin;
+    }
+
+    [[nodiscard]] std::byte const *data() const noexcept
+    {
+        return m_storage.get() + m_begin;
+    }
+
+    /**
+     * @brief number of readable bytes
+     */
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return m_end - m_begin;
+    }
+
+    [[nodiscard]] std::size_t max_size() const noexcept
+    {
+        return m_max_size;
+    }
+
+    [[nodiscard]] std::size_t capacity() const noexcept
+    {
+        return m_capacity;
+    }
+
+    [[nodiscard]] std::string_view view() const noexcept
+    {
+        return std::string_view(reinterpret_cast<char const *>(data()), size());
+    }
+
+    /**
+     * @brief writable space for up to `n` bytes after the readable ones, less if it would go over `max_size()`
+     *
+     * The readable bytes may move, pointers into the buffer are invalidated.
+     */
+    [[nodiscard]] std::span<std::byte> prepare(std::size_t n)
+    {
+        n = std::min(n, m_max_size - size());
+        if (m_capacity - m_end < n) {
+            std::size_t const needed = size() + n;
+            if (m_begin != 0 && needed <= m_capacity) {
+                std::memmove(m_storage.get(), data(), size());
+            } else {
+                std::size_t const capacity = std::max(needed, std::min(m_capacity * 2, m_max_size));
+                auto storage = std::make_unique_for_overwrite<std::byte[]>(capacity);
+                if (size() != 0)
+                    std::memcpy(storage.get(), data(), size());
+                m_storage = std::move(storage);
+                m_capacity = capacity;
+            }
+            m_end -= m_begin;
+            m_begin = 0;
+        }
+        return std::span(m_storage.get() + m_end, n);
+    }
+
+    /**
+     * @brief makes `n` bytes written into `prepare()` readable
+     */
+    void commit(std::size_t n) noexcept
+    {
+        m_end += std::min(n, m_capacity - m_end);
+    }
+
+    /**
+     * @brief removes `n` bytes from the front
+     */
+    void consume(std::size_t n) noexcept
+    {
+        m_begin += std::min(n, size());
+        if (m_begin == m_end)
+            m_begin = m_end = 0;
+    }
+
+    void clear() noexcept
+    {
+        m_begin = m_end = 0;
+    }
+
+private:
+    std::unique_ptr<std::byte[]> m_storage;
+    std::size_t m_capacity = 0;
+    std::size_t m_begin = 0;
+    std::size_t m_end = 0;
+    std::size_t m_max_size;
+};
+
+} // namespace tcx
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef TCX_IO_CONTEXT_HPP
+#define TCX_IO_CONTEXT_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <tcx/priority.hpp>
+#include <tcx/services/uring_service.hpp>
+#include <tcx/unique_function.hpp>
+#include <tcx/unsynchronized_execution_context.hpp>
+
+namespace tcx {
+
+/**
+ * @brief an io_uring ring and the queue of handlers it's completions are posted to, run by a single thread
+ *
+ * It's both the executor and the service of the async operations:
+ * ```cpp
+ * tcx::io_context context(tcx::unsynchronized_uring_context<>::create(256).value());
+ * tcx::async_read(context, context.service(), fd, buffer, size, 0, handler);
+ * context.run();
+ * ```
+ *
+ * Handlers posted from the thread running it go to a queue only that thread touches.
+ * Handlers posted from any other thread go to a lock free list, and if the loop is blocked waiting for completions,
+ * it's woken by an eventfd read it always has in flight.
+ */
+class io_context {
+public:
+    using function_storage = tcx::unique_function<void()>;
+    using service_type = tcx::unsynchronized_uring_context<>;
+
+    /**
+     * @param lanes the number of priority lanes of the queue of handlers, see `tcx::unsynchronized_execution_context`
+     * @throws std::system_error if the eventfd can't be created
+     */
+    explicit io_context(service_type ring, std::size_t lanes = 1, std::size_t aging_limit = tcx::default_aging_limit);
+
+    io_context(io_context const &) = delete;
+    io_context(io_context &&) = delete;
+
+    io_context &operator=(io_context const &) = delete;
+    io_context &operator=(io_context &&) = delete;
+
+    ~io_context();
+
+    template <typename F>
+    void post(F &&f) requires(std::is_invocable_r_v<void, F>)
+    {
+        post(tcx::normal_priority, std::forward<F>(f));
+    }
+
+    template <typename F>
+    void post(tcx::priority priority, F &&f) requires(std::is_invocable_r_v<void, F>)
+    {
+        if (running_in_this_thread())
+            m_local.post(priority, std::forward<F>(f));
+        else
+            post_remote(new remote_handler { nullptr, priority, function_storage(std::forward<F>(f)) });
+    }
+
+    /**
+     * @brief keeps `run()` from returning when it runs out of work, for as long as it's alive
+     *
+     * For a context only fed by `post()` from other threads.
+     */
+    class work_guard {
+    public:
+        explicit work_guard(io_context &context) noexcept
+            : m_context(&context)
+        {
+            m_context->m_work.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        work_guard(work_guard const &) = delete;
+        work_guard &operator=(work_guard const &) = delete;
+
+        ~work_guard()
+        {
+            m_context->release_work();
+        }
+
+    private:
+        io_context *m_context;
+    };
+
+    /**
+     * @brief runs handlers and completions until `stop()` is called, or until there's no handler queued, no operation in flight and no `work_guard`
+     *
+     * Queued handlers are run in batches, submitting and reaping without waiting between them,
+     * it only blocks in `io_uring_submit_and_wait()` when there's no handler left.
+     * @return the number of handlers ran
+     */
+    std::size_t run();
+
+    /**
+     * @brief runs the queued handlers, then submits and reaps without waiting
+     * @return the number of handlers ran
+     */
+    std::size_t poll();
+
+    /**
+     * @brief makes `run()` return once it's current handler finishes, can be called from any thread
+     */
+    void stop() noexcept;
+
+    [[nodiscard]] bool stopped() const noexcept
+    {
+        return m_stopped.load(std::memory_order_relaxed);
+    }
+
+    void restart() noexcept
+    {
+        m_stopped.store(false, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief true if called from the thread running this context
+     */
+    [[nodiscard]] bool running_in_this_thread() const noexcept;
+
+    [[nodiscard]] service_type &service() noexcept
+    {
+        return m_ring;
+    }
+
+private:
+    struct remote_handler {
+        remote_handler *next;
+        tcx::priority priority;
+        function_storage f;
+    };
+
+    void post_remote(remote_handler *handler) noexcept;
+    void take_remote();
+    void reap(std::uint32_t wait_nr);
+    void arm_wakeup();
+    void wake() noexcept;
+    void release_work() noexcept;
+    [[nodiscard]] bool has_operations() const noexcept;
+
+    service_type m_ring;
+    tcx::unsynchronized_execution_context m_local;
+    int m_wakeup_fd;
+    std::uint64_t m_wakeup_value = 0;
+    // the eventfd read is submitted without a completion object, it's rearmed by `reap()`
+    tcx::uring_flag m_wakeup_armed;
+
+    // pushed to by any thread, taken as a whole by the loop
+    alignas(64) std::atomic<remote_handler *> m_remote = nullptr;
+    // set while the loop blocks, whoever clears it writes to the eventfd
+    std::atomic_bool m_sleeping = false;
+    std::atomic_bool m_stopped = false;
+    std::atomic_size_t m_work = 0;
+};
+
+} // namespace tcx
+
+#endif
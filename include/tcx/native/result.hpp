@@ -103,12 +103,12 @@ struct result {
 
     [[nodiscard]] constexpr bool has_value() const noexcept
     {
-        return m_value.first;
+        return m_value.first == error_type {};
     }
 
     [[nodiscard]] constexpr bool has_error() const noexcept
     {
-        return !m_value.first;
+        return !has_value();
     }
 
     constexpr static result from_error(error_type error) noexcept
@@ -166,7 +166,7 @@ struct result {
     requires(!std::is_trivially_destructible_v<value_type>)
     {
         if (has_value())
-            std::destroy_at(std::addressof(m_value.second));
+            std::destroy_at(std::addressof(m_value.second.value));
     }
 
     ~result()
@@ -191,7 +191,7 @@ struct result<T> {
 
     [[nodiscard]] constexpr bool has_value() const noexcept
     {
-        return m_value;
+        return m_value == error_type {};
     }
 
     [[nodiscard]] constexpr bool has_error() const noexcept
@@ -0,0 +1,224 @@
+#ifndef TCX_NET_CONNECTION_POOL_HPP
+#define TCX_NET_CONNECTION_POOL_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include <tcx/async/concepts.hpp>
+#include <tcx/async/wrap_op.hpp>
+#include <tcx/net/endpoint.hpp>
+#include <tcx/net/tcp.hpp>
+
+namespace tcx {
+
+struct connection_pool_options {
+    /// idle connections kept per endpoint, the oldest are closed past it
+    std::size_t max_idle_per_endpoint = 16;
+    /// idle connections older than this are closed instead of reused
+    std::chrono::steady_clock::duration idle_timeout = std::chrono::seconds(60);
+    /// disable Nagle's algorithm on new connections
+    bool no_delay = true;
+    /// open new connections as direct descriptors, only supported by `tcx::uring_context` services
+    bool direct = false;
+};
+
+namespace impl {
+    template <typename E, typename Service>
+    struct connection_pool_acquire_operation;
+} // namespace impl
+
+/**
+ * @brief Keeps connections to the endpoints it connected to, so later requests don't pay for the handshake again
+ *
+ * Connections are reused last in first out, which keeps the least used ones ageing out. Before handing out
+ * an idle connection that isn't a direct descriptor, it's checked for having been closed by the peer, or having
+ * received data nobody asked for, either way it's closed instead. Direct descriptors can't be checked
+ * without going through the ring, so those are handed out as is.
+ */
+template <typename E, typename Service>
+class connection_pool {
+public:
+    using socket_type = tcx::tcp_socket<E, Service>;
+
+    connection_pool(E &executor, Service &service, connection_pool_options options = {})
+        : m_executor(executor)
+        , m_service(service)
+        , m_options(options)
+    {
+    }
+
+    connection_pool(connection_pool const &) = delete;
+    connection_pool &operator=(connection_pool const &) = delete;
+
+    [[nodiscard]] connection_pool_options const &options() const noexcept
+    {
+        return m_options;
+    }
+
+    /**
+     * @brief a connection to `remote`, an idle one if there's any or a new one otherwise
+     */
+    template <typename F>
+    requires tcx::completion_handler<F, socket_type>
+    auto async_acquire(endpoint const &remote, F &&f)
+    {
+        return tcx::impl::wrap_op<tcx::impl::connection_pool_acquire_operation<E, Service>>::call(m_executor, *this, std::forward<F>(f), remote);
+    }
+
+    /**
+     * @brief gives back a connection for reuse, it's closed if it isn't in a reusable state or there are already enough
+     *
+     * The connection must not have any operation in flight, and should be at a request boundary.
+     */
+    void release(socket_type &&socket)
+    {
+        socket_type released = std::move(socket);
+        if (!released.is_open() || m_options.max_idle_per_endpoint == 0)
+            return;
+
+        // declared before the lock, so it's closed after unlocking
+        std::optional<socket_type> evicted;
+        std::lock_guard lock(m_mutex);
+        auto &connections = m_idle[released.remote_endpoint()];
+        if (connections.size() >= m_options.max_idle_per_endpoint) {
+            evicted.emplace(std::move(connections.front().socket));
+            connections.erase(connections.begin());
+        }
+        connections.push_back(idle_connection { std::move(released), std::chrono::steady_clock::now() });
+    }
+
+    /**
+     * @brief the number of idle connections
+     */
+    [[nodiscard]] std::size_t idle() const
+    {
+        std::lock_guard lock(m_mutex);
+        std::size_t count = 0;
+        for (auto const &[remote, connections] : m_idle)
+            count += connections.size();
+        return count;
+    }
+
+    /**
+     * @brief closes every idle connection
+     */
+    void clear()
+    {
+        decltype(m_idle) idle;
+        std::lock_guard lock(m_mutex);
+        idle.swap(m_idle);
+    }
+
+private:
+    friend struct impl::connection_pool_acquire_operation<E, Service>;
+
+    struct idle_connection {
+        socket_type socket;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    // the newest idle connection to `remote` that is still usable, closing every stale one found on the way
+    std::optional<socket_type> take(endpoint const &remote)
+    {
+        std::vector<socket_type> stale;
+        std::optional<socket_type> result;
+        {
+            std::lock_guard lock(m_mutex);
+            auto const it = m_idle.find(remote);
+            if (it == m_idle.end())
+                return std::nullopt;
+
+            auto &connections = it->second;
+            auto const deadline = std::chrono::steady_clock::now() - m_options.idle_timeout;
+            auto expired = connections.begin();
+            while (expired != connections.end() && expired->since < deadline)
+                ++expired;
+            for (auto i = connections.begin(); i != expired; ++i)
+                stale.push_back(std::move(i->socket));
+            connections.erase(connections.begin(), expired);
+
+            while (!connections.empty() && !result) {
+                socket_type candidate = std::move(connections.back().socket);
+                connections.pop_back();
+                if (alive(candidate))
+                    result.emplace(std::move(candidate));
+                else
+                    stale.push_back(std::move(candidate));
+            }
+            if (connections.empty())
+                m_idle.erase(it);
+        }
+        return result;
+    }
+
+    static bool alive(socket_type const &socket) noexcept
+    {
+        if (socket.is_direct())
+            return true;
+        // nothing to read is the only good answer, end of file or data nobody asked for both mean it can't be reused
+        char byte;
+        ssize_t const result = ::recv(socket.native_handle(), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+        return result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+
+    E &m_executor;
+    Service &m_service;
+    connection_pool_options m_options;
+    mutable std::mutex m_mutex;
+    std::unordered_map<endpoint, std::vector<idle_connection>> m_idle;
+};
+
+namespace impl {
+
+    template <typename E, typename Service>
+    struct connection_pool_acquire_operation {
+        using result_type = tcx::tcp_socket<E, Service>;
+
+        template <typename F>
+        static void call(E &executor, tcx::connection_pool<E, Service> &pool, endpoint const &remote, F &&f)
+        {
+            using operation_type = tcp_operation<E, result_type, std::remove_cvref_t<F>>;
+            auto operation = std::make_shared<operation_type>(executor, std::forward<F>(f));
+
+            if (auto socket = pool.take(remote))
+                return operation->succeed(0, std::move(*socket));
+
+            auto const options = pool.options();
+            auto connect = [operation, remote, options](result_type socket) {
+                auto connecting = std::make_shared<result_type>(std::move(socket));
+                connecting->async_connect(remote, [operation, connecting, options](std::variant<std::error_code, std::monostate> result) {
+                    if (result.index() == 0)
+                        return operation->fail(0, std::get<0>(result));
+                    if (options.no_delay && !connecting->is_direct())
+                        connecting->set_no_delay();
+                    operation->succeed(0, std::move(*connecting));
+                });
+            };
+
+            if (options.direct && tcp_backend<Service>::supports_direct) {
+                result_type::async_open(executor, pool.m_service, remote.family(), true, [operation, connect = std::move(connect)](std::variant<std::error_code, result_type> result) mutable {
+                    if (result.index() == 0)
+                        return operation->fail(0, std::get<0>(result));
+                    connect(std::move(std::get<1>(result)));
+                });
+            } else {
+                connect(result_type(executor, pool.m_service));
+            }
+        }
+    };
+
+} // namespace impl
+
+} // namespace tcx
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef TCX_NET_ENDPOINT_HPP
+#define TCX_NET_ENDPOINT_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <tcx/native/result.hpp>
+
+namespace tcx {
+
+/**
+ * @brief An IPv4 or IPv6 address and port
+ */
+class endpoint {
+public:
+    endpoint() noexcept = default;
+
+    endpoint(sockaddr const *address, socklen_t size) noexcept
+    {
+        m_size = std::min<socklen_t>(size, sizeof(m_storage));
+        std::memcpy(&m_storage, address, m_size);
+    }
+
+    /**
+     * @brief parses the numeric address `address`, without brackets for IPv6
+     */
+    static native::result<endpoint> parse(std::string_view address, std::uint16_t port) noexcept
+    {
+        char buffer[INET6_ADDRSTRLEN];
+        if (address.size() >= sizeof(buffer))
+            return native::result<endpoint>::from_error(EINVAL);
+        address.copy(buffer, address.size());
+        buffer[address.size()] = '\0';
+
+        endpoint parsed;
+        if (::inet_pton(AF_INET, buffer, &parsed.v4().sin_addr) == 1) {
+            parsed.v4().sin_family = AF_INET;
+            parsed.v4().sin_port = htons(port);
+            parsed.m_size = sizeof(sockaddr_in);
+        } else if (::inet_pton(AF_INET6, buffer, &parsed.v6().sin6_addr) == 1) {
+            parsed.v6().sin6_family = AF_INET6;
+            parsed.v6().sin6_port = htons(port);
+            parsed.m_size = sizeof(sockaddr_in6);
+        } else {
+            return native::result<endpoint>::from_error(EINVAL);
+        }
+        return native::result<endpoint>::from_value(parsed);
+    }
+
+    static endpoint loopback(std::uint16_t port, int family = AF_INET) noexcept
+    {
+        endpoint result;
+        if (family == AF_INET6) {
+            result.v6().sin6_family = AF_INET6;
+            result.v6().sin6_addr = in6addr_loopback;
+            result.v6().sin6_port = htons(port);
+            result.m_size = sizeof(sockaddr_in6);
+        } else {
+            result.v4().sin_family = AF_INET;
+            result.v4().sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            result.v4().sin_port = htons(port);
+            result.m_size = sizeof(sockaddr_in);
+        }
+        return result;
+    }
+
+    static endpoint any(std::uint16_t port, int family = AF_INET) noexcept
+    {
+        endpoint result = loopback(port, family);
+        if (family == AF_INET6)
+            result.v6().sin6_addr = in6addr_any;
+        else
+            result.v4().sin_addr.s_addr = htonl(INADDR_ANY);
+        return result;
+    }
+
+    [[nodiscard]] sockaddr const *data() const noexcept
+    {
+        return reinterpret_cast<sockaddr const *>(&m_storage);
+    }
+
+    [[nodiscard]] sockaddr *data() noexcept
+    {
+        return reinterpret_cast<sockaddr *>(&m_storage);
+    }
+
+    [[nodiscard]] socklen_t size() const noexcept
+    {
+        return m_size;
+    }
+
+    /**
+     * @brief size of the storage, for filling in with `accept()` or `getsockname()` and then `resize()`
+     */
+    [[nodiscard]] constexpr static socklen_t capacity() noexcept
+    {
+        return sizeof(sockaddr_storage);
+    }
+
+    void resize(socklen_t size) noexcept
+    {
+        m_size = std::min<socklen_t>(size, sizeof(m_storage));
+    }
+
+    [[nodiscard]] int family() const noexcept
+    {
+        return m_size == 0 ? AF_UNSPEC : m_storage.ss_family;
+    }
+
+    [[nodiscard]] std::uint16_t port() const noexcept
+    {
+        if (family() == AF_INET)
+            return ntohs(v4().sin_port);
+        if (family() == AF_INET6)
+            return ntohs(v6().sin6_port);
+        return 0;
+    }
+
+    /**
+     * @brief the address and port as `1.2.3.4:80` or `[::1]:80`
+     */
+    [[nodiscard]] std::string to_string() const
+    {
+        char buffer[INET6_ADDRSTRLEN];
+        if (family() == AF_INET && ::inet_ntop(AF_INET, &v4().sin_addr, buffer, sizeof(buffer)))
+            return std::string(buffer) + ':' + std::to_string(port());
+        if (family() == AF_INET6 && ::inet_ntop(AF_INET6, &v6().sin6_addr, buffer, sizeof(buffer)))
+            return '[' + std::string(buffer) + "]:" + std::to_string(port());
+        return {};
+    }
+
+    friend bool operator==(endpoint const &a, endpoint const &b) noexcept
+    {
+        if (a.family() != b.family())
+            return false;
+        if (a.family() == AF_INET)
+            return a.v4().sin_port == b.v4().sin_port && a.v4().sin_addr.s_addr == b.v4().sin_addr.s_addr;
+        if (a.family() == AF_INET6)
+            return a.v6().sin6_port == b.v6().sin6_port && a.v6().sin6_scope_id == b.v6().sin6_scope_id
+                && std::memcmp(&a.v6().sin6_addr, &b.v6().sin6_addr, sizeof(in6_addr)) == 0;
+        return a.m_size == b.m_size && std::memcmp(&a.m_storage, &b.m_storage, a.m_size) == 0;
+    }
+
+    [[nodiscard]] std::size_t hash() const noexcept
+    {
+        std::string_view bytes;
+        if (family() == AF_INET)
+            bytes = std::string_view(reinterpret_cast<char const *>(&v4().sin_addr), sizeof(in_addr));
+        else if (family() == AF_INET6)
+            bytes = std::string_view(reinterpret_cast<char const *>(&v6().sin6_addr), sizeof(in6_addr));
+        return std::hash<std::string_view>()(bytes) ^ (static_cast<std::size_t>(port()) << 1) ^ static_cast<std::size_t>(family());
+    }
+
+private:
+    sockaddr_in &v4() noexcept
+    {
+        return reinterpret_cast<sockaddr_in &>(m_storage);
+    }
+
+    sockaddr_in const &v4() const noexcept
+    {
+        return reinterpret_cast<sockaddr_in const &>(m_storage);
+    }
+
+    sockaddr_in6 &v6() noexcept
+    {
+        return reinterpret_cast<sockaddr_in6 &>(m_storage);
+    }
+
+    sockaddr_in6 const &v6() const noexcept
+    {
+        return reinterpret_cast<sockaddr_in6 const &>(m_storage);
+    }
+
+    sockaddr_storage m_storage {};
+    socklen_t m_size = 0;
+};
+
+} // namespace tcx
+
+template <>
+struct std::hash<tcx::endpoint> {
+    std::size_t operator()(tcx::endpoint const &endpoint) const noexcept
+    {
+        return endpoint.hash();
+    }
+};
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef TCX_NET_EPOLL_TCP_HPP
+#define TCX_NET_EPOLL_TCP_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <system_error>
+#include <utility>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <tcx/net/tcp.hpp>
+#include <tcx/services/epoll_service.hpp>
+
+namespace tcx::impl {
+
+/**
+ * @brief non blocking sockets driven by `tcx::epoll_service`, every operation is attempted before waiting for readiness
+ *
+ * Like every other use of the service, a socket can only wait for one thing at a time,
+ * so reading and writing at the same time fails with `EEXIST` when both have to wait.
+ */
+template <>
+struct tcp_backend<tcx::epoll_service> {
+    constexpr static int socket_flags = SOCK_NONBLOCK;
+    constexpr static bool supports_direct = false;
+
+    template <typename F>
+    static int connect(tcx::epoll_service &service, socket_handle handle, endpoint const &remote, F &&f)
+    {
+        if (::connect(handle.value, remote.data(), remote.size()) == 0)
+            return f(0, 0), 0;
+        if (errno != EINPROGRESS)
+            return f(-errno, 0), 0;
+        return wait(service, handle.value, EPOLLOUT, std::forward<F>(f), [fd = handle.value](auto &callback) {
+            int error = 0;
+            socklen_t size = sizeof(error);
+            if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) < 0)
+                error = errno;
+            callback(-error, 0);
+            return true;
+        });
+    }
+
+    template <typename F>
+    static int receive(tcx::epoll_service &service, socket_handle handle, void *buf, std::size_t len, F &&f)
+    {
+        return attempt(service, handle.value, EPOLLIN, std::forward<F>(f), [fd = handle.value, buf, len]() {
+            return ::recv(fd, buf, len, 0);
+        });
+    }
+
+    template <typename F>
+    static int send(tcx::epoll_service &service, socket_handle handle, void const *buf, std::size_t len, F &&f)
+    {
+        return attempt(service, handle.value, EPOLLOUT, std::forward<F>(f), [fd = handle.value, buf, len]() {
+            return ::send(fd, buf, len, MSG_NOSIGNAL);
+        });
+    }
+
+    template <typename F>
+    static int accept(tcx::epoll_service &service, socket_handle listener, bool, sockaddr *address, socklen_t *size, F &&f)
+    {
+        socklen_t const capacity = *size;
+        return attempt(service, listener.value, EPOLLIN, std::forward<F>(f), [fd = listener.value, address, size, capacity]() {
+            *size = capacity;
+            return static_cast<ssize_t>(::accept4(fd, address, size, SOCK_CLOEXEC | SOCK_NONBLOCK));
+        });
+    }
+
+    static std::error_code shutdown(tcx::epoll_service &, socket_handle handle, int how) noexcept
+    {
+        return ::shutdown(handle.value, how) < 0 ? std::error_code(errno, std::system_category()) : std::error_code();
+    }
+
+    // the pending wait is completed with ECANCELED by removing it
+    static void close(tcx::epoll_service &service, socket_handle handle) noexcept
+    {
+        try {
+            service.poll_remove(handle.value);
+        } catch (...) {
+            // it never waited
+        }
+        ::close(handle.value);
+    }
+
+private:
+    // invokes `f` with the result of `operation`, waiting for `events` as long as it would block
+    template <typename F, typename Operation>
+    static int attempt(tcx::epoll_service &service, int fd, std::uint32_t events, F &&f, Operation operation)
+    {
+        ssize_t const result = operation();
+        if (result >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+            return f(result >= 0 ? static_cast<int>(result) : -errno, 0), 0;
+        return wait(service, fd, events, std::forward<F>(f), [operation](auto &callback) {
+            ssize_t const result = operation();
+            if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return false;
+            callback(result >= 0 ? static_cast<int>(result) : -errno, 0);
+            return true;
+        });
+    }
+
+    // `ready` is invoked with the callback once `fd` has `events`, and returns false to wait again
+    template <typename F, typename Ready>
+    static int wait(tcx::epoll_service &service, int fd, std::uint32_t events, F &&f, Ready ready)
+    {
+        // shared, so a failure to wait again can still be reported through it
+        auto callback = std::make_shared<std::remove_cvref_t<F>>(std::forward<F>(f));
+        return poll(service, fd, events, std::move(callback), std::move(ready));
+    }
+
+    template <typename Callback, typename Ready>
+    static int poll(tcx::epoll_service &service, int fd, std::uint32_t events, std::shared_ptr<Callback> callback, Ready ready)
+    {
+        try {
+            service.async_poll_add(fd, events, [&service, fd, events, callback, ready](std::int32_t result) mutable {
+                if (result < 0)
+                    return (*callback)(result, 0);
+                if (ready(*callback))
+                    return;
+                if (int const error = poll(service, fd, events, callback, std::move(ready)); error < 0)
+                    (*callback)(error, 0);
+            });
+        } catch (std::system_error const &error) {
+            return -error.code().value();
+        }
+        return 0;
+    }
+};
+
+} // namespace tcx::impl
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef TCX_NET_IORING_TCP_HPP
+#define TCX_NET_IORING_TCP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <system_error>
+#include <utility>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <tcx/net/tcp.hpp>
+#include <tcx/services/uring_service.hpp>
+
+namespace tcx::impl {
+
+/**
+ * @brief sockets driven by an io_uring context, with every operation submitted to the ring
+ */
+template <tcx::uring_context Service>
+struct tcp_backend<Service> {
+    constexpr static int socket_flags = 0;
+    constexpr static bool supports_direct = true;
+
+    template <typename F>
+    static int submit(Service &service, io_uring_sqe &op, socket_handle handle, F &&f)
+    {
+        if (handle.direct)
+            op.flags |= IOSQE_FIXED_FILE;
+        auto const result = service.submit(&op, [f = std::forward<F>(f)](Service &, io_uring_cqe const *cqe) mutable {
+            f(cqe->res, cqe->user_data);
+        });
+        return result.has_error() ? -static_cast<int>(result.error()) : 0;
+    }
+
+    template <typename F>
+    static int open_direct(Service &service, int family, F &&f)
+    {
+        io_uring_sqe op {};
+        // there's no descriptor to close on exec, the kernel rejects the flag
+        io_uring_prep_socket_direct_alloc(&op, family, SOCK_STREAM, 0, 0);
+        return submit(service, op, socket_handle {}, std::forward<F>(f));
+    }
+
+    template <typename F>
+    static int connect(Service &service, socket_handle handle, endpoint const &remote, F &&f)
+    {
+        io_uring_sqe op {};
+        io_uring_prep_connect(&op, handle.value, remote.data(), remote.size());
+        return submit(service, op, handle, std::forward<F>(f));
+    }
+
+    template <typename F>
+    static int receive(Service &service, socket_handle handle, void *buf, std::size_t len, F &&f)
+    {
+        io_uring_sqe op {};
+        io_uring_prep_recv(&op, handle.value, buf, len, 0);
+        return submit(service, op, handle, std::forward<F>(f));
+    }
+
+    template <typename F>
+    static int send(Service &service, socket_handle handle, void const *buf, std::size_t len, F &&f)
+    {
+        io_uring_sqe op {};
+        io_uring_prep_send(&op, handle.value, buf, len, MSG_NOSIGNAL);
+        return submit(service, op, handle, std::forward<F>(f));
+    }
+
+    template <typename F>
+    static int accept(Service &service, socket_handle listener, bool direct, sockaddr *address, socklen_t *size, F &&f)
+    {
+        io_uring_sqe op {};
+        if (direct)
+            io_uring_prep_accept_direct(&op, listener.value, address, size, 0, IORING_FILE_INDEX_ALLOC);
+        else
+            io_uring_prep_accept(&op, listener.value, address, size, SOCK_CLOEXEC);
+        return submit(service, op, listener, std::forward<F>(f));
+    }
+
+    static std::error_code shutdown(Service &service, socket_handle handle, int how) noexcept
+    {
+        if (!handle.direct)
+            return ::shutdown(handle.value, how) < 0 ? std::error_code(errno, std::system_category()) : std::error_code();
+        // there's no descriptor to call it on, nothing waits for the result either
+        io_uring_sqe op {};
+        io_uring_prep_shutdown(&op, handle.value, how);
+        return std::error_code(-submit(service, op, handle, [](int, std::uint64_t) {}), std::system_category());
+    }
+
+    // the socket is closed once every operation on it is cancelled, so it's number can't be reused while they are in flight
+    static void close(Service &service, socket_handle handle) noexcept
+    {
+        io_uring_sqe op {};
+        io_uring_prep_cancel_fd(&op, handle.value, IORING_ASYNC_CANCEL_ALL | (handle.direct ? IORING_ASYNC_CANCEL_FD_FIXED : 0));
+        int const error = submit(service, op, socket_handle {}, [&service, handle](int, std::uint64_t) {
+            io_uring_sqe op {};
+            if (handle.direct)
+                io_uring_prep_close_direct(&op, static_cast<unsigned>(handle.value));
+            else
+                io_uring_prep_close(&op, handle.value);
+            if (submit(service, op, socket_handle {}, [](int, std::uint64_t) {}) < 0 && !handle.direct)
+                ::close(handle.value);
+        });
+        if (error < 0 && !handle.direct)
+            ::close(handle.value);
+    }
+};
+
+} // namespace tcx::impl
+
+#endif
@@ -0,0 +1,587 @@
+#ifndef TCX_NET_TCP_HPP
+#define TCX_NET_TCP_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <system_error>
+#include <utility>
+#include <variant>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <tcx/async/bind_priority.hpp>
+#include <tcx/async/concepts.hpp>
+#include <tcx/async/wrap_op.hpp>
+#include <tcx/native/handle.hpp>
+#include <tcx/net/endpoint.hpp>
+#include <tcx/trace.hpp>
+
+namespace tcx {
+namespace impl {
+
+    /**
+     * @brief a socket, either a file descriptor or an index in the fixed file table of a ring
+     */
+    struct socket_handle {
+        tcx::native::handle_type value = tcx::native::invalid_handle;
+        bool direct = false;
+
+        [[nodiscard]] bool is_open() const noexcept
+        {
+            return value != tcx::native::invalid_handle;
+        }
+    };
+
+    /**
+     * @brief how the sockets are driven by `Service`, specialized by `tcx/net/ioring_tcp.hpp` and `tcx/net/epoll_tcp.hpp`
+     *
+     * Every asynchronous function invokes it's callback with the result, a negative `errno` on failure,
+     * and the id of the operation for tracing. If it returns an error instead, the callback is never invoked.
+     */
+    template <typename Service>
+    struct tcp_backend;
+
+    /**
+     * @brief the state of a socket operation, only the result is posted to the executor
+     */
+    template <typename E, typename T, typename F>
+    class tcp_operation : public std::enable_shared_from_this<tcp_operation<E, T, F>> {
+        using variant_type = std::variant<std::error_code, std::conditional_t<std::is_void_v<T>, std::monostate, T>>;
+
+    public:
+        template <typename G>
+        tcp_operation(E &executor, G &&handler)
+            : m_executor(executor)
+            , m_handler(std::forward<G>(handler))
+        {
+        }
+
+        void fail(std::uint64_t id, std::error_code error)
+        {
+            tcx::trace::dispatch(m_executor, id, tcx::impl::associated_priority(m_handler), [self = this->shared_from_this(), error]() mutable {
+                return self->m_handler(variant_type(std::in_place_index<0>, error));
+            });
+        }
+
+        // a negative errno as returned by the backends
+        void fail(std::uint64_t id, int error)
+        {
+            fail(id, std::error_code(-error, std::system_category()));
+        }
+
+        template <typename... Args>
+        void succeed(std::uint64_t id, Args &&...args)
+        {
+            tcx::trace::dispatch(m_executor, id, tcx::impl::associated_priority(m_handler), [self = this->shared_from_this(), value = variant_type(std::in_place_index<1>, std::forward<Args>(args)...)]() mutable {
+                return self->m_handler(std::move(value));
+            });
+        }
+
+    private:
+        E &m_executor;
+        F m_handler;
+    };
+
+    template <typename E, typename Service>
+    struct tcp_open_operation;
+    struct tcp_connect_operation;
+    struct tcp_read_some_operation;
+    struct tcp_write_some_operation;
+    struct tcp_write_operation;
+    template <typename E, typename Service>
+    struct tcp_accept_operation;
+
+} // namespace impl
+
+/**
+ * @brief A TCP connection driven by `Service`, that posts the results of it's operations to `E`
+ *
+ * The socket is closed when destroyed. Operations still in flight are cancelled first, and complete with `ECANCELED`,
+ * the descriptor itself is closed once the cancellation completes, so it can't be reused while they are in flight.
+ * With `tcx::uring_context` services the socket can be a direct descriptor, living only in the fixed file table
+ * of the ring, which saves looking the file up on every operation. Those need a file table registered with
+ * `register_files_sparse()`, and the ring allocates their slots.
+ *
+ * Include `tcx/net/ioring_tcp.hpp` or `tcx/net/epoll_tcp.hpp` for the services to use it with.
+ */
+template <typename E, typename Service>
+class tcp_socket {
+    using backend = impl::tcp_backend<Service>;
+
+public:
+    tcp_socket(E &executor, Service &service) noexcept
+        : m_executor(&executor)
+        , m_service(&service)
+    {
+    }
+
+    /**
+     * @brief adopts `handle`, a connected socket
+     */
+    tcp_socket(E &executor, Service &service, impl::socket_handle handle, endpoint const &remote = {}) noexcept
+        : m_executor(&executor)
+        , m_service(&service)
+        , m_handle(handle)
+        , m_remote(remote)
+    {
+    }
+
+    tcp_socket(tcp_socket &&other) noexcept
+        : m_executor(other.m_executor)
+        , m_service(other.m_service)
+        , m_handle(std::exchange(other.m_handle, impl::socket_handle {}))
+        , m_remote(other.m_remote)
+    {
+    }
+
+    tcp_socket &operator=(tcp_socket &&other) noexcept
+    {
+        if (this != &other) {
+            close();
+            m_executor = other.m_executor;
+            m_service = other.m_service;
+            m_handle = std::exchange(other.m_handle, impl::socket_handle {});
+            m_remote = other.m_remote;
+        }
+        return *this;
+    }
+
+    ~tcp_socket()
+    {
+        close();
+    }
+
+    [[nodiscard]] E &executor() const noexcept
+    {
+        return *m_executor;
+    }
+
+    [[nodiscard]] Service &service() const noexcept
+    {
+        return *m_service;
+    }
+
+    [[nodiscard]] bool is_open() const noexcept
+    {
+        return m_handle.is_open();
+    }
+
+    /**
+     * @brief true if `native_handle()` is an index in the fixed file table of the ring instead of a file descriptor
+     */
+    [[nodiscard]] bool is_direct() const noexcept
+    {
+        return m_handle.direct;
+    }
+
+    [[nodiscard]] tcx::native::handle_type native_handle() const noexcept
+    {
+        return m_handle.value;
+    }
+
+    [[nodiscard]] impl::socket_handle handle() const noexcept
+    {
+        return m_handle;
+    }
+
+    /**
+     * @brief the peer, as given to `async_connect()` or returned by `accept()`
+     */
+    [[nodiscard]] endpoint const &remote_endpoint() const noexcept
+    {
+        return m_remote;
+    }
+
+    /**
+     * @brief gives up ownership of the socket without closing it
+     */
+    impl::socket_handle release() noexcept
+    {
+        return std::exchange(m_handle, impl::socket_handle {});
+    }
+
+    /**
+     * @brief cancels the operations in flight and closes the socket
+     */
+    void close() noexcept
+    {
+        if (m_handle.is_open())
+            backend::close(*m_service, std::exchange(m_handle, impl::socket_handle {}));
+    }
+
+    /**
+     * @see [_man 2 shutdown_](https://man.archlinux.org/man/shutdown.2.en)
+     */
+    std::error_code shutdown(int how = SHUT_WR) noexcept
+    {
+        return backend::shutdown(*m_service, m_handle, how);
+    }
+
+    /**
+     * @brief disables Nagle's algorithm, not supported on direct descriptors
+     */
+    std::error_code set_no_delay(bool enabled = true) noexcept
+    {
+        if (m_handle.direct)
+            return std::make_error_code(std::errc::operation_not_supported);
+        int const value = enabled;
+        if (::setsockopt(m_handle.value, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value)) < 0)
+            return std::error_code(errno, std::system_category());
+        return {};
+    }
+
+    /**
+     * @brief opens a socket of `family`, posted to `executor` as a socket that posts to it too
+     * @param direct open it as a direct descriptor, which only the ring can do, asynchronously
+     */
+    template <typename F>
+    requires tcx::completion_handler<F, tcx::tcp_socket<E, Service>>
+    static auto async_open(E &executor, Service &service, int family, bool direct, F &&f)
+    {
+        return tcx::impl::wrap_op<tcx::impl::tcp_open_operation<E, Service>>::call(executor, service, std::forward<F>(f), family, direct);
+    }
+
+    /**
+     * @brief connects to `remote`, opening a socket of it's family first if this one isn't open
+     */
+    template <typename F>
+    requires tcx::completion_handler<F, void>
+    auto async_connect(endpoint const &remote, F &&f)
+    {
+        return tcx::impl::wrap_op<tcx::impl::tcp_connect_operation>::call(*m_executor, *this, std::forward<F>(f), remote);
+    }
+
+    /**
+     * @brief receives up to `len` bytes, completes with zero once the peer shut it's side down
+     */
+    template <typename F>
+    requires tcx::completion_handler<F, std::size_t>
+    auto async_read_some(void *buf, std::size_t len, F &&f)
+    {
+        return tcx::impl::wrap_op<tcx::impl::tcp_read_some_operation>::call(*m_executor, *this, std::forward<F>(f), buf, len);
+    }
+
+    /**
+     * @brief sends up to `len` bytes
+     */
+    template <typename F>
+    requires tcx::completion_handler<F, std::size_t>
+    auto async_write_some(void const *buf, std::size_t len, F &&f)
+    {
+        return tcx::impl::wrap_op<tcx::impl::tcp_write_some_operation>::call(*m_executor, *this, std::forward<F>(f), buf, len);
+    }
+
+    /**
+     * @brief sends all of the `len` bytes, as many sends as needed
+     */
+    template <typename F>
+    requires tcx::completion_handler<F, std::size_t>
+    auto async_write(void const *buf, std::size_t len, F &&f)
+    {
+        return tcx::impl::wrap_op<tcx::impl::tcp_write_operation>::call(*m_executor, *this, std::forward<F>(f), buf, len);
+    }
+
+private:
+    friend struct impl::tcp_connect_operation;
+
+    E *m_executor;
+    Service *m_service;
+    impl::socket_handle m_handle;
+    endpoint m_remote;
+};
+
+/**
+ * @brief A listening TCP socket driven by `Service`, that accepts `tcx::tcp_socket`s
+ *
+ * Like `tcx::tcp_socket`, the socket is closed when destroyed and the accepts in flight are cancelled.
+ */
+template <typename E, typename Service>
+class tcp_acceptor {
+    using backend = impl::tcp_backend<Service>;
+
+public:
+    tcp_acceptor(E &executor, Service &service) noexcept
+        : m_executor(&executor)
+        , m_service(&service)
+    {
+    }
+
+    tcp_acceptor(tcp_acceptor &&other) noexcept
+        : m_executor(other.m_executor)
+        , m_service(other.m_service)
+        , m_handle(std::exchange(other.m_handle, impl::socket_handle {}))
+        , m_direct(other.m_direct)
+    {
+    }
+
+    tcp_acceptor &operator=(tcp_acceptor &&other) noexcept
+    {
+        if (this != &other) {
+            close();
+            m_executor = other.m_executor;
+            m_service = other.m_service;
+            m_handle = std::exchange(other.m_handle, impl::socket_handle {});
+            m_direct = other.m_direct;
+        }
+        return *this;
+    }
+
+    ~tcp_acceptor()
+    {
+        close();
+    }
+
+    [[nodiscard]] E &executor() const noexcept
+    {
+        return *m_executor;
+    }
+
+    [[nodiscard]] Service &service() const noexcept
+    {
+        return *m_service;
+    }
+
+    [[nodiscard]] bool is_open() const noexcept
+    {
+        return m_handle.is_open();
+    }
+
+    [[nodiscard]] tcx::native::handle_type native_handle() const noexcept
+    {
+        return m_handle.value;
+    }
+
+    /**
+     * @brief opens a socket bound to `local`, with `SO_REUSEADDR`, and listens on it
+     */
+    std::error_code listen(endpoint const &local, int backlog = SOMAXCONN) noexcept
+    {
+        close();
+        int const fd = ::socket(local.family(), SOCK_STREAM | SOCK_CLOEXEC | backend::socket_flags, 0);
+        if (fd < 0)
+            return std::error_code(errno, std::system_category());
+        int const enabled = 1;
+        if (::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled)) < 0 || ::bind(fd, local.data(), local.size()) < 0 || ::listen(fd, backlog) < 0) {
+            int const error = errno;
+            ::close(fd);
+            return std::error_code(error, std::system_category());
+        }
+        m_handle = impl::socket_handle { fd, false };
+        return {};
+    }
+
+    /**
+     * @brief the address the socket is bound to, with the port the system picked if it was bound to port 0
+     */
+    [[nodiscard]] endpoint local_endpoint() const noexcept
+    {
+        endpoint local;
+        socklen_t size = endpoint::capacity();
+        if (::getsockname(m_handle.value, local.data(), &size) == 0)
+            local.resize(size);
+        return local;
+    }
+
+    /**
+     * @brief accept connections as direct descriptors, only supported by `tcx::uring_context` services
+     */
+    void set_direct(bool direct) noexcept
+    {
+        m_direct = direct;
+    }
+
+    void close() noexcept
+    {
+        if (m_handle.is_open())
+            backend::close(*m_service, std::exchange(m_handle, impl::socket_handle {}));
+    }
+
+    /**
+     * @brief accepts a connection, posted to `executor` as a socket that posts to it too
+     */
+    template <typename F>
+    requires tcx::completion_handler<F, tcx::tcp_socket<E, Service>>
+    auto async_accept(F &&f)
+    {
+        return tcx::impl::wrap_op<tcx::impl::tcp_accept_operation<E, Service>>::call(*m_executor, *this, std::forward<F>(f));
+    }
+
+private:
+    friend struct impl::tcp_accept_operation<E, Service>;
+
+    E *m_executor;
+    Service *m_service;
+    impl::socket_handle m_handle;
+    bool m_direct = false;
+};
+
+namespace impl {
+
+    template <typename E, typename Service>
+    struct tcp_open_operation {
+        using result_type = tcx::tcp_socket<E, Service>;
+
+        template <typename F>
+        static void call(E &executor, Service &service, int family, bool direct, F &&f)
+        {
+            using backend = tcp_backend<Service>;
+            auto operation = std::make_shared<tcp_operation<E, result_type, std::remove_cvref_t<F>>>(executor, std::forward<F>(f));
+            if constexpr (backend::supports_direct) {
+                if (direct) {
+                    int const error = backend::open_direct(service, family, [operation, &executor, &service](int result, std::uint64_t id) {
+                        if (result < 0)
+                            return operation->fail(id, result);
+                        operation->succeed(id, executor, service, socket_handle { result, true });
+                    });
+                    if (error < 0)
+                        operation->fail(0, error);
+                    return;
+                }
+            }
+
+            int const fd = ::socket(family, SOCK_STREAM | SOCK_CLOEXEC | backend::socket_flags, 0);
+            if (fd < 0)
+                return operation->fail(0, std::error_code(errno, std::system_category()));
+            operation->succeed(0, executor, service, socket_handle { fd, false });
+        }
+    };
+
+    struct tcp_connect_operation {
+        using result_type = void;
+
+        template <typename E, typename Service, typename F>
+        static void call(E &executor, tcx::tcp_socket<E, Service> &socket, endpoint const &remote, F &&f)
+        {
+            using backend = tcp_backend<Service>;
+            auto operation = std::make_shared<tcp_operation<E, void, std::remove_cvref_t<F>>>(executor, std::forward<F>(f));
+            socket.m_remote = remote;
+            if (!socket.is_open()) {
+                int const fd = ::socket(remote.family(), SOCK_STREAM | SOCK_CLOEXEC | backend::socket_flags, 0);
+                if (fd < 0)
+                    return operation->fail(0, std::error_code(errno, std::system_category()));
+                socket.m_handle = socket_handle { fd, false };
+            }
+
+            // the address is kept alive with the operation, it isn't read until the submission reaches the kernel
+            auto address = std::make_unique<endpoint>(remote);
+            auto const &target = *address;
+            int const error = backend::connect(socket.service(), socket.handle(), target, [operation, address = std::move(address)](int result, std::uint64_t id) {
+                if (result < 0)
+                    return operation->fail(id, result);
+                operation->succeed(id);
+            });
+            if (error < 0)
+                operation->fail(0, error);
+        }
+    };
+
+    struct tcp_read_some_operation {
+        using result_type = std::size_t;
+
+        template <typename E, typename Service, typename F>
+        static void call(E &executor, tcx::tcp_socket<E, Service> &socket, void *buf, std::size_t len, F &&f)
+        {
+            auto operation = std::make_shared<tcp_operation<E, std::size_t, std::remove_cvref_t<F>>>(executor, std::forward<F>(f));
+            int const error = tcp_backend<Service>::receive(socket.service(), socket.handle(), buf, len, [operation](int result, std::uint64_t id) {
+                if (result < 0)
+                    return operation->fail(id, result);
+                operation->succeed(id, static_cast<std::size_t>(result));
+            });
+            if (error < 0)
+                operation->fail(0, error);
+        }
+    };
+
+    struct tcp_write_some_operation {
+        using result_type = std::size_t;
+
+        template <typename E, typename Service, typename F>
+        static void call(E &executor, tcx::tcp_socket<E, Service> &socket, void const *buf, std::size_t len, F &&f)
+        {
+            auto operation = std::make_shared<tcp_operation<E, std::size_t, std::remove_cvref_t<F>>>(executor, std::forward<F>(f));
+            int const error = tcp_backend<Service>::send(socket.service(), socket.handle(), buf, len, [operation](int result, std::uint64_t id) {
+                if (result < 0)
+                    return operation->fail(id, result);
+                operation->succeed(id, static_cast<std::size_t>(result));
+            });
+            if (error < 0)
+                operation->fail(0, error);
+        }
+    };
+
+    struct tcp_write_operation {
+        using result_type = std::size_t;
+
+        template <typename E, typename Service, typename F>
+        static void call(E &executor, tcx::tcp_socket<E, Service> &socket, void const *buf, std::size_t len, F &&f)
+        {
+            using operation_type = tcp_operation<E, std::size_t, std::remove_cvref_t<F>>;
+
+            struct state {
+                std::shared_ptr<operation_type> operation;
+                Service &service;
+                socket_handle handle;
+                std::byte const *data;
+                std::size_t size;
+                std::size_t sent = 0;
+
+                static void next(std::shared_ptr<state> self, std::uint64_t id)
+                {
+                    if (self->sent == self->size)
+                        return self->operation->succeed(id, self->sent);
+                    auto *const raw = self.get();
+                    int const error = tcp_backend<Service>::send(raw->service, raw->handle, raw->data + raw->sent, raw->size - raw->sent, [self = std::move(self)](int result, std::uint64_t id) mutable {
+                        if (result < 0)
+                            return self->operation->fail(id, result);
+                        self->sent += static_cast<std::size_t>(result);
+                        next(std::move(self), id);
+                    });
+                    if (error < 0)
+                        raw->operation->fail(id, error);
+                }
+            };
+
+            auto operation = std::make_shared<operation_type>(executor, std::forward<F>(f));
+            state::next(std::make_shared<state>(state { std::move(operation), socket.service(), socket.handle(), static_cast<std::byte const *>(buf), len }), 0);
+        }
+    };
+
+    template <typename E, typename Service>
+    struct tcp_accept_operation {
+        using result_type = tcx::tcp_socket<E, Service>;
+
+        template <typename F>
+        static void call(E &executor, tcx::tcp_acceptor<E, Service> &acceptor, F &&f)
+        {
+            using backend = tcp_backend<Service>;
+            auto operation = std::make_shared<tcp_operation<E, result_type, std::remove_cvref_t<F>>>(executor, std::forward<F>(f));
+
+            struct peer_address {
+                endpoint address;
+                socklen_t size = endpoint::capacity();
+            };
+            auto peer = std::make_unique<peer_address>();
+            auto *const raw = peer.get();
+            bool const direct = acceptor.m_direct && backend::supports_direct;
+            int const error = backend::accept(acceptor.service(), acceptor.m_handle, direct, raw->address.data(), &raw->size,
+                [operation, peer = std::move(peer), direct, &executor, &service = acceptor.service()](int result, std::uint64_t id) mutable {
+                    if (result < 0)
+                        return operation->fail(id, result);
+                    peer->address.resize(peer->size);
+                    operation->succeed(id, executor, service, socket_handle { result, direct }, peer->address);
+                });
+            if (error < 0)
+                operation->fail(0, error);
+        }
+    };
+
+} // namespace impl
+
+} // namespace tcx
+
+#endif
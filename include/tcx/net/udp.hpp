@@ -0,0 +1,509 @@
+#ifndef TCX_NET_UDP_HPP
+#define TCX_NET_UDP_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <tcx/native/handle.hpp>
+#include <tcx/net/endpoint.hpp>
+#include <tcx/services/buffer_ring.hpp>
+#include <tcx/services/uring_service.hpp>
+#include <tcx/unique_function.hpp>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+namespace tcx {
+
+/**
+ * @brief Tuning of `tcx::udp_socket`
+ */
+struct udp_options {
+    /** @brief let the kernel coalesce the datagrams of a flow with `UDP_GRO`, they are still handed out one by one */
+    bool gro = true;
+    /** @brief send runs of datagrams as one `UDP_SEGMENT` super datagram, when the kernel supports it */
+    bool gso = true;
+    /** @brief most datagrams in a single send, the kernel doesn't take more than 64 */
+    unsigned max_segments = 64;
+};
+
+/**
+ * @brief A datagram received by `tcx::udp_socket`, only valid for the duration of the handler
+ */
+struct udp_datagram {
+    endpoint from;
+    std::span<std::byte const> payload;
+    /** @brief the datagram didn't fit in the provided buffer, and `payload` is only it's beginning */
+    bool truncated = false;
+};
+
+namespace impl {
+
+    template <typename Service>
+    struct udp_receive_state {
+        using handler_type = tcx::unique_function<void(std::variant<std::error_code, udp_datagram>)>;
+
+        // room for the name in the buffer, rounded up so the control data after it is aligned
+        constexpr static socklen_t name_size = (sizeof(sockaddr_in6) + alignof(cmsghdr) - 1) & ~(alignof(cmsghdr) - 1);
+
+        Service &service;
+        tcx::native::handle_type socket;
+        buffer_ring &buffers;
+        handler_type handler;
+        msghdr header {};
+        typename Service::operation_t operation {};
+        bool stopped = false;
+
+        udp_receive_state(Service &service, tcx::native::handle_type socket, buffer_ring &buffers, handler_type handler)
+            : service(service)
+            , socket(socket)
+            , buffers(buffers)
+            , handler(std::move(handler))
+        {
+            // only the lengths are used, the kernel writes the name and control data in the provided buffer
+            header.msg_namelen = name_size;
+            header.msg_controllen = CMSG_SPACE(sizeof(int));
+        }
+
+        static void arm(std::shared_ptr<udp_receive_state> const &self)
+        {
+            auto const result = self->service.async_recvmsg_multishot(self->socket, &self->header, 0, self->buffers.group(), [self](Service &, io_uring_cqe const *cqe) {
+                self->complete(self, cqe);
+            });
+            if (result.has_error())
+                self->finish(std::error_code(static_cast<int>(result.error()), std::system_category()));
+            else
+                self->operation = result.value();
+        }
+
+        void complete(std::shared_ptr<udp_receive_state> const &self, io_uring_cqe const *cqe)
+        {
+            if (buffer_ring::has_buffer(cqe)) {
+                auto const id = buffer_ring::buffer_id(cqe);
+                if (cqe->res > 0 && !stopped)
+                    deliver(buffers.buffer(id), cqe->res);
+                buffers.recycle(id);
+            }
+            if (cqe->flags & IORING_CQE_F_MORE)
+                return;
+
+            // it ends when the buffers run out, or for no reason at all, only stopping or failing for good is reported
+            if (stopped)
+                return finish(std::make_error_code(std::errc::operation_canceled));
+            if (cqe->res >= 0 || cqe->res == -ENOBUFS)
+                return arm(self);
+            finish(std::error_code(-cqe->res, std::system_category()));
+        }
+
+        void deliver(std::byte *buffer, int size)
+        {
+            auto *const out = io_uring_recvmsg_validate(buffer, size, &header);
+            if (out == nullptr)
+                return;
+
+            auto const *const name = static_cast<sockaddr const *>(io_uring_recvmsg_name(out));
+            auto const *const payload = static_cast<std::byte const *>(io_uring_recvmsg_payload(out, &header));
+            std::size_t const length = io_uring_recvmsg_payload_length(out, size, &header);
+
+            // with GRO, the payload is the datagrams of the same flow back to back, all of the segment size but the last
+            std::size_t segment = length;
+            for (auto *cmsg = io_uring_recvmsg_cmsg_firsthdr(out, &header); cmsg != nullptr; cmsg = io_uring_recvmsg_cmsg_nexthdr(out, &header, cmsg)) {
+                if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                    int value;
+                    std::memcpy(&value, CMSG_DATA(cmsg), sizeof(value));
+                    if (value > 0)
+                        segment = static_cast<std::size_t>(value);
+                }
+            }
+
+            udp_datagram datagram { endpoint(name, std::min<socklen_t>(out->namelen, header.msg_namelen)), {}, (out->flags & MSG_TRUNC) != 0 };
+            for (std::size_t offset = 0; offset < length && !stopped; offset += segment) {
+                datagram.payload = { payload + offset, std::min(segment, length - offset) };
+                handler(std::variant<std::error_code, udp_datagram>(std::in_place_index<1>, datagram));
+            }
+            if (length == 0 && !stopped)
+                handler(std::variant<std::error_code, udp_datagram>(std::in_place_index<1>, datagram));
+        }
+
+        void finish(std::error_code error)
+        {
+            stopped = true;
+            if (handler)
+                std::exchange(handler, nullptr)(std::variant<std::error_code, udp_datagram>(std::in_place_index<0>, error));
+        }
+    };
+
+    template <typename Service>
+    struct udp_send_state {
+        using callback_type = tcx::unique_function<void(std::error_code, std::size_t)>;
+
+        // a run of datagrams of the same size, but maybe the last, to the same destination
+        struct group {
+            endpoint to;
+            std::size_t offset = 0;
+            std::size_t length = 0;
+            std::size_t segment_size = 0;
+            unsigned segments = 0;
+        };
+
+        struct message {
+            msghdr header {};
+            iovec iov {};
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(std::uint16_t))] {};
+        };
+
+        std::vector<std::byte> data;
+        std::vector<group> groups;
+        std::deque<message> messages;
+        callback_type callback;
+        std::size_t in_flight = 0;
+        std::size_t sent = 0;
+        std::error_code error;
+
+        message &prepare(group const &target, std::size_t offset, std::size_t length, std::size_t segment_size)
+        {
+            auto &added = messages.emplace_back();
+            added.iov = { data.data() + offset, length };
+            added.header.msg_name = const_cast<sockaddr *>(target.to.data());
+            added.header.msg_namelen = target.to.size();
+            added.header.msg_iov = &added.iov;
+            added.header.msg_iovlen = 1;
+            if (segment_size != 0) {
+                added.header.msg_control = added.control;
+                added.header.msg_controllen = sizeof(added.control);
+                auto *const cmsg = CMSG_FIRSTHDR(&added.header);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+                auto const size = static_cast<std::uint16_t>(segment_size);
+                std::memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+            }
+            return added;
+        }
+
+        void send(std::shared_ptr<udp_send_state> const &self, Service &service, tcx::native::handle_type socket, std::size_t index, message &sending, unsigned segments)
+        {
+            ++in_flight;
+            auto const result = service.async_sendmsg(socket, &sending.header, MSG_NOSIGNAL, [self, &service, socket, index, segments](Service &, io_uring_cqe const *cqe) {
+                self->sent_one(self, service, socket, index, segments, cqe->res);
+            });
+            if (result.has_error()) {
+                --in_flight;
+                if (!error)
+                    error = std::error_code(static_cast<int>(result.error()), std::system_category());
+            }
+        }
+
+        void sent_one(std::shared_ptr<udp_send_state> const &self, Service &service, tcx::native::handle_type socket, std::size_t index, unsigned segments, int result)
+        {
+            if (result == -EIO && segments > 1) {
+                // the device can't segment it, send them one by one instead
+                auto const &failed = groups[index];
+                for (std::size_t offset = 0; offset < failed.length; offset += failed.segment_size)
+                    send(self, service, socket, index, prepare(failed, failed.offset + offset, std::min(failed.segment_size, failed.length - offset), 0), 1);
+            } else if (result < 0) {
+                if (!error)
+                    error = std::error_code(-result, std::system_category());
+            } else {
+                sent += segments;
+            }
+            if (--in_flight == 0)
+                std::exchange(callback, nullptr)(error, sent);
+        }
+    };
+
+} // namespace impl
+
+/**
+ * @brief A UDP socket driven by a `tcx::uring_context`, made for many small datagrams
+ *
+ * Receiving is a single multishot `recvmsg()` that picks buffers from a `tcx::buffer_ring`, so a stream of datagrams
+ * costs one completion each and no submission at all. With `UDP_GRO`, the kernel coalesces the datagrams of a flow,
+ * and a single completion carries many of them.
+ *
+ * Sending queues datagrams and flushes them together, runs of datagrams to the same destination and of the same size
+ * (the last one can be smaller) are sent as a single `UDP_SEGMENT` super datagram, that the kernel or the device splits.
+ * Datagrams must fit the path MTU for that, as they would have to anyway.
+ *
+ * The socket is used from one thread, the handlers are invoked by the thread running the completions of the ring.
+ */
+template <tcx::uring_context Service>
+class udp_socket {
+public:
+    using receive_handler = typename impl::udp_receive_state<Service>::handler_type;
+
+    /**
+     * @brief bytes of every provided buffer used by the kernel besides the payload
+     */
+    constexpr static std::size_t receive_overhead = sizeof(io_uring_recvmsg_out) + impl::udp_receive_state<Service>::name_size + CMSG_SPACE(sizeof(int));
+
+    /**
+     * @brief largest payload of a datagram, and of a super datagram
+     */
+    constexpr static std::size_t max_payload = 65507;
+
+    explicit udp_socket(Service &service, udp_options options = {}) noexcept
+        : m_service(&service)
+        , m_options(options)
+    {
+        m_options.max_segments = std::clamp(m_options.max_segments, 1u, 64u);
+    }
+
+    /**
+     * @brief adopts `socket`, an open UDP socket, setting it up as `open()` would
+     */
+    udp_socket(Service &service, tcx::native::handle_type socket, udp_options options = {}) noexcept
+        : udp_socket(service, options)
+    {
+        m_socket = socket;
+        set_up();
+    }
+
+    udp_socket(udp_socket &&other) noexcept
+        : m_service(other.m_service)
+        , m_options(other.m_options)
+        , m_socket(std::exchange(other.m_socket, tcx::native::invalid_handle))
+        , m_gso(other.m_gso)
+        , m_receive(std::move(other.m_receive))
+        , m_batch(std::move(other.m_batch))
+    {
+    }
+
+    udp_socket &operator=(udp_socket &&other) noexcept
+    {
+        if (this != &other) {
+            close();
+            m_service = other.m_service;
+            m_options = other.m_options;
+            m_socket = std::exchange(other.m_socket, tcx::native::invalid_handle);
+            m_gso = other.m_gso;
+            m_receive = std::move(other.m_receive);
+            m_batch = std::move(other.m_batch);
+        }
+        return *this;
+    }
+
+    ~udp_socket()
+    {
+        close();
+    }
+
+    [[nodiscard]] tcx::native::handle_type native_handle() const noexcept
+    {
+        return m_socket;
+    }
+
+    [[nodiscard]] bool is_open() const noexcept
+    {
+        return m_socket != tcx::native::invalid_handle;
+    }
+
+    /**
+     * @brief true if runs of datagrams are sent as a single super datagram
+     */
+    [[nodiscard]] bool gso() const noexcept
+    {
+        return m_gso;
+    }
+
+    /**
+     * @brief opens a socket of `family`, only to send from
+     */
+    std::error_code open(int family = AF_INET) noexcept
+    {
+        close();
+        int const fd = ::socket(family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return std::error_code(errno, std::system_category());
+        m_socket = fd;
+        set_up();
+        return {};
+    }
+
+    /**
+     * @brief opens a socket bound to `local`
+     */
+    std::error_code bind(endpoint const &local) noexcept
+    {
+        if (auto const error = open(local.family()))
+            return error;
+        if (::bind(m_socket, local.data(), local.size()) < 0) {
+            int const error = errno;
+            close();
+            return std::error_code(error, std::system_category());
+        }
+        return {};
+    }
+
+    /**
+     * @brief the address the socket is bound to, with the port the system picked if it was bound to port 0
+     */
+    [[nodiscard]] endpoint local_endpoint() const noexcept
+    {
+        endpoint local;
+        socklen_t size = endpoint::capacity();
+        if (::getsockname(m_socket, local.data(), &size) == 0)
+            local.resize(size);
+        return local;
+    }
+
+    /**
+     * @brief invokes `handler` with every datagram received into `buffers` until `stop_receiving()` or an error
+     *
+     * The buffers should hold `receive_overhead` bytes more than the biggest datagram expected, or 64KiB more with GRO,
+     * and their size should be a multiple of 8 to keep the control data in them aligned.
+     * The handler is invoked with the last error once receiving stops, `ECANCELED` if it was stopped,
+     * and `buffers` must outlive the receiving until then.
+     */
+    template <typename F>
+    requires std::invocable<F &, std::variant<std::error_code, udp_datagram>>
+    native::result<void> start_receiving(buffer_ring &buffers, F &&handler)
+    {
+        if (!is_open())
+            return native::result<void>::from_error(EBADF);
+        if (m_receive && !m_receive->stopped)
+            return native::result<void>::from_error(EALREADY);
+        m_receive = std::make_shared<impl::udp_receive_state<Service>>(*m_service, m_socket, buffers, receive_handler(std::forward<F>(handler)));
+        impl::udp_receive_state<Service>::arm(m_receive);
+        if (m_receive->stopped)
+            return native::result<void>::from_error(EAGAIN);
+        return {};
+    }
+
+    void stop_receiving() noexcept
+    {
+        if (!m_receive || m_receive->stopped)
+            return;
+        m_receive->stopped = true;
+        (void)m_service->async_cancel(m_receive->operation, 0, [](Service &, io_uring_cqe const *) {});
+    }
+
+    /**
+     * @brief copies a datagram to `to` into the batch sent by the next `flush()`
+     * @return false if it's bigger than `max_payload`
+     */
+    bool queue(endpoint const &to, void const *data, std::size_t size)
+    {
+        if (size > max_payload)
+            return false;
+        if (!m_batch)
+            m_batch = std::make_shared<impl::udp_send_state<Service>>();
+
+        auto &batch = *m_batch;
+        auto *const last = batch.groups.empty() ? nullptr : &batch.groups.back();
+        // a run ends with a smaller datagram, and can't be longer than the biggest datagram
+        bool const extends = m_gso && last != nullptr && last->segments < m_options.max_segments
+            && last->length == last->segment_size * last->segments && size <= last->segment_size && size != 0
+            && last->length + size <= max_payload && last->to == to;
+        if (extends) {
+            last->length += size;
+            ++last->segments;
+        } else {
+            batch.groups.push_back({ to, batch.data.size(), size, size, 1 });
+        }
+        auto const *const bytes = static_cast<std::byte const *>(data);
+        batch.data.insert(batch.data.end(), bytes, bytes + size);
+        return true;
+    }
+
+    /**
+     * @brief the number of datagrams queued since the last `flush()`
+     */
+    [[nodiscard]] std::size_t queued() const noexcept
+    {
+        std::size_t count = 0;
+        if (m_batch) {
+            for (auto const &group : m_batch->groups)
+                count += group.segments;
+        }
+        return count;
+    }
+
+    /**
+     * @brief sends the queued datagrams, `f` is invoked once all of them are sent with the first error and how many were sent
+     *
+     * Another batch can be queued and flushed while this one is in flight.
+     */
+    template <typename F>
+    requires std::invocable<F &, std::error_code, std::size_t>
+    void flush(F &&f)
+    {
+        auto batch = std::move(m_batch);
+        if (!batch || batch->groups.empty())
+            return f(std::error_code(), 0);
+
+        batch->callback = typename impl::udp_send_state<Service>::callback_type(std::forward<F>(f));
+        // keeps every completion from finishing the batch before all of it is submitted
+        ++batch->in_flight;
+        for (std::size_t i = 0; i < batch->groups.size(); ++i) {
+            auto const &group = batch->groups[i];
+            auto &message = batch->prepare(group, group.offset, group.length, group.segments > 1 ? group.segment_size : 0);
+            batch->send(batch, *m_service, m_socket, i, message, group.segments);
+        }
+        batch->sent_one(batch, *m_service, m_socket, 0, 0, 0);
+    }
+
+    /**
+     * @brief stops receiving and closes the socket once every operation on it is cancelled
+     */
+    void close() noexcept
+    {
+        if (!is_open())
+            return;
+        stop_receiving();
+        m_receive.reset();
+        m_batch.reset();
+        int const fd = std::exchange(m_socket, tcx::native::invalid_handle);
+        // the number can't be reused while operations on it are in flight
+        auto const result = m_service->async_cancel_fd(fd, IORING_ASYNC_CANCEL_ALL, [fd](Service &service, io_uring_cqe const *) {
+            if (service.async_close(fd, [](Service &, io_uring_cqe const *) {}).has_error())
+                ::close(fd);
+        });
+        if (result.has_error())
+            ::close(fd);
+    }
+
+private:
+    void set_up() noexcept
+    {
+        // setting it to zero changes nothing, it only fails if the kernel doesn't know about it
+        int const disabled = 0;
+        m_gso = m_options.gso && ::setsockopt(m_socket, SOL_UDP, UDP_SEGMENT, &disabled, sizeof(disabled)) == 0;
+        if (m_options.gro) {
+            int const enabled = 1;
+            (void)::setsockopt(m_socket, SOL_UDP, UDP_GRO, &enabled, sizeof(enabled)); // the datagrams come one by one without it
+        }
+    }
+
+    Service *m_service;
+    udp_options m_options;
+    tcx::native::handle_type m_socket = tcx::native::invalid_handle;
+    bool m_gso = false;
+    std::shared_ptr<impl::udp_receive_state<Service>> m_receive;
+    std::shared_ptr<impl::udp_send_state<Service>> m_batch;
+};
+
+} // namespace tcx
+
+#endif
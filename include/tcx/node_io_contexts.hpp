@@ -0,0 +1,88 @@
+#ifndef TCX_NODE_IO_CONTEXTS_HPP
+#define TCX_NODE_IO_CONTEXTS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <liburing.h>
+
+#include <tcx/affinity.hpp>
+#include <tcx/io_context.hpp>
+
+namespace tcx {
+
+/**
+ * @brief one `tcx::io_context` per NUMA node, each run by a thread restricted to the CPUs of it's node
+ *
+ * The nodes and their CPUs are those of `tcx::numa_nodes()`, limited to what the constructing thread may run on.
+ *
+ * Each thread creates it's ring itself after being pinned and preferring it's node's memory,
+ * so the ring, the queue of handlers and whatever the handlers allocate stay on that node,
+ * and the ring's io-wq workers are restricted to the same CPUs.
+ * A connection accepted next to a NIC can be handed to the context of the NIC's node, and it's completions run there.
+ * ```cpp
+ * tcx::node_io_contexts contexts(256);
+ * auto &context = contexts.nearest();
+ * tcx::async_recv(context, context.service(), fd, buffer, size, handler);
+ * ```
+ */
+class node_io_contexts {
+public:
+    /**
+     * @param params used to create every ring, an `IORING_SETUP_SQPOLL` ring gets it's submission thread pinned to the first CPU of it's node the calling thread may run on
+     * @throws std::system_error if a ring or it's thread can't be set up
+     */
+    explicit node_io_contexts(std::uint32_t entries, io_uring_params const &params = {});
+
+    node_io_contexts(node_io_contexts const &) = delete;
+    node_io_contexts(node_io_contexts &&) = delete;
+
+    node_io_contexts &operator=(node_io_contexts const &) = delete;
+    node_io_contexts &operator=(node_io_contexts &&) = delete;
+
+    /**
+     * @brief stops the contexts and waits for their threads
+     */
+    ~node_io_contexts();
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return m_nodes.size();
+    }
+
+    [[nodiscard]] tcx::io_context &operator[](std::size_t index) noexcept
+    {
+        return *m_nodes[index].context;
+    }
+
+    [[nodiscard]] tcx::numa_node const &node(std::size_t index) const noexcept
+    {
+        return m_nodes[index].node;
+    }
+
+    /**
+     * @brief the context of the node the calling thread is running on
+     */
+    [[nodiscard]] tcx::io_context &nearest() noexcept;
+
+    /**
+     * @brief makes every context return from `run()`, it's threads exit
+     */
+    void stop() noexcept;
+
+private:
+    struct per_node {
+        tcx::numa_node node;
+        std::unique_ptr<tcx::io_context> context;
+        std::thread thread;
+    };
+
+    std::vector<per_node> m_nodes;
+};
+
+} // namespace tcx
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef TCX_PIPE_POOL_HPP
+#define TCX_PIPE_POOL_HPP
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include <tcx/native/handle.hpp>
+#include <tcx/native/result.hpp>
+
+namespace tcx {
+
+/**
+ * @brief Pipes kept open to be reused as the intermediate buffer of `splice()`
+ *
+ * Can be used from any thread.
+ */
+class pipe_pool {
+public:
+    struct pipe {
+        tcx::native::handle_type read = tcx::native::invalid_handle;
+        tcx::native::handle_type write = tcx::native::invalid_handle;
+        /** @brief number of bytes the pipe can hold */
+        std::size_t capacity = 0;
+    };
+
+    /**
+     * @param pipe_size size requested for new pipes with `F_SETPIPE_SZ`, 0 keeps the default of the system
+     * @param max_idle maximum number of pipes kept open while unused
+     */
+    explicit pipe_pool(std::size_t pipe_size = 0, std::size_t max_idle = 64) noexcept
+        : m_pipe_size(pipe_size)
+        , m_max_idle(max_idle)
+    {
+    }
+
+    pipe_pool(pipe_pool const &) = delete;
+    pipe_pool &operator=(pipe_pool const &) = delete;
+
+    ~pipe_pool();
+
+    /**
+     * @brief takes an idle pipe, or creates a new one
+     */
+    native::result<pipe> acquire() noexcept;
+
+    /**
+     * @brief gives back a pipe taken with `acquire()`
+     *
+     * @param empty whether the pipe was drained, pipes with data left in them are closed instead of reused
+     */
+    void release(pipe released, bool empty) noexcept;
+
+    /**
+     * @brief pool used when no other is given
+     */
+    static pipe_pool &shared() noexcept;
+
+private:
+    static void close(pipe &closed) noexcept;
+
+    std::size_t m_pipe_size;
+    std::size_t m_max_idle;
+    std::mutex m_mutex;
+    std::vector<pipe> m_idle;
+};
+
+} // namespace tcx
+
+#endif
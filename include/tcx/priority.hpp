@@ -0,0 +1,45 @@
+#ifndef TCX_PRIORITY_HPP
+#define TCX_PRIORITY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace tcx {
+
+/**
+ * @brief the lane of an executor a handler is queued in, lower lanes run first
+ *
+ * Executors with fewer lanes queue the handlers of the lanes they don't have in their last one,
+ * executors without lanes ignore it.
+ */
+using priority = std::uint8_t;
+
+inline constexpr priority high_priority = 0;
+inline constexpr priority normal_priority = 1;
+inline constexpr priority low_priority = 2;
+
+/**
+ * @brief handlers run from higher lanes while a lower lane has handlers waiting, before one of them runs anyway
+ */
+inline constexpr std::size_t default_aging_limit = 64;
+
+namespace impl {
+
+    /**
+     * @brief posts `f` to the lane `priority` of `executor`, or just posts it if the executor doesn't have lanes
+     */
+    template <typename E, typename F>
+    decltype(auto) post(E &executor, tcx::priority priority, F &&f)
+    {
+        if constexpr (requires { executor.post(priority, std::forward<F>(f)); })
+            return executor.post(priority, std::forward<F>(f));
+        else
+            return executor.post(std::forward<F>(f));
+    }
+
+} // namespace impl
+
+} // namespace tcx
+
+#endif
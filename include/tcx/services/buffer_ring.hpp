@@ -0,0 +1,101 @@
+#ifndef TCX_SERVICES_BUFFER_RING_HPP
+#define TCX_SERVICES_BUFFER_RING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include <liburing.h>
+
+#include <tcx/native/result.hpp>
+#include <tcx/services/uring_service.hpp>
+
+namespace tcx {
+
+/**
+ * @brief Buffers provided to the kernel through a ring registered as a buffer group
+ *
+ * Operations submitted with `IOSQE_BUFFER_SELECT` and this group pick a buffer when there's data for them,
+ * instead of pinning one for as long as they are in flight, so a few buffers serve many sockets.
+ * The completion says which buffer was used, and it must be given back with `recycle()` once consumed.
+ *
+ * Buffers can be recycled from any thread.
+ */
+class buffer_ring {
+public:
+    /**
+     * @brief maps `count` buffers of `size` bytes and registers them with `ring` as the buffer group `group`
+     * @param count number of buffers, a power of two up to 32768
+     */
+    static native::result<buffer_ring> create(uring_context_storage &ring, std::uint16_t group, unsigned count, std::size_t size) noexcept;
+
+    buffer_ring(buffer_ring &&other) noexcept;
+    buffer_ring &operator=(buffer_ring &&other) noexcept;
+
+    buffer_ring(buffer_ring const &) = delete;
+    buffer_ring &operator=(buffer_ring const &) = delete;
+
+    /**
+     * @brief unregisters the group, operations still selecting from it fail with `ENOBUFS`
+     */
+    ~buffer_ring();
+
+    [[nodiscard]] std::uint16_t group() const noexcept
+    {
+        return m_group;
+    }
+
+    [[nodiscard]] unsigned count() const noexcept
+    {
+        return m_count;
+    }
+
+    [[nodiscard]] std::size_t buffer_size() const noexcept
+    {
+        return m_size;
+    }
+
+    [[nodiscard]] std::byte *buffer(std::uint16_t id) const noexcept
+    {
+        return m_buffers + static_cast<std::size_t>(id) * m_size;
+    }
+
+    /**
+     * @brief gives the buffer `id` back to the kernel
+     */
+    void recycle(std::uint16_t id) noexcept;
+
+    /**
+     * @brief true if the kernel picked a buffer for the completion `cqe`
+     */
+    [[nodiscard]] static bool has_buffer(io_uring_cqe const *cqe) noexcept
+    {
+        return cqe->flags & IORING_CQE_F_BUFFER;
+    }
+
+    /**
+     * @brief the id of the buffer picked for the completion `cqe`
+     */
+    [[nodiscard]] static std::uint16_t buffer_id(io_uring_cqe const *cqe) noexcept
+    {
+        return static_cast<std::uint16_t>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    }
+
+private:
+    buffer_ring() noexcept = default;
+
+    void release() noexcept;
+
+    uring_context_storage *m_ring = nullptr;
+    io_uring_buf_ring *m_entries = nullptr;
+    std::byte *m_buffers = nullptr;
+    unsigned m_count = 0;
+    std::size_t m_size = 0;
+    std::uint16_t m_group = 0;
+    std::unique_ptr<std::mutex> m_mutex;
+};
+
+} // namespace tcx
+
+#endif
@@ -0,0 +1,423 @@
+#ifndef TCX_SERVICES_BUFFERED_STREAM_HPP
+#define TCX_SERVICES_BUFFERED_STREAM_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <sys/uio.h>
+
+#include <tcx/native/handle.hpp>
+#include <tcx/services/uring_service.hpp>
+#include <tcx/unique_function.hpp>
+
+namespace tcx {
+
+/**
+ * @brief Tuning of `tcx::buffered_stream`
+ */
+struct buffered_stream_options {
+    /** @brief size of the read buffer, reads of at least half of it bypass the buffer when it's empty */
+    std::size_t read_buffer_size = 64 * 1024;
+    /** @brief keep a read in flight after serving a read from the buffer, so the next one finds the data already there */
+    bool read_ahead = true;
+    /** @brief most writes coalesced into a single `writev()` */
+    std::size_t max_write_batch = IOV_MAX;
+};
+
+namespace impl {
+
+    template <typename Service>
+    class buffered_stream_state : public std::enable_shared_from_this<buffered_stream_state<Service>> {
+        using callback_type = tcx::unique_function<void(std::error_code, std::size_t)>;
+
+        struct read_request {
+            std::byte *data;
+            std::size_t size;
+            std::size_t minimum;
+            std::size_t copied;
+            callback_type callback;
+        };
+
+        struct write_request {
+            std::byte const *data;
+            std::size_t size;
+            std::size_t remaining;
+            callback_type callback;
+        };
+
+        struct completed_write {
+            callback_type callback;
+            std::size_t size;
+        };
+
+    public:
+        buffered_stream_state(Service &service, tcx::native::handle_type fd, buffered_stream_options const &options)
+            : m_service(service)
+            , m_fd(fd)
+            , m_options(options)
+            , m_buffer(std::make_unique<std::byte[]>(options.read_buffer_size))
+        {
+        }
+
+        buffered_stream_state(buffered_stream_state const &) = delete;
+        buffered_stream_state &operator=(buffered_stream_state const &) = delete;
+
+        [[nodiscard]] tcx::native::handle_type native_handle() const noexcept
+        {
+            return m_fd;
+        }
+
+        [[nodiscard]] std::size_t available() const
+        {
+            std::lock_guard lock(m_mutex);
+            return m_end - m_begin;
+        }
+
+        void read(void *data, std::size_t size, std::size_t minimum, callback_type callback)
+        {
+            std::unique_lock lock(m_mutex);
+            if (m_read) {
+                lock.unlock();
+                return callback(std::make_error_code(std::errc::operation_in_progress), 0);
+            }
+            m_read.emplace(read_request { static_cast<std::byte *>(data), size, std::min(minimum, size), 0, std::move(callback) });
+            serve(lock);
+        }
+
+        template <typename E>
+        void write(E &executor, void const *data, std::size_t size, callback_type callback)
+        {
+            std::unique_lock lock(m_mutex);
+            if (m_write_error || size == 0) {
+                auto const error = m_write_error;
+                lock.unlock();
+                return callback(error, 0);
+            }
+            m_writes.push_back(write_request { static_cast<std::byte const *>(data), size, size, std::move(callback) });
+            if (m_writing || m_flush_scheduled)
+                return;
+            // flushing from the executor lets the writes made by the handlers that run before it join the batch
+            m_flush_scheduled = true;
+            lock.unlock();
+            executor.post([self = this->shared_from_this()]() {
+                std::unique_lock lock(self->m_mutex);
+                self->m_flush_scheduled = false;
+                self->start_write(lock);
+            });
+        }
+
+        // cancels the read in flight, writes in flight are left to complete
+        void close()
+        {
+            std::lock_guard lock(m_mutex);
+            m_closed = true;
+            if (m_filling)
+                (void)m_service.async_cancel(m_fill_operation, 0, [](Service &, io_uring_cqe const *) {});
+        }
+
+    private:
+        // all of the following are called with the lock held, the ones that take it unlock before returning
+
+        // copies what's buffered into the pending read, and completes it or refills the buffer
+        void serve(std::unique_lock<std::mutex> &lock)
+        {
+            if (!m_read) {
+                lock.unlock();
+                return;
+            }
+            auto &request = *m_read;
+            std::size_t const count = std::min(m_end - m_begin, request.size - request.copied);
+            if (count != 0) {
+                std::memcpy(request.data + request.copied, m_buffer.get() + m_begin, count);
+                request.copied += count;
+                m_begin += count;
+            }
+
+            bool const done = request.copied >= request.minimum || (m_begin == m_end && (m_eof || m_read_error));
+            if (!done) {
+                if (!m_filling)
+                    start_fill();
+                // the fill might have failed to submit
+                if (!m_read_error) {
+                    lock.unlock();
+                    return;
+                }
+            }
+
+            auto completed = std::move(*m_read);
+            m_read.reset();
+            std::error_code const error = completed.copied >= completed.minimum || !m_read_error ? std::error_code() : m_read_error;
+            if (!m_filling && m_options.read_ahead)
+                start_fill();
+            lock.unlock();
+            completed.callback(error, completed.copied);
+        }
+
+        void start_fill()
+        {
+            if (m_eof || m_read_error || m_closed)
+                return;
+
+            std::byte *target;
+            std::size_t size;
+            std::size_t const capacity = m_options.read_buffer_size;
+            if (m_begin == m_end) {
+                m_begin = m_end = 0;
+                std::size_t const remaining = m_read ? m_read->size - m_read->copied : 0;
+                m_bypass = remaining >= capacity / 2;
+            }
+            if (m_bypass) {
+                target = m_read->data + m_read->copied;
+                size = m_read->size - m_read->copied;
+            } else {
+                if (m_begin != 0 && capacity - m_end < capacity / 4) {
+                    std::memmove(m_buffer.get(), m_buffer.get() + m_begin, m_end - m_begin);
+                    m_end -= m_begin;
+                    m_begin = 0;
+                }
+                if (m_end == capacity)
+                    return;
+                target = m_buffer.get() + m_end;
+                size = capacity - m_end;
+            }
+
+            auto const submitted = m_service.async_read(m_fd, target, size, -1, [self = this->shared_from_this()](Service &, io_uring_cqe const *result) {
+                self->on_filled(result->res);
+            });
+            if (submitted.has_error()) {
+                m_read_error = std::error_code(submitted.error(), std::system_category());
+                return;
+            }
+            m_fill_operation = submitted.value();
+            m_filling = true;
+        }
+
+        void on_filled(int result)
+        {
+            std::unique_lock lock(m_mutex);
+            m_filling = false;
+            bool const bypass = std::exchange(m_bypass, false);
+            if (result == -EAGAIN && !m_closed) {
+                // non blocking descriptor without data, the fill is retried once it's readable
+                auto const submitted = m_service.async_poll_add(m_fd, POLLIN, [self = this->shared_from_this()](Service &, io_uring_cqe const *result) {
+                    std::unique_lock lock(self->m_mutex);
+                    self->m_filling = false;
+                    if (result->res < 0)
+                        self->m_read_error = std::error_code(-result->res, std::system_category());
+                    self->serve(lock);
+                });
+                if (submitted.has_value()) {
+                    m_fill_operation = submitted.value();
+                    m_filling = true;
+                    return;
+                }
+                result = -submitted.error();
+            }
+
+            if (result < 0)
+                m_read_error = std::error_code(-result, std::system_category());
+            else if (result == 0)
+                m_eof = true;
+            else if (bypass && m_read)
+                m_read->copied += static_cast<std::size_t>(result);
+            else
+                m_end += static_cast<std::size_t>(result);
+            serve(lock);
+        }
+
+        void start_write(std::unique_lock<std::mutex> &lock)
+        {
+            if (m_writing || m_writes.empty()) {
+                lock.unlock();
+                return;
+            }
+
+            std::size_t const count = std::min(m_writes.size(), m_options.max_write_batch);
+            m_iovecs.resize(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                auto const &request = m_writes[i];
+                m_iovecs[i].iov_base = const_cast<std::byte *>(request.data + (request.size - request.remaining));
+                m_iovecs[i].iov_len = request.remaining;
+            }
+
+            auto const submitted = m_service.async_writev(m_fd, m_iovecs.data(), count, -1, 0, [self = this->shared_from_this()](Service &, io_uring_cqe const *result) {
+                self->on_written(result->res);
+            });
+            if (submitted.has_error())
+                return fail_writes(lock, std::error_code(submitted.error(), std::system_category()));
+            m_writing = true;
+            lock.unlock();
+        }
+
+        void on_written(int result)
+        {
+            std::unique_lock lock(m_mutex);
+            m_writing = false;
+            if (result == -EAGAIN) {
+                // non blocking descriptor with a full buffer, the batch is retried once it's writable
+                auto const submitted = m_service.async_poll_add(m_fd, POLLOUT, [self = this->shared_from_this()](Service &, io_uring_cqe const *result) {
+                    std::unique_lock lock(self->m_mutex);
+                    self->m_writing = false;
+                    if (result->res < 0)
+                        return self->fail_writes(lock, std::error_code(-result->res, std::system_category()));
+                    self->start_write(lock);
+                });
+                if (submitted.has_error())
+                    return fail_writes(lock, std::error_code(submitted.error(), std::system_category()));
+                m_writing = true;
+                return;
+            }
+            if (result < 0)
+                return fail_writes(lock, std::error_code(-result, std::system_category()));
+
+            std::vector<completed_write> completed;
+            auto written = static_cast<std::size_t>(result);
+            while (!m_writes.empty() && m_writes.front().remaining <= written) {
+                written -= m_writes.front().remaining;
+                completed.push_back(completed_write { std::move(m_writes.front().callback), m_writes.front().size });
+                m_writes.pop_front();
+            }
+            if (!m_writes.empty())
+                m_writes.front().remaining -= written;
+
+            // whatever was written while this batch was in flight goes out as the next one
+            start_write(lock);
+            for (auto &write : completed)
+                write.callback(std::error_code(), write.size);
+        }
+
+        // the error is sticky, as the peer can't tell which of the queued writes made it
+        void fail_writes(std::unique_lock<std::mutex> &lock, std::error_code error)
+        {
+            m_write_error = error;
+            auto writes = std::move(m_writes);
+            m_writes.clear();
+            lock.unlock();
+            for (auto &write : writes)
+                write.callback(error, write.size - write.remaining);
+        }
+
+        Service &m_service;
+        tcx::native::handle_type m_fd;
+        buffered_stream_options m_options;
+        mutable std::mutex m_mutex;
+
+        std::unique_ptr<std::byte[]> m_buffer;
+        std::size_t m_begin = 0;
+        std::size_t m_end = 0;
+        std::optional<read_request> m_read;
+        uring_context_storage::operation_t m_fill_operation {};
+        bool m_filling = false;
+        bool m_bypass = false;
+        bool m_eof = false;
+        bool m_closed = false;
+        std::error_code m_read_error;
+
+        std::deque<write_request> m_writes;
+        std::vector<iovec> m_iovecs;
+        bool m_writing = false;
+        bool m_flush_scheduled = false;
+        std::error_code m_write_error;
+    };
+
+} // namespace impl
+
+/**
+ * @brief A byte stream over a descriptor that batches small reads and writes into few io_uring operations
+ *
+ * Reads are served from an internal buffer that is filled with reads of `read_buffer_size` bytes,
+ * and unless `read_ahead` is disabled the next fill is submitted as soon as a read completes,
+ * so a read that follows finds the data already buffered instead of waiting for a round trip through the ring.
+ * Reads of at least half of the buffer go straight into the caller's memory when nothing is buffered.
+ *
+ * Writes aren't copied, their buffers must stay valid until they complete.
+ * The first write made while no write is in flight posts a flush to the executor,
+ * every write made before that flush runs is sent with it in a single `writev()`,
+ * and every write made while it's in flight is sent with the next one.
+ * Writes complete in order, once all of their bytes were written.
+ *
+ * One read and any number of writes can be in flight at the same time.
+ * The stream doesn't own the descriptor, destroying it cancels the read in flight
+ * but the descriptor and `Service` must outlive the writes in flight.
+ * @see tcx::async_read_some(E &, tcx::buffered_stream<Service> &, void *, std::size_t, F &&)
+ * @see tcx::async_read(E &, tcx::buffered_stream<Service> &, void *, std::size_t, F &&)
+ * @see tcx::async_write(E &, tcx::buffered_stream<Service> &, void const *, std::size_t, F &&)
+ */
+template <typename Service>
+class buffered_stream {
+    using callback_type = tcx::unique_function<void(std::error_code, std::size_t)>;
+
+public:
+    buffered_stream(Service &service, tcx::native::handle_type fd, buffered_stream_options const &options = {})
+        : m_state(std::make_shared<impl::buffered_stream_state<Service>>(service, fd, options))
+    {
+    }
+
+    buffered_stream(buffered_stream &&) noexcept = default;
+    buffered_stream &operator=(buffered_stream &&other) noexcept
+    {
+        if (m_state)
+            m_state->close();
+        m_state = std::move(other.m_state);
+        return *this;
+    }
+
+    ~buffered_stream()
+    {
+        if (m_state)
+            m_state->close();
+    }
+
+    [[nodiscard]] tcx::native::handle_type native_handle() const noexcept
+    {
+        return m_state->native_handle();
+    }
+
+    /**
+     * @brief bytes that can be read without waiting
+     */
+    [[nodiscard]] std::size_t available() const
+    {
+        return m_state->available();
+    }
+
+    /**
+     * @brief reads at least `minimum` bytes and up to `size` into `data`, and invokes `callback` with the error and the bytes read
+     *
+     * Reaching the end of the stream completes the read without an error with the bytes read so far,
+     * possibly none. When enough bytes are buffered `callback` is invoked before returning.
+     */
+    template <typename F>
+    void read(void *data, std::size_t size, std::size_t minimum, F &&callback)
+    {
+        m_state->read(data, size, minimum, callback_type(std::forward<F>(callback)));
+    }
+
+    /**
+     * @brief queues `size` bytes at `data` to be written, and invokes `callback` with the error and the bytes written
+     *
+     * The batch the write joins is flushed from `executor`.
+     */
+    template <typename E, typename F>
+    void write(E &executor, void const *data, std::size_t size, F &&callback)
+    {
+        m_state->write(executor, data, size, callback_type(std::forward<F>(callback)));
+    }
+
+private:
+    std::shared_ptr<impl::buffered_stream_state<Service>> m_state;
+};
+
+} // namespace tcx
+
+#endif
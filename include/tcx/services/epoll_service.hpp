@@ -1,10 +1,13 @@
 #ifndef TCX_SERVICES_EPOLL_SERVICE_HPP
 #define TCX_SERVICES_EPOLL_SERVICE_HPP
 
+#include <atomic>
+#include <cerrno>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <system_error>
+#include <type_traits>
 #include <utility>
 
 #include <sys/epoll.h>
@@ -19,27 +22,20 @@
 namespace tcx {
 
 namespace impl {
-    struct ErasedDeleter {
 
-        ErasedDeleter() = default;
-
-        template <typename T>
-        ErasedDeleter(std::in_place_type_t<T>) noexcept
-            : pfn_deleter(
-                +[](void *ptr) {
-                    delete reinterpret_cast<T *>(ptr);
-                })
-
-        {
-        }
+    // type erased poll request, owned by `tcx::epoll_service` until it's invoked or removed
+    struct epoll_completion {
+        void (*pfn_invoke)(epoll_completion *self, std::int32_t events);
+        void (*pfn_delete)(epoll_completion *self) noexcept;
+    };
 
-        void operator()(void *ptr) const noexcept
+    struct epoll_completion_deleter {
+        void operator()(epoll_completion *ptr) const noexcept
         {
-            pfn_deleter(ptr);
+            ptr->pfn_delete(ptr);
         }
-
-        void (*pfn_deleter)(void *) = nullptr;
     };
+
 } // namespace impl
 
 /**
@@ -100,49 +96,75 @@ public:
     template <tcx::epoll_completion_handler F>
     void async_poll_add(int fd, std::uint32_t events, F &&f)
     {
-        struct Completion {
-            void (*pfn_invoke)(Completion *, int);
-            int fd;
-            F completion;
+        struct Completion : impl::epoll_completion {
+            std::remove_cvref_t<F> completion;
         };
 
-        epoll_event event {};
-        auto pf = std::make_unique<Completion>(
-            +[](Completion *self, int e) {
-                std::invoke(*reinterpret_cast<F *>(self->completion), e);
+        completion_pointer pf(new Completion {
+            {
+                +[](impl::epoll_completion *self, std::int32_t e) {
+                    std::invoke(static_cast<Completion *>(self)->completion, e);
+                },
+                +[](impl::epoll_completion *self) noexcept {
+                    delete static_cast<Completion *>(self);
+                },
             },
-            fd,
-            std::forward<F>(f));
-        event.data.ptr = pf.get();
+            std::forward<F>(f),
+        });
+
+        epoll_event event {};
+        event.data.fd = fd;
         event.events = events | EPOLLONESHOT;
-        if (epoll_ctl(m_handle, EPOLL_CTL_ADD, fd, &event) < 0)
-            throw std::system_error(errno, std::system_category());
 
-        m_data.emplace(fd, std::move(pf));
+        // a file stays registered after it's one-shot event fires, so it's rearmed instead of added again,
+        // unless it was closed since, which also removed it from the epoll instance
+        data_map::accessor accessor;
+        if (!m_data.insert(accessor, fd))
+            throw std::system_error(EEXIST, std::system_category(), "epoll_ctl");
+        if (epoll_ctl(m_handle, EPOLL_CTL_MOD, fd, &event) < 0 && (errno != ENOENT || epoll_ctl(m_handle, EPOLL_CTL_ADD, fd, &event) < 0)) {
+            int const error = errno;
+            m_data.erase(accessor);
+            throw std::system_error(error, std::system_category(), "epoll_ctl");
+        }
+
+        accessor->second = std::move(pf);
+        m_pending.fetch_add(1, std::memory_order_relaxed);
     }
 
     /**
      * @brief remove an existing poll request
 
+     * The completion of the removed request is invoked with `-ECANCELED`.
+
      * @param fd file descriptor to remove
      * @throws `std::system_error(ENOENT, std::system_category())`
      */
     void poll_remove(int fd);
 
-    std::size_t pending() const noexcept
+    [[nodiscard]] std::size_t pending() const noexcept
     {
-        return m_data.size();
+        return m_pending.load(std::memory_order_relaxed);
     }
 
-    void poll();
+    /**
+     * @brief waits for events and invokes the completions of the files that are ready
+
+     * @param timeout in milliseconds, -1 waits indefinitely
+     * @return number of completions invoked
+     */
+    std::size_t poll(int timeout = -1);
 
     ~epoll_service();
 
 private:
     native_handle_type m_handle = invalid_handle;
 
-    using data_map = oneapi::tbb::concurrent_hash_map<int, std::unique_ptr<void *, impl::ErasedDeleter>>;
+    using completion_pointer = std::unique_ptr<impl::epoll_completion, impl::epoll_completion_deleter>;
+
+    // the files with a poll request in flight, an entry is erased once it's completion is invoked
+    using data_map = oneapi::tbb::concurrent_hash_map<int, completion_pointer>;
     data_map m_data;
+    std::atomic_size_t m_pending = 0;
 };
 
 } // namespace tcx
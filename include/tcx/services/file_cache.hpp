@@ -0,0 +1,440 @@
+#ifndef TCX_SERVICES_FILE_CACHE_HPP
+#define TCX_SERVICES_FILE_CACHE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tcx/services/uring_service.hpp>
+#include <tcx/unique_function.hpp>
+
+namespace tcx {
+
+/**
+ * @brief Tuning of `tcx::file_cache`
+ */
+struct file_cache_options {
+    /** @brief number of files kept open, the least recently used ones are closed first */
+    std::size_t capacity = 1024;
+    /** @brief flags the files are opened with */
+    int open_flags = O_RDONLY | O_CLOEXEC;
+    /** @brief a cached file is checked against it's path with `statx()` when it wasn't in this long, zero checks on every open */
+    std::chrono::steady_clock::duration revalidate_interval = std::chrono::steady_clock::duration::zero();
+    /** @brief also install the files in the fixed file table of the ring */
+    bool fixed_files = false;
+};
+
+namespace impl {
+
+    /**
+     * @brief slots of the fixed file table owned by a `tcx::file_cache`, released by the files installed in them
+     */
+    class fixed_file_table {
+    public:
+        fixed_file_table(uring_context_storage &storage, std::size_t size)
+            : m_storage(storage)
+        {
+            m_free.reserve(size);
+            for (std::size_t i = size; i-- > 0;)
+                m_free.push_back(static_cast<int>(i));
+        }
+
+        fixed_file_table(fixed_file_table const &) = delete;
+        fixed_file_table &operator=(fixed_file_table const &) = delete;
+
+        ~fixed_file_table()
+        {
+            (void)m_storage.unregister_files();
+        }
+
+        /**
+         * @return the index `fd` was installed at, or -1 if the table is full
+         */
+        int install(int fd) noexcept
+        {
+            std::lock_guard lock(m_mutex);
+            if (m_free.empty())
+                return -1;
+            int const index = m_free.back();
+            if (m_storage.update_files(static_cast<unsigned>(index), std::span(&fd, 1)).has_error())
+                return -1;
+            m_free.pop_back();
+            return index;
+        }
+
+        void release(int index) noexcept
+        {
+            int const cleared = -1;
+            std::lock_guard lock(m_mutex);
+            (void)m_storage.update_files(static_cast<unsigned>(index), std::span(&cleared, 1));
+            m_free.push_back(index);
+        }
+
+    private:
+        uring_context_storage &m_storage;
+        std::mutex m_mutex;
+        std::vector<int> m_free;
+    };
+
+    struct cached_file_state {
+        cached_file_state(std::string path, int fd, std::shared_ptr<fixed_file_table> table) noexcept
+            : path(std::move(path))
+            , fd(fd)
+            , table(std::move(table))
+        {
+        }
+
+        cached_file_state(cached_file_state const &) = delete;
+        cached_file_state &operator=(cached_file_state const &) = delete;
+
+        ~cached_file_state()
+        {
+            if (fixed_index >= 0)
+                table->release(fixed_index);
+            ::close(fd);
+        }
+
+        std::string path;
+        int fd;
+        int fixed_index = -1;
+        struct ::statx stat;
+        std::shared_ptr<fixed_file_table> table;
+    };
+
+} // namespace impl
+
+/**
+ * @brief A file opened through a `tcx::file_cache`
+ *
+ * The file stays open while any copy of the handle is alive, even after it's evicted from the cache,
+ * so operations in flight can keep a copy to use the descriptor safely.
+ * Handles installed in the fixed file table must not outlive the ring.
+ */
+class cached_file {
+public:
+    cached_file() noexcept = default;
+
+    explicit cached_file(std::shared_ptr<impl::cached_file_state const> state) noexcept
+        : m_state(std::move(state))
+    {
+    }
+
+    [[nodiscard]] explicit operator bool() const noexcept
+    {
+        return static_cast<bool>(m_state);
+    }
+
+    [[nodiscard]] int native_handle() const noexcept
+    {
+        return m_state->fd;
+    }
+
+    /**
+     * @brief index of the file in the fixed file table of the ring, or -1 if it's not installed
+     */
+    [[nodiscard]] int fixed_index() const noexcept
+    {
+        return m_state->fixed_index;
+    }
+
+    /**
+     * @brief the result of `statx()` on the descriptor when it was opened
+     */
+    [[nodiscard]] struct ::statx const &stat() const noexcept
+    {
+        return m_state->stat;
+    }
+
+    [[nodiscard]] std::string_view path() const noexcept
+    {
+        return m_state->path;
+    }
+
+private:
+    std::shared_ptr<impl::cached_file_state const> m_state;
+};
+
+/**
+ * @brief LRU cache of open files keyed by path, built on the operations of an io_uring context
+ *
+ * A hit costs a single `statx()` on the path to check that the cached file is still the one at the path
+ * (same inode, size and modification time), or nothing if it was checked within `revalidate_interval`.
+ * A miss costs an `openat()` and a `statx()` on the new descriptor.
+ * Opens of the same path are coalesced while an open or a check is in flight.
+ *
+ * Opening can be done from any thread, as long as `Service` can be submitted to from it.
+ * The operations in flight keep the state of the cache alive, so the cache can be destroyed before they complete,
+ * their callbacks are still invoked; `Service` must outlive them.
+ * @see tcx::async_open(E &, tcx::file_cache<Service> &, tcx::native::c_string, F &&)
+ */
+template <typename Service>
+class file_cache {
+    using callback_type = tcx::unique_function<void(std::error_code, cached_file)>;
+    using clock = std::chrono::steady_clock;
+
+    struct node {
+        std::string path;
+        std::shared_ptr<impl::cached_file_state const> file;
+        clock::time_point validated;
+        struct ::statx check;
+        bool busy = false;
+        // invalidated while busy, it's no longer in the index and is dropped once it's operation finishes
+        bool stale = false;
+        std::vector<callback_type> waiters;
+    };
+
+    using node_iterator = typename std::list<node>::iterator;
+
+    // shared with the callbacks of the operations in flight
+    struct state : std::enable_shared_from_this<state> {
+        state(Service &service, file_cache_options const &options)
+            : service(service)
+            , options(options)
+        {
+        }
+
+        void invalidate(std::string_view path)
+        {
+            std::shared_ptr<impl::cached_file_state const> released;
+            std::lock_guard lock(mutex);
+            auto const it = index.find(path);
+            if (it == index.end())
+                return;
+            node_iterator const entry = it->second;
+            if (entry->busy) {
+                entry->stale = true;
+                index.erase(it);
+                return;
+            }
+            released = std::move(entry->file);
+            erase(entry);
+        }
+
+        template <typename F>
+        void open(std::string_view path, F &&callback)
+        {
+            std::unique_lock lock(mutex);
+            if (auto const it = index.find(path); it != index.end()) {
+                node_iterator const entry = it->second;
+                lru.splice(lru.begin(), lru, entry);
+                if (entry->busy) {
+                    entry->waiters.emplace_back(std::forward<F>(callback));
+                    return;
+                }
+                if (clock::now() - entry->validated < options.revalidate_interval) {
+                    cached_file file(entry->file);
+                    lock.unlock();
+                    callback(std::error_code(), std::move(file));
+                    return;
+                }
+                entry->busy = true;
+                entry->waiters.emplace_back(std::forward<F>(callback));
+                if (auto const error = revalidate(entry); error)
+                    fail(lock, entry, error);
+                return;
+            }
+
+            lru.emplace_front();
+            node_iterator const entry = lru.begin();
+            entry->path.assign(path);
+            entry->busy = true;
+            entry->waiters.emplace_back(std::forward<F>(callback));
+            index.emplace(entry->path, entry);
+            evict(lock);
+            if (auto const error = start_open(entry); error)
+                fail(lock, entry, error);
+        }
+
+        // the following are called with the lock held
+
+        std::error_code revalidate(node_iterator entry)
+        {
+            return to_error(service.async_statx(AT_FDCWD, entry->path.c_str(), AT_STATX_SYNC_AS_STAT, STATX_BASIC_STATS, &entry->check, [self = this->shared_from_this(), entry](Service &, io_uring_cqe const *result) {
+                std::unique_lock lock(self->mutex);
+                if (result->res < 0 || !same_file(entry->check, entry->file->stat)) {
+                    // the path now refers to another file, or to nothing, the old one stays open while it has handles
+                    auto released = std::move(entry->file);
+                    if (auto const error = self->start_open(entry); error)
+                        self->fail(lock, entry, error);
+                    else
+                        lock.unlock();
+                    released.reset();
+                    return;
+                }
+                entry->validated = clock::now();
+                self->finish(lock, entry, std::error_code());
+            }));
+        }
+
+        std::error_code start_open(node_iterator entry)
+        {
+            return to_error(service.async_openat(AT_FDCWD, entry->path.c_str(), options.open_flags, 0, [self = this->shared_from_this(), entry](Service &, io_uring_cqe const *result) {
+                std::unique_lock lock(self->mutex);
+                if (result->res < 0)
+                    return self->fail(lock, entry, std::error_code(-result->res, std::system_category()));
+
+                auto file = std::make_shared<impl::cached_file_state>(entry->path, result->res, self->table);
+                auto *const stat = &file->stat;
+                auto const error = to_error(self->service.async_statx(file->fd, "", AT_EMPTY_PATH | AT_STATX_SYNC_AS_STAT, STATX_BASIC_STATS, stat, [self, entry, file](Service &, io_uring_cqe const *result) mutable {
+                    std::unique_lock lock(self->mutex);
+                    if (result->res < 0)
+                        return self->fail(lock, entry, std::error_code(-result->res, std::system_category()));
+                    if (self->table)
+                        file->fixed_index = self->table->install(file->fd);
+                    entry->file = std::move(file);
+                    entry->validated = clock::now();
+                    self->finish(lock, entry, std::error_code());
+                }));
+                if (error)
+                    self->fail(lock, entry, error);
+            }));
+        }
+
+        // invokes the waiters with the file, or with `error`, and unlocks
+        void finish(std::unique_lock<std::mutex> &lock, node_iterator entry, std::error_code error)
+        {
+            auto waiters = std::move(entry->waiters);
+            entry->waiters.clear();
+            entry->busy = false;
+            cached_file const file = error ? cached_file() : cached_file(entry->file);
+            std::shared_ptr<impl::cached_file_state const> released;
+            if (entry->stale) {
+                released = std::move(entry->file);
+                erase(entry);
+            }
+            evict(lock);
+            lock.unlock();
+            released.reset();
+            for (auto &waiter : waiters)
+                waiter(error, file);
+        }
+
+        // drops the entry, invokes the waiters with `error` and unlocks
+        void fail(std::unique_lock<std::mutex> &lock, node_iterator entry, std::error_code error)
+        {
+            auto waiters = std::move(entry->waiters);
+            auto released = std::move(entry->file);
+            erase(entry);
+            lock.unlock();
+            released.reset();
+            for (auto &waiter : waiters)
+                waiter(error, cached_file());
+        }
+
+        void erase(node_iterator entry)
+        {
+            // a stale entry was already replaced in the index, maybe by a newer one of the same path
+            if (!entry->stale)
+                index.erase(entry->path);
+            lru.erase(entry);
+        }
+
+        // entries with operations in flight are skipped, so the cache can briefly go over capacity
+        void evict(std::unique_lock<std::mutex> &lock)
+        {
+            std::vector<std::shared_ptr<impl::cached_file_state const>> released;
+            for (auto it = lru.end(); index.size() > options.capacity && it != lru.begin();) {
+                --it;
+                if (it->busy)
+                    continue;
+                released.push_back(std::move(it->file));
+                auto const evicted = it;
+                ++it;
+                erase(evicted);
+            }
+            if (released.empty())
+                return;
+            // closing files may take the lock of the fixed file table
+            lock.unlock();
+            released.clear();
+            lock.lock();
+        }
+
+        Service &service;
+        file_cache_options options;
+        std::shared_ptr<impl::fixed_file_table> table;
+        mutable std::mutex mutex;
+        std::list<node> lru;
+        std::unordered_map<std::string_view, node_iterator> index; // keys point into the nodes
+    };
+
+public:
+    explicit file_cache(Service &service, file_cache_options const &options = {})
+        : m_state(std::make_shared<state>(service, options))
+    {
+        if (options.fixed_files && service.register_files_sparse(static_cast<unsigned>(options.capacity)).has_value())
+            m_state->table = std::make_shared<impl::fixed_file_table>(service, options.capacity);
+    }
+
+    file_cache(file_cache const &) = delete;
+    file_cache &operator=(file_cache const &) = delete;
+
+    /**
+     * @brief false if `fixed_files` was requested but the fixed file table couldn't be registered
+     */
+    [[nodiscard]] bool has_fixed_files() const noexcept
+    {
+        return static_cast<bool>(m_state->table);
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        std::lock_guard lock(m_state->mutex);
+        return m_state->index.size();
+    }
+
+    /**
+     * @brief drops `path` from the cache, handles already given out stay valid
+     *
+     * If an open or a check of `path` is in flight, it's waiters still get it's result,
+     * but the file isn't kept and the next open of `path` starts over.
+     */
+    void invalidate(std::string_view path)
+    {
+        m_state->invalidate(path);
+    }
+
+    /**
+     * @brief opens `path`, or reuses the cached file, and invokes `callback` with the result
+     *
+     * On a hit that doesn't need to be checked `callback` is invoked before returning,
+     * otherwise it's invoked from the completion of the last operation.
+     */
+    template <typename F>
+    void open(std::string_view path, F &&callback)
+    {
+        m_state->open(path, std::forward<F>(callback));
+    }
+
+private:
+    static bool same_file(struct ::statx const &a, struct ::statx const &b) noexcept
+    {
+        return a.stx_ino == b.stx_ino && a.stx_dev_major == b.stx_dev_major && a.stx_dev_minor == b.stx_dev_minor
+            && a.stx_size == b.stx_size && a.stx_mtime.tv_sec == b.stx_mtime.tv_sec && a.stx_mtime.tv_nsec == b.stx_mtime.tv_nsec;
+    }
+
+    static std::error_code to_error(native::result<uring_context_storage::operation_t> const &result) noexcept
+    {
+        if (result.has_error())
+            return std::error_code(result.error(), std::system_category());
+        return {};
+    }
+
+    std::shared_ptr<state> m_state;
+};
+
+} // namespace tcx
+
+#endif
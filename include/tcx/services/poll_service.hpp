@@ -3,6 +3,7 @@
 
 #include "tcx/unique_function.hpp"
 #include <algorithm>
+#include <cerrno>
 #include <stdexcept>
 #include <system_error>
 #include <utility>
@@ -21,34 +22,68 @@ public:
         auto it = std::lower_bound(m_fds.cbegin(), m_fds.cend(), fd, [](pollfd const &entry, int fd) { return entry.fd < fd; });
         if (it != m_fds.cend() && it->fd == fd)
             throw std::runtime_error("already polling this file descriptor");
-        auto const index = m_fds.cend() - it;
-        m_fds.insert(it, pollfd { .fd = fd, .events = events });
-        m_completions.insert(m_completions.cbegin() + index, std::forward<F>(f));
+        auto const index = it - m_fds.cbegin();
+        m_completions.emplace(m_completions.cbegin() + index, std::forward<F>(f));
+        try {
+            m_fds.insert(it, pollfd { .fd = fd, .events = events, .revents = 0 });
+        } catch (...) {
+            m_completions.erase(m_completions.cbegin() + index);
+            throw;
+        }
     }
 
-    void poll()
+    /**
+     * @brief waits for events and invokes the completions of the files that are ready
+
+     * @param timeout in milliseconds, -1 waits indefinitely
+     * @return number of completions invoked
+     */
+    std::size_t poll(int timeout = -1)
     {
-        auto fds = m_fds;
-        int res = ::poll(fds.data(), fds.size(), -1);
+        m_polled = m_fds;
+        int res = ::poll(m_polled.data(), m_polled.size(), timeout);
 
-        if (res < 0)
+        if (res < 0) {
+            if (errno == EINTR)
+                return 0;
             throw std::system_error(errno, std::system_category());
+        }
 
-        for (int i = 0; i < res; ++i) {
-            auto it = std::lower_bound(m_fds.cbegin(), m_fds.cend(), fds[i].fd, [](pollfd const &entry, int fd) { return entry.fd < fd; });
-            auto const index = m_fds.cend() - it;
+        // completions may add new requests, so every ready one is removed before invoking any
+        m_ready.clear();
+        for (auto const &entry : m_polled) {
+            if (entry.revents == 0)
+                continue;
+            auto it = std::lower_bound(m_fds.cbegin(), m_fds.cend(), entry.fd, [](pollfd const &entry, int fd) { return entry.fd < fd; });
+            auto const index = it - m_fds.cbegin();
+            m_ready.emplace_back(std::move(m_completions[index]), entry.revents);
             m_fds.erase(it);
-            auto f = std::move(m_completions[i]);
             m_completions.erase(m_completions.cbegin() + index);
-            f(std::move(fds[i].revents));
         }
+
+        auto ready = std::move(m_ready);
+        for (auto &[f, revents] : ready)
+            f(revents);
+        std::size_t const count = ready.size();
+        ready.clear();
+        m_ready = std::move(ready);
+        return count;
     }
 
-public:
+    [[nodiscard]] std::size_t pending() const noexcept
+    {
+        return m_fds.size();
+    }
+
+private:
     std::vector<pollfd> m_fds;
     std::vector<tcx::unique_function<void(short)>> m_completions;
+
+    // kept around to avoid allocating on every call
+    std::vector<pollfd> m_polled;
+    std::vector<std::pair<tcx::unique_function<void(short)>, short>> m_ready;
 };
 
 } // namespace tcx
 
-#endif
\ No newline at end of file
+#endif
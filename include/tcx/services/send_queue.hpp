@@ -0,0 +1,395 @@
+#ifndef TCX_SERVICES_SEND_QUEUE_HPP
+#define TCX_SERVICES_SEND_QUEUE_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <tcx/native/handle.hpp>
+#include <tcx/services/uring_service.hpp>
+#include <tcx/unique_function.hpp>
+
+namespace tcx {
+
+/**
+ * @brief Tuning of `tcx::send_queue`
+ */
+struct send_queue_options {
+    /** @brief `send()` returns false once this many bytes are queued */
+    std::size_t high_watermark = 1024 * 1024;
+    /** @brief after reaching the high watermark, the queue is writable again once it's down to this many bytes */
+    std::size_t low_watermark = 256 * 1024;
+    /** @brief payloads up to this size are copied together into shared chunks, bigger ones are sent from where they are */
+    std::size_t copy_threshold = 2048;
+    /** @brief batches of at least this many bytes are sent with `IORING_OP_SENDMSG_ZC`, zero disables it */
+    std::size_t zero_copy_threshold = 64 * 1024;
+    /** @brief most payloads sent by a single `sendmsg()` */
+    std::size_t max_batch = IOV_MAX;
+    /** @brief flags of every `sendmsg()` */
+    int flags = MSG_NOSIGNAL;
+};
+
+namespace impl {
+
+    template <typename Service>
+    class send_queue_state : public std::enable_shared_from_this<send_queue_state<Service>> {
+        using callback_type = tcx::unique_function<void(std::error_code)>;
+
+        constexpr static std::size_t chunk_size = 16 * 1024;
+
+        struct segment {
+            // a big payload, moved in, it's buffer stays where it is when the segment is moved
+            std::string payload;
+            // small payloads copied back to back
+            std::unique_ptr<std::byte[]> chunk;
+            std::size_t capacity = 0;
+            std::size_t size = 0;
+            std::size_t sent = 0;
+
+            [[nodiscard]] std::byte const *data() const noexcept
+            {
+                return chunk ? chunk.get() : reinterpret_cast<std::byte const *>(payload.data());
+            }
+        };
+
+    public:
+        send_queue_state(Service &service, tcx::native::handle_type socket, send_queue_options const &options)
+            : m_service(service)
+            , m_socket(socket)
+            , m_options(options)
+        {
+            // copied payloads have to fit in a chunk, and moved ones must be too long for the small string optimization
+            m_options.copy_threshold = std::clamp(m_options.copy_threshold, sizeof(std::string), chunk_size);
+            m_options.low_watermark = std::min(m_options.low_watermark, m_options.high_watermark);
+            m_zero_copy = m_options.zero_copy_threshold != 0;
+        }
+
+        send_queue_state(send_queue_state const &) = delete;
+        send_queue_state &operator=(send_queue_state const &) = delete;
+
+        [[nodiscard]] tcx::native::handle_type native_handle() const noexcept
+        {
+            return m_socket;
+        }
+
+        [[nodiscard]] std::size_t queued() const
+        {
+            std::lock_guard lock(m_mutex);
+            return m_queued;
+        }
+
+        [[nodiscard]] bool congested() const
+        {
+            std::lock_guard lock(m_mutex);
+            return m_congested;
+        }
+
+        [[nodiscard]] std::error_code error() const
+        {
+            std::lock_guard lock(m_mutex);
+            return m_error;
+        }
+
+        bool send(std::string &&payload)
+        {
+            std::unique_lock lock(m_mutex);
+            if (payload.size() <= m_options.copy_threshold)
+                append(payload.data(), payload.size());
+            else
+                push(std::move(payload));
+            return after_queueing(lock);
+        }
+
+        bool send(void const *data, std::size_t size)
+        {
+            std::unique_lock lock(m_mutex);
+            if (size <= m_options.copy_threshold)
+                append(data, size);
+            else
+                push(std::string(static_cast<char const *>(data), size));
+            return after_queueing(lock);
+        }
+
+        void on_drained(callback_type callback)
+        {
+            std::unique_lock lock(m_mutex);
+            if (m_congested && !m_error) {
+                m_drained.push_back(std::move(callback));
+                return;
+            }
+            auto const error = m_error;
+            lock.unlock();
+            callback(error);
+        }
+
+    private:
+        // all of the following are called with the lock held, the ones that take it unlock before returning
+
+        void append(void const *data, std::size_t size)
+        {
+            if (m_error || size == 0)
+                return;
+            // the chunk in flight can still be appended to, the bytes after the ones being sent aren't touched by the kernel
+            if (m_segments.empty() || !m_segments.back().chunk || m_segments.back().capacity - m_segments.back().size < size) {
+                m_segments.emplace_back();
+                m_segments.back().chunk = std::make_unique_for_overwrite<std::byte[]>(chunk_size);
+                m_segments.back().capacity = chunk_size;
+            }
+            auto &chunk = m_segments.back();
+            std::memcpy(chunk.chunk.get() + chunk.size, data, size);
+            chunk.size += size;
+            m_queued += size;
+        }
+
+        void push(std::string &&payload)
+        {
+            if (m_error)
+                return;
+            m_queued += payload.size();
+            auto &added = m_segments.emplace_back();
+            added.size = payload.size();
+            added.payload = std::move(payload);
+        }
+
+        bool after_queueing(std::unique_lock<std::mutex> &lock)
+        {
+            if (m_queued >= m_options.high_watermark)
+                m_congested = true;
+            bool const writable = !m_congested && !m_error;
+            start_send(lock);
+            return writable;
+        }
+
+        void start_send(std::unique_lock<std::mutex> &lock)
+        {
+            if (m_sending || m_segments.empty() || m_error) {
+                lock.unlock();
+                return;
+            }
+
+            std::size_t const count = std::min(m_segments.size(), m_options.max_batch);
+            std::size_t total = 0;
+            m_iovecs.resize(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                auto const &segment = m_segments[i];
+                m_iovecs[i].iov_base = const_cast<std::byte *>(segment.data() + segment.sent);
+                m_iovecs[i].iov_len = segment.size - segment.sent;
+                total += m_iovecs[i].iov_len;
+            }
+            m_message = {};
+            m_message.msg_iov = m_iovecs.data();
+            m_message.msg_iovlen = count;
+
+            bool const zero_copy = m_zero_copy && total >= m_options.zero_copy_threshold;
+            auto const flags = static_cast<unsigned>(m_options.flags);
+            auto completion = [self = this->shared_from_this(), zero_copy, retired = std::vector<segment>()](Service &, io_uring_cqe const *result) mutable {
+                // the notification of a zero copy send only releases the segments it sent
+                if (result->flags & IORING_CQE_F_NOTIF)
+                    return;
+                self->on_sent(result->res, zero_copy, retired);
+            };
+            auto const submitted = zero_copy ? m_service.async_sendmsg_zc(m_socket, &m_message, flags, std::move(completion)) : m_service.async_sendmsg(m_socket, &m_message, flags, std::move(completion));
+            if (submitted.has_error())
+                return fail(lock, std::error_code(submitted.error(), std::system_category()), nullptr);
+            m_sending = true;
+            lock.unlock();
+        }
+
+        void on_sent(int result, bool zero_copy, std::vector<segment> &retired)
+        {
+            std::unique_lock lock(m_mutex);
+            m_sending = false;
+            if (result == -EAGAIN) {
+                // non blocking socket with a full send buffer, the batch is sent again once it's writable
+                auto const submitted = m_service.async_poll_add(m_socket, POLLOUT, [self = this->shared_from_this()](Service &, io_uring_cqe const *result) {
+                    std::unique_lock lock(self->m_mutex);
+                    self->m_sending = false;
+                    if (result->res < 0)
+                        return self->fail(lock, std::error_code(-result->res, std::system_category()), nullptr);
+                    self->start_send(lock);
+                });
+                if (submitted.has_error())
+                    return fail(lock, std::error_code(submitted.error(), std::system_category()), zero_copy ? &retired : nullptr);
+                m_sending = true;
+                return;
+            }
+            if (zero_copy && (result == -EOPNOTSUPP || result == -EINVAL)) {
+                // the socket or the kernel can't send without copying
+                m_zero_copy = false;
+                return start_send(lock);
+            }
+            if (result < 0)
+                return fail(lock, std::error_code(-result, std::system_category()), zero_copy ? &retired : nullptr);
+
+            auto sent = static_cast<std::size_t>(result);
+            m_queued -= sent;
+            while (!m_segments.empty() && m_segments.front().size - m_segments.front().sent <= sent) {
+                sent -= m_segments.front().size - m_segments.front().sent;
+                if (zero_copy)
+                    retired.push_back(std::move(m_segments.front()));
+                m_segments.pop_front();
+            }
+            if (!m_segments.empty() && sent != 0) {
+                auto &partial = m_segments.front();
+                if (zero_copy) {
+                    // the kernel may still read the sent part, so the rest is sent from a copy
+                    segment rest;
+                    rest.capacity = rest.size = partial.size - partial.sent - sent;
+                    rest.chunk = std::make_unique_for_overwrite<std::byte[]>(rest.size);
+                    std::memcpy(rest.chunk.get(), partial.data() + partial.sent + sent, rest.size);
+                    retired.push_back(std::move(partial));
+                    partial = std::move(rest);
+                } else {
+                    partial.sent += sent;
+                }
+            }
+
+            std::vector<callback_type> drained;
+            if (m_congested && m_queued <= m_options.low_watermark) {
+                m_congested = false;
+                drained = std::move(m_drained);
+                m_drained.clear();
+            }
+            // whatever was queued while this batch was in flight goes out as the next one
+            start_send(lock);
+            for (auto &callback : drained)
+                callback(std::error_code());
+        }
+
+        // the error is sticky, the unsent payloads are dropped, or kept in `retired` until the kernel is done with them
+        void fail(std::unique_lock<std::mutex> &lock, std::error_code error, std::vector<segment> *retired)
+        {
+            m_error = error;
+            auto segments = std::move(m_segments);
+            m_segments.clear();
+            m_queued = 0;
+            auto drained = std::move(m_drained);
+            m_drained.clear();
+            lock.unlock();
+            if (retired)
+                std::move(segments.begin(), segments.end(), std::back_inserter(*retired));
+            for (auto &callback : drained)
+                callback(error);
+        }
+
+        Service &m_service;
+        tcx::native::handle_type m_socket;
+        send_queue_options m_options;
+        mutable std::mutex m_mutex;
+
+        std::deque<segment> m_segments;
+        std::size_t m_queued = 0;
+        std::vector<iovec> m_iovecs;
+        msghdr m_message {};
+        bool m_sending = false;
+        bool m_zero_copy;
+        bool m_congested = false;
+        std::error_code m_error;
+        std::vector<callback_type> m_drained;
+    };
+
+} // namespace impl
+
+/**
+ * @brief Queue of payloads to send on a socket, corked into one `sendmsg()` per batch
+ *
+ * A single send is in flight at a time. The payloads queued while it's in flight are sent together,
+ * as one `sendmsg()` over all of them, once it completes. A queue that isn't sending sends immediately.
+ * Batches of at least `zero_copy_threshold` bytes are sent with `IORING_OP_SENDMSG_ZC`, the sent payloads
+ * are kept alive until the kernel is done with them.
+ *
+ * Once `high_watermark` bytes are queued `send()` returns false, and the producers should stop
+ * until the callbacks given to `on_drained()` are invoked, when the queue is down to `low_watermark` bytes.
+ * Payloads are still queued when it returns false, the watermarks don't drop anything.
+ *
+ * The first error fails the queue, the unsent payloads are dropped and `on_drained()` callbacks are invoked with it.
+ * Sending can be done from any thread, as long as `Service` can be submitted to from it,
+ * and callbacks are invoked from the thread that reaps the completions.
+ * The queue doesn't own the socket, which must outlive the sends in flight.
+ */
+template <typename Service>
+class send_queue {
+    using callback_type = tcx::unique_function<void(std::error_code)>;
+
+public:
+    send_queue(Service &service, tcx::native::handle_type socket, send_queue_options const &options = {})
+        : m_state(std::make_shared<impl::send_queue_state<Service>>(service, socket, options))
+    {
+    }
+
+    [[nodiscard]] tcx::native::handle_type native_handle() const noexcept
+    {
+        return m_state->native_handle();
+    }
+
+    /**
+     * @brief bytes queued and not yet sent, including the ones in flight
+     */
+    [[nodiscard]] std::size_t queued() const
+    {
+        return m_state->queued();
+    }
+
+    /**
+     * @brief true from reaching the high watermark until going down to the low one
+     */
+    [[nodiscard]] bool congested() const
+    {
+        return m_state->congested();
+    }
+
+    /**
+     * @brief the error that failed the queue, if any
+     */
+    [[nodiscard]] std::error_code error() const
+    {
+        return m_state->error();
+    }
+
+    /**
+     * @brief queues `payload`
+     * @return false if the queue is congested or failed
+     */
+    bool send(std::string payload)
+    {
+        return m_state->send(std::move(payload));
+    }
+
+    /**
+     * @brief queues a copy of the `size` bytes at `data`
+     * @return false if the queue is congested or failed
+     */
+    bool send(void const *data, std::size_t size)
+    {
+        return m_state->send(data, size);
+    }
+
+    /**
+     * @brief invokes `callback` once the queue isn't congested, before returning if it already isn't
+     */
+    template <typename F>
+    void on_drained(F &&callback)
+    {
+        m_state->on_drained(callback_type(std::forward<F>(callback)));
+    }
+
+private:
+    std::shared_ptr<impl::send_queue_state<Service>> m_state;
+};
+
+} // namespace tcx
+
+#endif
@@ -9,10 +9,14 @@
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <new>
+#include <optional>
 #include <span>
+#include <stop_token>
 #include <system_error>
 #include <type_traits>
 #include <utility>
@@ -21,9 +25,13 @@
 
 #include <liburing.h>
 
+#include <tcx/affinity.hpp>
 #include <tcx/allocator_aware.hpp>
+#include <tcx/async/concepts.hpp>
 #include <tcx/native/handle.hpp>
 #include <tcx/native/result.hpp>
+#include <tcx/services/uring_statistics.hpp>
+#include <tcx/trace.hpp>
 #include <tcx/utilities/clamp.hpp>
 
 /** @addtogroup ioring_service Linux's io_uring */
@@ -144,6 +152,115 @@ struct uring_context_storage {
         return m_uring.features & feature;
     }
 
+    /**
+     * @brief number of completion queue entries the kernel couldn't post because the completion queue was full
+
+     * Can be called from any thread.
+     */
+    [[nodiscard]] std::uint64_t cq_overflow() const noexcept
+    {
+        if (m_uring.cq.koverflow == nullptr)
+            return 0;
+        return std::atomic_ref<unsigned const>(*m_uring.cq.koverflow).load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief registers `buffers` with the kernel, to be used with `async_read_fixed()` and `async_write_fixed()`
+
+     * The buffers are referred to by their index in `buffers`, and stay pinned until `unregister_buffers()`.
+     * @see [_man 3 io_uring_register_buffers_](https://man.archlinux.org/man/io_uring_register_buffers.3.en)
+     */
+    native::result<void> register_buffers(std::span<iovec const> buffers) noexcept
+    {
+        if (int const error = io_uring_register_buffers(&m_uring, buffers.data(), static_cast<unsigned>(buffers.size())); error < 0)
+            return native::result<void>::from_error(-error);
+        return {};
+    }
+
+    native::result<void> unregister_buffers() noexcept
+    {
+        if (int const error = io_uring_unregister_buffers(&m_uring); error < 0)
+            return native::result<void>::from_error(-error);
+        return {};
+    }
+
+    /**
+     * @brief registers an empty fixed file table of `count` entries, to be filled with `update_files()`
+     * @see [_man 3 io_uring_register_files_sparse_](https://man.archlinux.org/man/io_uring_register_files_sparse.3.en)
+     */
+    native::result<void> register_files_sparse(unsigned count) noexcept
+    {
+        if (int const error = io_uring_register_files_sparse(&m_uring, count); error < 0)
+            return native::result<void>::from_error(-error);
+        return {};
+    }
+
+    /**
+     * @brief replaces the entries of the fixed file table starting at `offset` with `files`, -1 clears an entry
+
+     * Can be called from any thread.
+     * @see [_man 3 io_uring_register_files_update_](https://man.archlinux.org/man/io_uring_register_files_update.3.en)
+     */
+    native::result<void> update_files(unsigned offset, std::span<int const> files) noexcept
+    {
+        if (int const error = io_uring_register_files_update(&m_uring, offset, files.data(), static_cast<unsigned>(files.size())); error < 0)
+            return native::result<void>::from_error(-error);
+        return {};
+    }
+
+    native::result<void> unregister_files() noexcept
+    {
+        if (int const error = io_uring_unregister_files(&m_uring); error < 0)
+            return native::result<void>::from_error(-error);
+        return {};
+    }
+
+    /**
+     * @brief restricts the io-wq workers, which run the operations that can't complete inline, to the CPUs in `cpus`
+
+     * For an `IORING_SETUP_SQPOLL` ring the submission thread is pinned at creation instead,
+     * with `IORING_SETUP_SQ_AFF` and `io_uring_params::sq_thread_cpu`.
+     * @see [_man 3 io_uring_register_iowq_aff_](https://man.archlinux.org/man/io_uring_register_iowq_aff.3.en)
+     */
+    native::result<void> register_iowq_affinity(tcx::cpu_set const &cpus) noexcept
+    {
+        if (int const error = io_uring_register_iowq_aff(&m_uring, sizeof(cpu_set_t), &cpus.native()); error < 0)
+            return native::result<void>::from_error(-error);
+        return {};
+    }
+
+    native::result<void> unregister_iowq_affinity() noexcept
+    {
+        if (int const error = io_uring_unregister_iowq_aff(&m_uring); error < 0)
+            return native::result<void>::from_error(-error);
+        return {};
+    }
+
+    /**
+     * @brief registers `ring`, shared memory holding `entries` provided buffers, as the buffer group `group`
+
+     * Operations submitted with `IOSQE_BUFFER_SELECT` and that group pick a buffer from it instead of taking one.
+     * @see tcx::buffer_ring
+     * @see [_man 3 io_uring_register_buf_ring_](https://man.archlinux.org/man/io_uring_register_buf_ring.3.en)
+     */
+    native::result<void> register_buffer_ring(io_uring_buf_ring *ring, unsigned entries, std::uint16_t group) noexcept
+    {
+        io_uring_buf_reg reg {};
+        reg.ring_addr = reinterpret_cast<std::uintptr_t>(ring);
+        reg.ring_entries = entries;
+        reg.bgid = group;
+        if (int const error = io_uring_register_buf_ring(&m_uring, &reg, 0); error < 0)
+            return native::result<void>::from_error(-error);
+        return {};
+    }
+
+    native::result<void> unregister_buffer_ring(std::uint16_t group) noexcept
+    {
+        if (int const error = io_uring_unregister_buf_ring(&m_uring, group); error < 0)
+            return native::result<void>::from_error(-error);
+        return {};
+    }
+
 protected:
     io_uring m_uring = default_uring();
 
@@ -214,7 +331,7 @@ struct uring_context_base {
 
         // only possible values are -1, 0, or a positive integer
         assert(offset >= -1);
-        assert(offset == -1 + !static_cast<Super *>(this)->has_feature(IORING_FEAT_RW_CUR_POS) == 2);
+        assert(offset != -1 || static_cast<Super *>(this)->has_feature(IORING_FEAT_RW_CUR_POS));
 
         io_uring_sqe op {};
         io_uring_prep_readv2(&op, fd, iov, tcx::utilities::clamp<unsigned>(iov_len), static_cast<uint64_t>(offset), flags);
@@ -250,7 +367,7 @@ struct uring_context_base {
 
         // only possible values are -1, 0, or a positive integer
         assert(offset >= -1);
-        assert(offset == -1 + !static_cast<Super *>(this)->has_feature(IORING_FEAT_RW_CUR_POS) == 2);
+        assert(offset != -1 || static_cast<Super *>(this)->has_feature(IORING_FEAT_RW_CUR_POS));
 
         io_uring_sqe op {};
         io_uring_prep_writev2(&op, fd, iov, tcx::utilities::clamp<unsigned>(iov_len), static_cast<uint64_t>(offset), flags);
@@ -412,6 +529,20 @@ struct uring_context_base {
         return static_cast<Super *>(this)->submit(&op, std::forward<F>(f));
     }
 
+    /**
+     * @brief like `async_sendmsg()`, but the buffers in `msg` are sent without being copied
+     *
+     * `f` is invoked like with `async_send_zc()`.
+     */
+    template <tcx::ioring_completion_handler<Super> F>
+    auto async_sendmsg_zc(int fd, msghdr const *msg, unsigned flags, F &&f)
+    {
+        io_uring_sqe op {};
+        io_uring_prep_sendmsg_zc(&op, fd, msg, flags);
+
+        return static_cast<Super *>(this)->submit(&op, std::forward<F>(f));
+    }
+
     // recvmsg(2)
     template <tcx::ioring_completion_handler<Super> F>
     auto async_recvmsg(int fd, msghdr *msg, unsigned flags, F &&f)
@@ -422,6 +553,25 @@ struct uring_context_base {
         return static_cast<Super *>(this)->submit(&op, std::forward<F>(f));
     }
 
+    /**
+     * @brief receives messages until cancelled or it fails, each one into a buffer picked from `buffer_group`
+
+     * Every completion but the last has `IORING_CQE_F_MORE` set, and the id of the buffer in it's upper 16 bits of `flags`.
+     * The buffer starts with a `io_uring_recvmsg_out` header, followed by the name, control data and payload,
+     * with only `msg_namelen` and `msg_controllen` of `msg` used, to size them.
+     * @see [_man 3 io_uring_prep_recvmsg_multishot_](https://man.archlinux.org/man/io_uring_prep_recvmsg_multishot.3.en)
+     */
+    template <tcx::ioring_completion_handler<Super> F>
+    auto async_recvmsg_multishot(int fd, msghdr *msg, unsigned flags, std::uint16_t buffer_group, F &&f)
+    {
+        io_uring_sqe op {};
+        io_uring_prep_recvmsg_multishot(&op, fd, msg, flags);
+        op.flags |= IOSQE_BUFFER_SELECT;
+        op.buf_group = buffer_group;
+
+        return static_cast<Super *>(this)->submit(&op, std::forward<F>(f));
+    }
+
     // send(2)
     template <tcx::ioring_completion_handler<Super> F>
     auto async_send(int fd, void const *buf, std::size_t buf_len, int flags, F &&f)
@@ -432,6 +582,22 @@ struct uring_context_base {
         return static_cast<Super *>(this)->submit(&op, std::forward<F>(f));
     }
 
+    /**
+     * @brief like `async_send()`, but `buf` is sent without being copied
+
+     * `f` is invoked with the result, and if it has `IORING_CQE_F_MORE` set, invoked again with `IORING_CQE_F_NOTIF` set
+     * once the kernel is done with `buf`.
+     * @see [_man 3 io_uring_prep_send_zc_](https://man.archlinux.org/man/io_uring_prep_send_zc.3.en)
+     */
+    template <tcx::ioring_completion_handler<Super> F>
+    auto async_send_zc(int fd, void const *buf, std::size_t buf_len, int flags, unsigned zc_flags, F &&f)
+    {
+        io_uring_sqe op {};
+        io_uring_prep_send_zc(&op, fd, buf, buf_len, flags, zc_flags);
+
+        return static_cast<Super *>(this)->submit(&op, std::forward<F>(f));
+    }
+
     // recv(2)
     template <tcx::ioring_completion_handler<Super> F>
     auto async_recv(int fd, void *buf, std::size_t buf_len, int flags, F &&f)
@@ -479,6 +645,20 @@ struct uring_context_base {
         return static_cast<Super *>(this)->submit(&op, std::forward<F>(f));
     }
 
+    /**
+     * @brief attempt to cancel an already issued request
+     * @see [_man 3 io_uring_prep_cancel_](https://man.archlinux.org/man/io_uring_prep_cancel.3.en)
+
+     * @warning
+     * The operation id is only meaningful while the operation is pending.
+     * Once it completes, the same id may be handed out to a new operation, which would then be the one cancelled.
+     * Prefer associating a `std::stop_token` with the completion handler, see `tcx::bind_stop_token`.
+
+     * @param operation id of the operation to cancel
+     * @param flags either 0 or <b>`IORING_ASYNC_CANCEL_ALL`</b>
+     * @param f callback, `cqe->res` is the number of cancelled operations when using <b>`IORING_ASYNC_CANCEL_ALL`</b>
+     * @return id of the operation
+     */
     template <tcx::ioring_completion_handler<Super> F>
     auto async_cancel(uring_context_storage::operation_t operation, unsigned flags, F &&f)
     {
@@ -488,6 +668,17 @@ struct uring_context_base {
         return static_cast<Super *>(this)->submit(&op, std::forward<F>(f));
     }
 
+    /**
+     * @brief attempt to cancel the requests issued on a file descriptor
+     * @see [_man 3 io_uring_prep_cancel_fd_](https://man.archlinux.org/man/io_uring_prep_cancel_fd.3.en)
+
+     * @param fd file descriptor the requests were issued on
+     * @param flags either 0 or a bitwise combination of the following constants:
+     * - <b>`IORING_ASYNC_CANCEL_ALL`</b>: cancel every matching request instead of only the first one
+     * - <b>`IORING_ASYNC_CANCEL_FD_FIXED`</b>: `fd` is a direct descriptor
+     * @param f callback
+     * @return id of the operation
+     */
     template <tcx::ioring_completion_handler<Super> F>
     auto async_cancel_fd(tcx::native::handle_type fd, unsigned flags, F &&f)
     {
@@ -497,6 +688,39 @@ struct uring_context_base {
         return static_cast<Super *>(this)->submit(&op, std::forward<F>(f));
     }
 
+    /**
+     * @brief cancel every request issued on a file descriptor with a single submission
+
+     * This is a shortcut for `async_cancel_fd(fd, IORING_ASYNC_CANCEL_ALL, f)`.
+     * `cqe->res` is the number of cancelled requests, or `-ENOENT` if there were none.
+
+     * @param fd file descriptor the requests were issued on
+     * @param f callback
+     * @return id of the operation
+     */
+    template <tcx::ioring_completion_handler<Super> F>
+    auto async_cancel_all(tcx::native::handle_type fd, F &&f)
+    {
+        return async_cancel_fd(fd, IORING_ASYNC_CANCEL_ALL, std::forward<F>(f));
+    }
+
+    /**
+     * @brief cancel every pending request in the ring with a single submission
+
+     * `cqe->res` is the number of cancelled requests, or `-ENOENT` if there were none.
+
+     * @param f callback
+     * @return id of the operation
+     */
+    template <tcx::ioring_completion_handler<Super> F>
+    auto async_cancel_any(F &&f)
+    {
+        io_uring_sqe op {};
+        io_uring_prep_cancel64(&op, 0, IORING_ASYNC_CANCEL_ANY | IORING_ASYNC_CANCEL_ALL);
+
+        return static_cast<Super *>(this)->submit(&op, std::forward<F>(f));
+    }
+
     template <tcx::ioring_completion_handler<Super> F>
     auto async_link_timeout(__kernel_timespec const *timeout, bool absolute, F &&f)
     {
@@ -603,7 +827,7 @@ struct uring_context_base {
 
         // only possible values are -1, 0, or a positive integer
         assert(offset >= -1);
-        assert(offset == -1 + !static_cast<Super *>(this)->has_feature(IORING_FEAT_RW_CUR_POS) == 2);
+        assert(offset != -1 || static_cast<Super *>(this)->has_feature(IORING_FEAT_RW_CUR_POS));
 
         io_uring_sqe op {};
         io_uring_prep_read(&op, fd, buf, tcx::utilities::clamp<unsigned>(buf_len), static_cast<uint64_t>(offset));
@@ -619,7 +843,7 @@ struct uring_context_base {
 
         // only possible values are -1, 0, or a positive integer
         assert(offset >= -1);
-        assert(offset == -1 + !static_cast<Super *>(this)->has_feature(IORING_FEAT_RW_CUR_POS) == 2);
+        assert(offset != -1 || static_cast<Super *>(this)->has_feature(IORING_FEAT_RW_CUR_POS));
 
         io_uring_sqe op {};
         io_uring_prep_write(&op, fd, buf, tcx::utilities::clamp<unsigned>(buf_len), static_cast<uint64_t>(offset));
@@ -627,6 +851,38 @@ struct uring_context_base {
         return static_cast<Super *>(this)->submit(&op, std::forward<F>(f));
     }
 
+    /**
+     * @brief like `async_read()`, but `buf` must be within the registered buffer `buf_index`
+     * @see uring_context_storage::register_buffers()
+     */
+    template <tcx::ioring_completion_handler<Super> F>
+    auto async_read_fixed(int fd, void *buf, std::size_t buf_len, off64_t offset, int buf_index, F &&f)
+    {
+        assert(offset >= -1);
+        assert(offset != -1 || static_cast<Super *>(this)->has_feature(IORING_FEAT_RW_CUR_POS));
+
+        io_uring_sqe op {};
+        io_uring_prep_read_fixed(&op, fd, buf, tcx::utilities::clamp<unsigned>(buf_len), static_cast<uint64_t>(offset), buf_index);
+
+        return static_cast<Super *>(this)->submit(&op, std::forward<F>(f));
+    }
+
+    /**
+     * @brief like `async_write()`, but `buf` must be within the registered buffer `buf_index`
+     * @see uring_context_storage::register_buffers()
+     */
+    template <tcx::ioring_completion_handler<Super> F>
+    auto async_write_fixed(int fd, void const *buf, std::size_t buf_len, off64_t offset, int buf_index, F &&f)
+    {
+        assert(offset >= -1);
+        assert(offset != -1 || static_cast<Super *>(this)->has_feature(IORING_FEAT_RW_CUR_POS));
+
+        io_uring_sqe op {};
+        io_uring_prep_write_fixed(&op, fd, buf, tcx::utilities::clamp<unsigned>(buf_len), static_cast<uint64_t>(offset), buf_index);
+
+        return static_cast<Super *>(this)->submit(&op, std::forward<F>(f));
+    }
+
     // splice(2) use -1 to signify null offsets
     template <tcx::ioring_completion_handler<Super> F>
     auto async_splice(int fd_in, off64_t off_in, int fd_out, off64_t off_out, std::size_t len, unsigned flags, F &&f)
@@ -710,6 +966,68 @@ struct uring_context_base {
     }
 };
 
+template <typename Super, typename Allocator>
+class uring_context_allocating_base;
+
+/**
+ * @brief raised while the operation submitted with it is in flight, see `tcx::uring_context_allocating_base::submit_flagged()`
+ */
+class alignas(8) uring_flag {
+public:
+    [[nodiscard]] bool raised() const noexcept
+    {
+        return m_raised.load(std::memory_order_acquire);
+    }
+
+private:
+    template <typename Super, typename Allocator>
+    friend class uring_context_allocating_base;
+
+    std::atomic_bool m_raised = false;
+};
+
+namespace impl {
+
+    /**
+     * @brief what the low bits of the user_data of an entry say about it, the rest of it is a pointer
+     *
+     * Completion objects and flags are aligned to at least 8 bytes, so the low 3 bits of their address are free,
+     * and the address of a completion is it's own user_data, which keeps it usable as an operation id.
+     */
+    enum class uring_op_kind : std::uint64_t {
+        completion = 0, // a completion object, invoked and then released
+        cancel = 1, // a cancellation request, the pointer is the completion it targets
+        flag = 2, // the pointer is a `tcx::uring_flag`, lowered once the operation completes
+        message = 3, // posted by another ring with IORING_OP_MSG_RING, nothing was submitted to this one for it
+        ignore = 4, // submitted only for it's side effects
+    };
+
+    inline constexpr std::uint64_t uring_op_kind_mask = 7;
+
+    inline std::uint64_t tag_user_data(void const *pointer, uring_op_kind kind) noexcept
+    {
+        return reinterpret_cast<std::uintptr_t>(pointer) | static_cast<std::uint64_t>(kind);
+    }
+
+    constexpr uring_op_kind kind_of(std::uint64_t user_data) noexcept
+    {
+        return static_cast<uring_op_kind>(user_data & uring_op_kind_mask);
+    }
+
+    template <typename T>
+    T *pointer_of(std::uint64_t user_data) noexcept
+    {
+        return reinterpret_cast<T *>(static_cast<std::uintptr_t>(user_data & ~uring_op_kind_mask));
+    }
+
+    // true for the last entry of an operation submitted to this ring
+    inline bool ends_operation(io_uring_cqe const *cqe) noexcept
+    {
+        return !(cqe->flags & IORING_CQE_F_MORE) && kind_of(cqe->user_data) != uring_op_kind::message;
+    }
+
+} // namespace impl
+
 /**
  * @brief provides allocator aweraness to an uring_context
  * @tparam Allocator rebound to std::byte
@@ -725,65 +1043,374 @@ public:
     {
     }
 
+    /**
+     * @brief copies the statistics recorded so far into `out`
+
+     * Can be called from any thread while the context is in use.
+     * When `TCX_URING_STATS` is disabled nothing is recorded and `out` is left untouched.
+     */
+    void snapshot_statistics(uring_statistics_snapshot &out) const noexcept
+    {
+        if constexpr (uring_statistics::enabled) {
+            m_statistics.snapshot(out);
+            out.cq_overflow = static_cast<Super const *>(this)->cq_overflow();
+        }
+    }
+
+protected:
+    [[no_unique_address]] uring_statistics m_statistics;
+
 private:
-    struct ICompletion {
-        virtual void invoke(Super &, io_uring_cqe const *) = 0;
-        virtual ~ICompletion() = default;
+    // dispatched through plain function pointers set by the concrete completion, without virtual calls
+    struct CompletionBase {
+        using invoke_type = void (*)(Super &, CompletionBase *, io_uring_cqe const *);
+        using destroy_type = void (*)(Super &, CompletionBase *) noexcept;
+
+        CompletionBase(invoke_type invoke, destroy_type destroy) noexcept
+            : invoke(invoke)
+            , destroy(destroy)
+        {
+        }
+
+        CompletionBase(CompletionBase const &) = delete;
+        CompletionBase &operator=(CompletionBase const &) = delete;
+
+        /**
+         * @brief increments the reference count, unless the completion is already being destroyed
+         */
+        bool try_retain() noexcept
+        {
+            std::uint32_t count = references.load(std::memory_order_relaxed);
+            do {
+                if (count == 0)
+                    return false;
+            } while (!references.compare_exchange_weak(count, count + 1, std::memory_order_acquire, std::memory_order_relaxed));
+            return true;
+        }
+
+        invoke_type invoke;
+        destroy_type destroy;
+        // one for the pending operation, plus one for each cancellation request targeting it
+        std::atomic_uint32_t references = 1;
+        [[no_unique_address]] uring_statistics::record statistics;
+    };
+
+    static_assert(alignof(CompletionBase) > impl::uring_op_kind_mask, "the kind of an operation is kept in the low bits of it's completion's address");
+
+    // submits a cancellation request for `target` in response to a stop request
+    struct canceller {
+        Super *service;
+        CompletionBase *target;
+
+        void operator()() const noexcept
+        {
+            service->cancel_completion(target);
+        }
     };
 
     template <typename Callback>
-    struct Completion final : public virtual ICompletion {
+    struct Completion final : public CompletionBase {
         template <typename... Args>
         explicit Completion(std::in_place_t, Args &&...args)
-            : callback(std::forward<Args>(args)...)
+            : CompletionBase(&Completion::invoke_callback, &Completion::destroy_completion)
+            , callback(std::forward<Args>(args)...)
         {
         }
 
-        void invoke(Super &service, io_uring_cqe const *result) override
+        // the task a fused completion is posted as, owning the reference of the operation
+        struct task {
+            task(Super *service, Completion *self) noexcept
+                : service(service)
+                , self(self)
+            {
+            }
+
+            task(task &&other) noexcept
+                : service(other.service)
+                , self(std::exchange(other.self, nullptr))
+            {
+            }
+
+            task &operator=(task &&) = delete;
+
+            // a task dropped by the executor without running still releases the completion
+            ~task()
+            {
+                if (self)
+                    service->release_completion(self);
+            }
+
+            void operator()()
+            {
+                task const owner = std::move(*this);
+                owner.self->callback.run();
+            }
+
+            Super *service;
+            Completion *self;
+        };
+
+        static void invoke_callback(Super &service, CompletionBase *base, io_uring_cqe const *result)
         {
+            auto *const self = static_cast<Completion *>(base);
+            if constexpr (tcx::impl::fuses_completion<Callback>) {
+                if (!(result->flags & IORING_CQE_F_MORE)) {
+                    // the completion itself is the posted task, the handler isn't moved anywhere
+                    self->callback.dispatch(result->user_data, result->res, task(&service, self));
+                    return;
+                }
+            }
+
             if (result->flags & IORING_CQE_F_MORE) {
                 // there will be more completion entries coming, do not delete
-                std::invoke(this->callback, service, result);
+                std::invoke(self->callback, service, result);
             } else {
                 // last completion,
                 // ensure the pointer gets deleted even in an exception
 
                 try {
-                    std::invoke(this->callback, service, result);
+                    std::invoke(self->callback, service, result);
                 } catch (...) {
-                    service.delete_object(this);
+                    service.release_completion(self);
                     throw;
                 }
+                service.release_completion(self);
             }
         }
 
+        static void destroy_completion(Super &service, CompletionBase *base) noexcept
+        {
+            service.delete_object(static_cast<Completion *>(base));
+        }
+
         Callback callback;
-        virtual ~Completion() = default;
+        [[no_unique_address]] std::conditional_t<tcx::impl::has_stop_token<Callback>, std::optional<std::stop_callback<canceller>>, std::monostate> stop_callback;
     };
 
+    void release_completion(CompletionBase *completion) noexcept
+    {
+        if (completion->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            completion->destroy(*static_cast<Super *>(this), completion);
+    }
+
+    void cancel_completion(CompletionBase *target) noexcept
+    {
+        // the reference keeps `target`'s address from being reused by another operation
+        // until the kernel is done looking for it
+        if (!target->try_retain())
+            return;
+
+        // the request carries `target` in it's user_data, and releases it once it completes without a completion of it's own
+        io_uring_sqe op {};
+        io_uring_prep_cancel64(&op, reinterpret_cast<std::uintptr_t>(target), 0);
+        io_uring_sqe_set_data64(&op, impl::tag_user_data(target, impl::uring_op_kind::cancel));
+        if (static_cast<Super *>(this)->submit_one(&op).has_error()) {
+            release_completion(target);
+            return;
+        }
+        tcx::trace::record(tcx::trace::event_type::submit, op.user_data, op.opcode);
+    }
+
 public:
+    /**
+     * @brief submits an operation with `callback` as it's completion handler
+
+     * If `callback` has an associated `std::stop_token` (see `tcx::bind_stop_token`),
+     * requesting a stop will submit a cancellation request for the operation.
+     */
     template <tcx::ioring_completion_handler<Super> F>
     native::result<uring_context_storage::operation_t> submit(io_uring_sqe *operation, F &&callback)
     {
-        auto *completion = this->template new_object<Completion<F>>(std::in_place, std::forward<F>(callback));
-        io_uring_sqe_set_data(operation, completion);
+        using completion_type = Completion<std::remove_cvref_t<F>>;
+
+        auto *completion = this->template new_object<completion_type>(std::in_place, std::forward<F>(callback));
+        CompletionBase *const erased = completion;
+        io_uring_sqe_set_data(operation, erased);
+        // kept aside, another thread may reap the completion and free it as soon as it's queued
+        auto const statistics = m_statistics.make_record(operation);
+        erased->statistics = statistics;
+
+        std::stop_token token;
+        if constexpr (tcx::impl::has_stop_token<F>) {
+            token = completion->callback.get_stop_token();
+            if (token.stop_possible())
+                erased->references.fetch_add(1, std::memory_order_relaxed); // keeps it alive until the stop callback is registered
+        }
 
         if (auto const result = static_cast<Super *>(this)->submit_one(operation); result.has_error()) {
             this->delete_object(completion);
             return native::result<uring_context_storage::operation_t>::from_error(result.error());
-        } else {
-            return native::result<uring_context_storage::operation_t>::from_value(static_cast<uring_context_storage::operation_t>(reinterpret_cast<uintptr_t>(completion)));
         }
+        m_statistics.on_submit(statistics);
+        tcx::trace::record(tcx::trace::event_type::submit, reinterpret_cast<std::uintptr_t>(erased), operation->opcode);
+
+        if constexpr (tcx::impl::has_stop_token<F>) {
+            if (token.stop_possible()) {
+                // if a stop was already requested, the cancellation is submitted right away, after the operation itself
+                completion->stop_callback.emplace(std::move(token), canceller { static_cast<Super *>(this), erased });
+                release_completion(erased);
+            }
+        }
+        return native::result<uring_context_storage::operation_t>::from_value(static_cast<uring_context_storage::operation_t>(reinterpret_cast<uintptr_t>(erased)));
+    }
+
+    /**
+     * @brief submits `first` and `second` as a chain, with `on_first` and `on_second` as their completion handlers
+
+     * `second` starts once `first` completes, and if `first` fails (or completes short, for reads, writes and splices)
+     * `second` completes with `ECANCELED`. Both are submitted to the kernel together, the backlog never splits a chain.
+     * @see [_man 2 io_uring_enter_ (IOSQE_IO_LINK)](https://man.archlinux.org/man/io_uring_enter.2.en)
+     */
+    template <tcx::ioring_completion_handler<Super> F, tcx::ioring_completion_handler<Super> G>
+    native::result<void> submit_linked(io_uring_sqe *first, F &&on_first, io_uring_sqe *second, G &&on_second)
+    {
+        using first_type = Completion<std::remove_cvref_t<F>>;
+        using second_type = Completion<std::remove_cvref_t<G>>;
+
+        auto *const first_completion = this->template new_object<first_type>(std::in_place, std::forward<F>(on_first));
+        second_type *second_completion;
+        try {
+            second_completion = this->template new_object<second_type>(std::in_place, std::forward<G>(on_second));
+        } catch (...) {
+            this->delete_object(first_completion);
+            throw;
+        }
+
+        CompletionBase *const erased[] = { first_completion, second_completion };
+        io_uring_sqe_set_data(first, erased[0]);
+        io_uring_sqe_set_data(second, erased[1]);
+        first->flags |= IOSQE_IO_LINK;
+        uring_statistics::record const statistics[] = { m_statistics.make_record(first), m_statistics.make_record(second) };
+        erased[0]->statistics = statistics[0];
+        erased[1]->statistics = statistics[1];
+
+        io_uring_sqe const *const chain[] = { first, second };
+        if (auto const result = static_cast<Super *>(this)->submit_many(chain); result.has_error()) {
+            this->delete_object(first_completion);
+            this->delete_object(second_completion);
+            return result;
+        }
+        m_statistics.on_submit(statistics[0]);
+        m_statistics.on_submit(statistics[1]);
+        tcx::trace::record(tcx::trace::event_type::submit, reinterpret_cast<std::uintptr_t>(erased[0]), first->opcode);
+        tcx::trace::record(tcx::trace::event_type::submit, reinterpret_cast<std::uintptr_t>(erased[1]), second->opcode);
+        return {};
+    }
+
+    /**
+     * @brief submits `operation` without a completion object, `flag` is raised until it completes
+     *
+     * For operations where only finishing matters, not the result, like a read keeping a loop wakeable.
+     * `flag` must outlive the operation.
+     */
+    native::result<void> submit_flagged(io_uring_sqe *operation, uring_flag &flag) noexcept
+    {
+        io_uring_sqe_set_data64(operation, impl::tag_user_data(&flag, impl::uring_op_kind::flag));
+        flag.m_raised.store(true, std::memory_order_relaxed);
+        if (auto const result = static_cast<Super *>(this)->submit_one(operation); result.has_error()) {
+            flag.m_raised.store(false, std::memory_order_relaxed);
+            return result;
+        }
+        tcx::trace::record(tcx::trace::event_type::submit, operation->user_data, operation->opcode);
+        return {};
+    }
+
+    /**
+     * @brief posts an entry to the completion queue of `target`, waking it if it's waiting for completions
+     *
+     * Neither ring allocates anything for it, and `target` doesn't count it as one of it's operations.
+     * Needs Linux 5.18, it fails with `EINVAL` before that.
+     * @see [_man 3 io_uring_prep_msg_ring_](https://man.archlinux.org/man/io_uring_prep_msg_ring.3)
+     */
+    native::result<void> wake(uring_context_storage &target) noexcept
+    {
+        io_uring_sqe op {};
+        io_uring_prep_msg_ring(&op, target.native_handle(), 0, impl::tag_user_data(nullptr, impl::uring_op_kind::message), 0);
+        io_uring_sqe_set_data64(&op, impl::tag_user_data(nullptr, impl::uring_op_kind::ignore));
+        return static_cast<Super *>(this)->submit_one(&op);
     }
 
     void complete(io_uring_cqe const *cqe)
     {
-        auto udata = io_uring_cqe_get_data(cqe);
-        auto *completion = reinterpret_cast<ICompletion *>(udata);
-        completion->invoke(*static_cast<Super *>(this), cqe);
+        tcx::trace::record(tcx::trace::event_type::complete, cqe->user_data, cqe->res, cqe->flags);
+        switch (impl::kind_of(cqe->user_data)) {
+        case impl::uring_op_kind::completion: {
+            auto *const completion = impl::pointer_of<CompletionBase>(cqe->user_data);
+            m_statistics.on_complete(completion->statistics, cqe);
+            completion->invoke(*static_cast<Super *>(this), completion, cqe);
+            break;
+        }
+        case impl::uring_op_kind::cancel:
+            release_completion(impl::pointer_of<CompletionBase>(cqe->user_data));
+            break;
+        case impl::uring_op_kind::flag:
+            impl::pointer_of<uring_flag>(cqe->user_data)->m_raised.store(false, std::memory_order_release);
+            break;
+        case impl::uring_op_kind::message:
+        case impl::uring_op_kind::ignore:
+            break;
+        }
     }
 };
 
+namespace impl {
+
+    // number of entries at the front of `backlog` that have to be submitted together
+    template <typename Backlog>
+    std::size_t chain_length(Backlog const &backlog) noexcept
+    {
+        std::size_t length = 1;
+        while (length < backlog.size() && (backlog[length - 1].get()->flags & IOSQE_IO_LINK))
+            ++length;
+        return length;
+    }
+
+    // copies a submission queue entry into the ring, `IORING_SETUP_SQE128` doubles the size of the entries
+    inline void copy_sqe(io_uring const &uring, io_uring_sqe *to, io_uring_sqe const *from) noexcept
+    {
+        std::size_t const shift = static_cast<bool>(uring.flags & IORING_SETUP_SQE128);
+        std::memcpy(to, from, sizeof(*from) << shift);
+    }
+
+    // a submission queue entry kept in the backlog, large enough for the entries of any ring
+    struct sqe_storage {
+        void assign(io_uring const &uring, io_uring_sqe const *sqe) noexcept
+        {
+            copy_sqe(uring, reinterpret_cast<io_uring_sqe *>(storage), sqe);
+        }
+
+        [[nodiscard]] io_uring_sqe const *get() const noexcept
+        {
+            return reinterpret_cast<io_uring_sqe const *>(storage);
+        }
+
+        alignas(io_uring_sqe) std::byte storage[sizeof(io_uring_sqe) * 2];
+    };
+
+    // copies a completion queue entry out of the ring, so that the slot can be reused before it's completion runs
+    struct cqe_storage {
+        void assign(io_uring const &uring, io_uring_cqe const *cqe) noexcept
+        {
+            std::size_t const shift = static_cast<bool>(uring.flags & IORING_SETUP_CQE32);
+            std::memcpy(storage, cqe, sizeof(*cqe) << shift);
+        }
+
+        [[nodiscard]] io_uring_cqe const *get() const noexcept
+        {
+            return reinterpret_cast<io_uring_cqe const *>(storage);
+        }
+
+        alignas(io_uring_cqe) std::byte storage[sizeof(io_uring_cqe) * 2];
+    };
+
+} // namespace impl
+
+/**
+ * @brief io_uring context meant to be used from a single thread
+
+ * When the submission queue is full, submissions are kept in a backlog instead of forcing a submission to the kernel.
+ * The backlog is moved to the submission queue by `run_once()`, after completions have been reaped.
+ */
 template <typename Allocator = std::allocator<std::byte>>
 struct unsynchronized_uring_context final
     : public uring_context_storage,
@@ -793,9 +1420,12 @@ struct unsynchronized_uring_context final
     using allocator_type = typename uring_context_allocating_base<unsynchronized_uring_context<Allocator>, Allocator>::allocator_type;
 
 private:
+    using backlog_allocator = typename std::allocator_traits<allocator_type>::template rebind_alloc<impl::sqe_storage>;
+
     unsynchronized_uring_context(uring_context_storage storage, allocator_type allocator) noexcept
         : uring_context_storage(std::move(storage))
-        , uring_context_allocating_base<unsynchronized_uring_context<Allocator>, Allocator>(std::move(allocator))
+        , uring_context_allocating_base<unsynchronized_uring_context<Allocator>, Allocator>(allocator)
+        , m_backlog(backlog_allocator(allocator))
     {
     }
 
@@ -817,35 +1447,120 @@ public:
         return create(entries, &params, std::move(allocator));
     }
 
+    /**
+     * @brief number of operations that haven't completed yet, including the ones in the backlog
+     */
     [[nodiscard]] std::size_t pending() const noexcept
     {
         return m_pending;
     }
 
+    /**
+     * @brief number of operations waiting for room in the submission queue
+     */
+    [[nodiscard]] std::size_t backlog() const noexcept
+    {
+        return m_backlog.size();
+    }
+
+    /**
+     * @brief queues an operation to be submitted to the kernel
+
+     * This never enters the kernel. If there's no room in the submission queue,
+     * or the kernel could drop completions because too many operations are in flight,
+     * the operation is kept in the backlog until the next call to `run_once()`.
+     * On a ring set up with `IORING_SETUP_SQE128` `submission` is copied as a 128 byte entry.
+     */
     native::result<void> submit_one(io_uring_sqe const *submission) noexcept
     {
-        io_uring_sqe *sqe;
-        while ((sqe = io_uring_get_sqe(&this->m_uring)) == nullptr) {
-            int const result = io_uring_submit(&this->m_uring);
-            switch (result) {
-            case 0:
-                continue;
-            case EINTR:
-                continue;
-            case EBADR: // this is an unrecoverable error from our part
-                std::abort();
-            // TODO: case EAGAIN
-            default:
-                return tcx::native::result<void>::from_error(-result);
+        return submit_many({ &submission, 1 });
+    }
+
+    /**
+     * @brief queues operations to be submitted to the kernel, in order
+
+     * Either all of them go to the submission queue, or all of them go to the backlog,
+     * so that linked operations stay together.
+     */
+    native::result<void> submit_many(std::span<io_uring_sqe const *const> submissions) noexcept
+    {
+        // anything in the backlog goes first, so that operations are submitted in order
+        if (m_backlog.empty() && can_issue() && io_uring_sq_space_left(&this->m_uring) >= submissions.size()) [[likely]] {
+            for (auto submission : submissions)
+                impl::copy_sqe(this->m_uring, io_uring_get_sqe(&this->m_uring), submission);
+        } else {
+            this->m_statistics.on_sq_full();
+            std::size_t const size = m_backlog.size();
+            try {
+                for (auto submission : submissions)
+                    m_backlog.emplace_back().assign(this->m_uring, submission);
+            } catch (std::bad_alloc const &) {
+                m_backlog.resize(size);
+                return tcx::native::result<void>::from_error(ENOMEM);
             }
         }
-        *sqe = *submission;
+        m_pending += submissions.size();
         return {};
     }
 
+    /**
+     * @brief submits the queued operations, waits for `wait_nr` completions, and invokes every available completion
+
+     * Once the completions are reaped, as much of the backlog as possible is moved to the submission queue,
+     * to be submitted by the next call.
+     * Doesn't block if there are no operations in flight.
+
+     * @return number of completion queue entries processed
+     */
+    native::result<std::size_t> run_once(std::uint32_t wait_nr = 1)
+    {
+        flush_backlog();
+        // an operation left in the backlog may be the one completing those in flight, submit until it fits
+        while (!m_backlog.empty() && io_uring_sq_space_left(&this->m_uring) == 0 && can_issue()) {
+            if (io_uring_submit(&this->m_uring) <= 0)
+                break;
+            flush_backlog();
+        }
+        if (m_pending == m_backlog.size())
+            wait_nr = 0; // nothing in flight, waiting would block forever
+
+        tcx::trace::record(tcx::trace::event_type::enter_begin, 0, io_uring_sq_ready(&this->m_uring));
+        int const result = io_uring_submit_and_wait(&this->m_uring, wait_nr);
+        tcx::trace::record(tcx::trace::event_type::enter_end, 0, result);
+        switch (-result) {
+        case EINTR:
+        case EAGAIN: // out of resources, the entries stay in the submission queue until they can be reaped
+        case EBUSY: // the completion queue overflowed, it must be reaped before submitting more
+        case ETIME:
+            break;
+        case EBADR: // this is an unrecoverable error from our part
+            std::abort();
+        default:
+            if (result < 0)
+                return native::result<std::size_t>::from_error(-result);
+        }
+
+        std::size_t count = 0;
+        io_uring_cqe *cqe;
+        impl::cqe_storage storage;
+        while (io_uring_peek_cqe(&this->m_uring, &cqe) == 0 && cqe != nullptr) {
+            // advance before invoking, a completion may throw or call run_once() itself
+            storage.assign(this->m_uring, cqe);
+            io_uring_cqe_seen(&this->m_uring, cqe);
+            if (impl::ends_operation(storage.get()))
+                --m_pending;
+            ++count;
+            this->complete(storage.get());
+        }
+
+        flush_backlog();
+        return native::result<std::size_t>::from_value(count);
+    }
+
     native::result<std::size_t> wait_many(std::span<io_uring_cqe *const> &completions, std::uint32_t wait_nr) noexcept
     {
-        if (int const error = io_uring_submit_and_wait(&this->m_uring, wait_nr); error != 0) {
+        flush_backlog();
+        if (int const error = io_uring_submit_and_wait(&this->m_uring, wait_nr); error < 0 && error != -EBUSY && error != -EAGAIN) {
             return native::result<std::size_t>::from_error(-error);
         }
 
@@ -858,46 +1573,123 @@ public:
                 break;
             std::size_t const shift = static_cast<bool>(this->m_uring.flags & IORING_SETUP_CQE32);
             std::memcpy(completions[seen], cqe, sizeof(*cqe) << shift);
+            if (impl::ends_operation(cqe))
+                --m_pending;
             ++seen;
         }
         io_uring_cq_advance(&this->m_uring, seen);
+        flush_backlog();
         completions = std::span<io_uring_cqe *const> { completions.data(), seen };
         return native::result<std::size_t>::from_value(seen);
     }
 
 private:
+    // without IORING_FEAT_NODROP the kernel drops completions when the completion queue is full,
+    // so the number of operations in flight can't exceed it's size
+    [[nodiscard]] bool can_issue() const noexcept
+    {
+        return this->has_feature(IORING_FEAT_NODROP) || m_pending - m_backlog.size() < this->m_uring.cq.ring_entries;
+    }
+
+    void flush_backlog() noexcept
+    {
+        while (!m_backlog.empty() && can_issue()) {
+            std::size_t const length = impl::chain_length(m_backlog);
+            if (io_uring_sq_space_left(&this->m_uring) < length)
+                break;
+            for (std::size_t i = 0; i < length; ++i) {
+                impl::copy_sqe(this->m_uring, io_uring_get_sqe(&this->m_uring), m_backlog.front().get());
+                m_backlog.pop_front();
+            }
+        }
+    }
+
     std::size_t m_pending = 0;
+    std::deque<impl::sqe_storage, backlog_allocator> m_backlog;
 };
 
+/**
+ * @brief io_uring context that can be submitted to and reaped from multiple threads
+
+ * Like `tcx::unsynchronized_uring_context`, submissions that don't fit in the submission queue
+ * are kept in a backlog that's moved to the submission queue after completions are reaped.
+ */
 template <typename Allocator = std::allocator<std::byte>>
 struct synchronized_uring_context final
     : public uring_context_storage,
       public uring_context_allocating_base<synchronized_uring_context<Allocator>, Allocator>,
       public uring_context_base<synchronized_uring_context<Allocator>> {
 
+    using allocator_type = typename uring_context_allocating_base<synchronized_uring_context<Allocator>, Allocator>::allocator_type;
+
+private:
+    using backlog_allocator = typename std::allocator_traits<allocator_type>::template rebind_alloc<impl::sqe_storage>;
+
+public:
+    /**
+     * @brief takes ownership of the io_uring instance in `storage`
+
+     * This type isn't movable, see `tcx::uring_context_storage::create()`.
+     */
+    explicit synchronized_uring_context(uring_context_storage storage, allocator_type allocator = allocator_type()) noexcept
+        : uring_context_storage(std::move(storage))
+        , uring_context_allocating_base<synchronized_uring_context<Allocator>, Allocator>(allocator)
+    {
+    }
+
     [[nodiscard]] std::size_t pending() const noexcept
     {
         return m_pending.load(std::memory_order_acquire);
     }
 
+    [[nodiscard]] std::size_t backlog() const
+    {
+        std::unique_lock sq_lock(m_sq_mutex);
+        return m_backlog.size();
+    }
+
 private:
+    // must be called with the submission queue lock held
     native::result<void> submit_to_kernel()
     {
         for (;;) {
-            int const error = io_uring_submit(&this->m_uring);
-            switch (error) {
-            case 0:
-                break;
+            tcx::trace::record(tcx::trace::event_type::enter_begin, 0, io_uring_sq_ready(&this->m_uring));
+            int const result = io_uring_submit(&this->m_uring);
+            tcx::trace::record(tcx::trace::event_type::enter_end, 0, result);
+            if (result >= 0)
+                return {};
+            switch (-result) {
             case EINTR:
                 continue;
+            case EAGAIN: // out of resources, the entries stay in the submission queue until they can be reaped
+            case EBUSY: // the completion queue overflowed, it must be reaped before submitting more
+                return {};
             case EBADR: // this is an unrecoverable error from our part
                 std::abort();
-            // TODO: case EAGAIN
             default:
-                return tcx::native::result<void>::from_error(-error);
+                return tcx::native::result<void>::from_error(-result);
+            }
+        }
+    }
+
+    // must be called with the submission queue lock held
+    [[nodiscard]] bool can_issue() const noexcept
+    {
+        return this->has_feature(IORING_FEAT_NODROP) || m_pending.load(std::memory_order_relaxed) - m_backlog.size() < this->m_uring.cq.ring_entries;
+    }
+
+    // must be called with the submission queue lock held
+    void flush_backlog() noexcept
+    {
+        while (!m_backlog.empty() && can_issue()) {
+            std::size_t const length = impl::chain_length(m_backlog);
+            if (io_uring_sq_space_left(&this->m_uring) < length)
+                break;
+            for (std::size_t i = 0; i < length; ++i) {
+                impl::copy_sqe(this->m_uring, io_uring_get_sqe(&this->m_uring), m_backlog.front().get());
+                m_backlog.pop_front();
             }
         }
-        return {};
     }
 
 public:
@@ -906,25 +1698,102 @@ public:
         return submit_many({ &submission, 1 });
     }
 
+    /**
+     * @brief queues operations to be submitted to the kernel, in order
+
+     * This never enters the kernel, see `tcx::unsynchronized_uring_context::submit_one()`.
+     */
     native::result<void> submit_many(std::span<io_uring_sqe const *const> submissions) noexcept
     {
         std::unique_lock sq_lock(m_sq_mutex);
-        io_uring_sqe *sqe;
 
-        for (auto submission : submissions) {
-            while ((sqe = io_uring_get_sqe(&this->m_uring)) == nullptr) {
-                if (auto result = submit_to_kernel(); result.has_error())
-                    return result;
+        // either all of them go to the submission queue, or all of them go to the backlog, so that linked operations stay together
+        if (m_backlog.empty() && can_issue() && io_uring_sq_space_left(&this->m_uring) >= submissions.size()) [[likely]] {
+            for (auto submission : submissions)
+                impl::copy_sqe(this->m_uring, io_uring_get_sqe(&this->m_uring), submission);
+        } else {
+            this->m_statistics.on_sq_full();
+            std::size_t const size = m_backlog.size();
+            try {
+                for (auto submission : submissions)
+                    m_backlog.emplace_back().assign(this->m_uring, submission);
+            } catch (std::bad_alloc const &) {
+                m_backlog.resize(size);
+                return tcx::native::result<void>::from_error(ENOMEM);
             }
-            std::size_t const shift = static_cast<bool>(this->m_uring.flags & IORING_SETUP_SQE128);
-            std::memcpy(sqe, submission, sizeof(*submission) << shift);
         }
+        m_pending.fetch_add(submissions.size(), std::memory_order_relaxed);
         return {};
     }
 
+    /**
+     * @brief submits the queued operations, waits for `wait_nr` completions, and invokes the available completions
+
+     * Only one thread reaps at a time, but the completions are invoked without holding any lock,
+     * so other threads can submit, and reap, while they run.
+
+     * @return number of completion queue entries processed
+     */
+    native::result<std::size_t> run_once(std::uint32_t wait_nr = 1)
+    {
+        constexpr std::size_t batch_size = 32;
+        impl::cqe_storage completions[batch_size];
+        std::size_t seen = 0;
+        {
+            std::unique_lock cq_lock(m_cq_mutex);
+            {
+                std::unique_lock sq_lock(m_sq_mutex);
+                flush_backlog();
+                if (auto result = submit_to_kernel(); result.has_error())
+                    return native::result<std::size_t>::from_error(result.error());
+                // an operation left in the backlog may be the one completing those in flight, submit until it fits
+                while (!m_backlog.empty() && io_uring_sq_ready(&this->m_uring) == 0) {
+                    std::size_t const backlog = m_backlog.size();
+                    flush_backlog();
+                    if (m_backlog.size() == backlog)
+                        break;
+                    if (auto result = submit_to_kernel(); result.has_error())
+                        return native::result<std::size_t>::from_error(result.error());
+                }
+                if (m_pending.load(std::memory_order_relaxed) == m_backlog.size())
+                    wait_nr = 0; // nothing in flight, waiting would block forever
+            }
+
+            if (wait_nr != 0) {
+                io_uring_cqe *cqe;
+                if (int const error = io_uring_wait_cqe_nr(&this->m_uring, &cqe, wait_nr); error < 0 && error != -EINTR && error != -ETIME)
+                    return native::result<std::size_t>::from_error(-error);
+            }
+
+            unsigned head;
+            io_uring_cqe *cqe;
+            io_uring_for_each_cqe(&this->m_uring, head, cqe)
+            {
+                if (seen == batch_size)
+                    break;
+                completions[seen++].assign(this->m_uring, cqe);
+            }
+            io_uring_cq_advance(&this->m_uring, static_cast<unsigned>(seen));
+        }
+
+        for (std::size_t i = 0; i < seen; ++i) {
+            if (impl::ends_operation(completions[i].get()))
+                m_pending.fetch_sub(1, std::memory_order_release);
+        }
+        {
+            std::unique_lock sq_lock(m_sq_mutex);
+            flush_backlog();
+        }
+
+        for (std::size_t i = 0; i < seen; ++i)
+            this->complete(completions[i].get());
+        return native::result<std::size_t>::from_value(seen);
+    }
+
     native::result<void> wait_one(io_uring_cqe *completion) noexcept
     {
-        return wait_many({ &completion, 1 }, 1);
+        std::span<io_uring_cqe *const> completions { &completion, 1 };
+        return wait_many(completions, 1);
     }
 
     native::result<void> wait_many(std::span<io_uring_cqe *const> &completions, std::uint32_t wait_nr) noexcept
@@ -933,12 +1802,13 @@ public:
         std::unique_lock cq_lock(m_cq_mutex);
         {
             std::unique_lock sq_lock(m_sq_mutex);
+            flush_backlog();
             if (auto result = submit_to_kernel(); result.has_error())
                 return result;
         }
 
         io_uring_cqe *cqe;
-        if (int const error = io_uring_wait_cqe_nr(&this->m_uring, &cqe, wait_nr); error != 0) {
+        if (int const error = io_uring_wait_cqe_nr(&this->m_uring, &cqe, wait_nr); error < 0) {
             return native::result<void>::from_error(-error);
         }
 
@@ -950,16 +1820,24 @@ public:
                 break;
             std::size_t const shift = static_cast<bool>(this->m_uring.flags & IORING_SETUP_CQE32);
             std::memcpy(completions[seen], cqe, sizeof(*cqe) << shift);
+            if (impl::ends_operation(cqe))
+                m_pending.fetch_sub(1, std::memory_order_release);
             ++seen;
         }
         io_uring_cq_advance(&this->m_uring, seen);
+        completions = std::span<io_uring_cqe *const> { completions.data(), seen };
+        {
+            std::unique_lock sq_lock(m_sq_mutex);
+            flush_backlog();
+        }
         return {};
     }
 
 private:
     std::atomic_size_t m_pending = 0;
-    std::mutex m_sq_mutex;
+    mutable std::mutex m_sq_mutex;
     std::mutex m_cq_mutex;
+    std::deque<impl::sqe_storage, backlog_allocator> m_backlog { backlog_allocator(this->get_allocator()) };
 };
 
 } // namespace tcx
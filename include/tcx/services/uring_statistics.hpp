@@ -0,0 +1,273 @@
+#ifndef TCX_SERVICES_URING_STATISTICS_HPP
+#define TCX_SERVICES_URING_STATISTICS_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <liburing.h>
+
+/**
+ * @def TCX_URING_STATS
+ * @brief when non-zero, io_uring contexts record per-opcode statistics
+ * @ingroup ioring_service
+ * Enabled with the `WITH_URING_STATS` CMake option, when disabled the statistics types are empty and every hook compiles to nothing.
+ */
+#ifndef TCX_URING_STATS
+#define TCX_URING_STATS 0
+#endif
+
+namespace tcx {
+
+/**
+ * @brief Snapshot of a log-linear latency histogram, in nanoseconds
+ * @ingroup ioring_service
+
+ * Values below `sub_bucket_count` get their own bucket,
+ * every power of two above that is split in `sub_bucket_count` linear buckets,
+ * which bounds the relative error of any reported value to `1 / sub_bucket_count`.
+ */
+struct latency_histogram_snapshot {
+    inline constexpr static unsigned sub_bucket_bits = 3;
+    inline constexpr static unsigned sub_bucket_count = 1u << sub_bucket_bits;
+    // the highest tracked magnitude is 2^36ns (about 68 seconds), anything above that is clamped
+    inline constexpr static unsigned max_magnitude = 36;
+    inline constexpr static std::size_t bucket_count = (max_magnitude - sub_bucket_bits + 1) * sub_bucket_count;
+
+    [[nodiscard]] constexpr static std::size_t bucket_index(std::uint64_t nanoseconds) noexcept
+    {
+        if (nanoseconds < sub_bucket_count)
+            return static_cast<std::size_t>(nanoseconds);
+        unsigned const magnitude = static_cast<unsigned>(std::bit_width(nanoseconds)) - 1;
+        if (magnitude >= max_magnitude)
+            return bucket_count - 1;
+        unsigned const shift = magnitude - sub_bucket_bits;
+        return (shift + 1) * sub_bucket_count + static_cast<std::size_t>((nanoseconds >> shift) - sub_bucket_count);
+    }
+
+    /**
+     * @brief smallest value that falls in the bucket `index`
+     */
+    [[nodiscard]] constexpr static std::uint64_t bucket_lower_bound(std::size_t index) noexcept
+    {
+        if (index < sub_bucket_count)
+            return index;
+        std::size_t const shift = index / sub_bucket_count - 1;
+        return (sub_bucket_count + index % sub_bucket_count) << shift;
+    }
+
+    [[nodiscard]] std::uint64_t total() const noexcept
+    {
+        std::uint64_t result = 0;
+        for (auto const count : counts)
+            result += count;
+        return result;
+    }
+
+    /**
+     * @brief returns the value below which `quantile` (in the [0; 1] range) of the recorded values fall
+     */
+    [[nodiscard]] std::uint64_t percentile(double quantile) const noexcept
+    {
+        std::uint64_t const count = total();
+        if (count == 0)
+            return 0;
+        auto const rank = static_cast<std::uint64_t>(quantile * static_cast<double>(count - 1)) + 1;
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < bucket_count; ++i) {
+            seen += counts[i];
+            if (seen >= rank)
+                return i + 1 < bucket_count ? bucket_lower_bound(i + 1) - 1 : bucket_lower_bound(i);
+        }
+        return bucket_lower_bound(bucket_count - 1);
+    }
+
+    std::array<std::uint64_t, bucket_count> counts {};
+};
+
+/**
+ * @brief Statistics of a single io_uring opcode
+ * @ingroup ioring_service
+ */
+struct uring_opcode_statistics {
+    std::uint64_t submitted = 0;
+    std::uint64_t completed = 0; // completion queue entries, a multishot operation may complete many times
+    std::uint64_t errors = 0;
+    std::uint64_t bytes = 0; // only counted for operations that transfer data
+    latency_histogram_snapshot latency; // from submission to completion
+};
+
+/**
+ * @brief Point in time copy of the statistics of an io_uring context
+ * @ingroup ioring_service
+
+ * @attention this type is over 100KiB in size, avoid placing it on small stacks
+ */
+struct uring_statistics_snapshot {
+    std::array<uring_opcode_statistics, IORING_OP_LAST> opcodes {};
+    std::uint64_t sq_full_retries = 0; // times a submission found the submission queue full and was kept in the backlog
+    std::uint64_t cq_overflow = 0; // completion queue entries the kernel couldn't post right away
+};
+
+template <bool Enabled>
+class basic_uring_statistics;
+
+/**
+ * @brief statistics recorder used when `TCX_URING_STATS` is disabled, every operation is a no-op
+ */
+template <>
+class basic_uring_statistics<false> {
+public:
+    inline constexpr static bool enabled = false;
+
+    struct record {
+    };
+
+    record make_record(io_uring_sqe const *) noexcept
+    {
+        return {};
+    }
+
+    void on_submit(record const &) noexcept
+    {
+    }
+
+    void on_complete(record const &, io_uring_cqe const *) noexcept
+    {
+    }
+
+    void on_sq_full() noexcept
+    {
+    }
+
+    void snapshot(uring_statistics_snapshot &) const noexcept
+    {
+    }
+};
+
+/**
+ * @brief statistics recorder used when `TCX_URING_STATS` is enabled
+
+ * Every counter is a relaxed atomic, so a snapshot can be taken from any thread while the ring is in use.
+ * The counters are heap allocated so that their address is stable even if the owning context is moved.
+ */
+template <>
+class basic_uring_statistics<true> {
+public:
+    inline constexpr static bool enabled = true;
+
+    struct record {
+        std::uint64_t submit_time;
+        std::uint8_t opcode;
+    };
+
+    /**
+     * @brief stamps `operation`, the record has to be kept with it's completion before it can complete
+     */
+    record make_record(io_uring_sqe const *operation) noexcept
+    {
+        return record { now(), operation->opcode };
+    }
+
+    /**
+     * @brief counts the operation of `r` once it was queued successfully
+     */
+    void on_submit(record const &r) noexcept
+    {
+        m_counters->opcodes[index(r.opcode)].submitted.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void on_complete(record const &r, io_uring_cqe const *cqe) noexcept
+    {
+        auto &op = m_counters->opcodes[index(r.opcode)];
+        op.completed.fetch_add(1, std::memory_order_relaxed);
+        if (cqe->res < 0)
+            op.errors.fetch_add(1, std::memory_order_relaxed);
+        else if (transfers_data(r.opcode))
+            op.bytes.fetch_add(static_cast<std::uint64_t>(cqe->res), std::memory_order_relaxed);
+        op.latency[latency_histogram_snapshot::bucket_index(now() - r.submit_time)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void on_sq_full() noexcept
+    {
+        m_counters->sq_full_retries.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void snapshot(uring_statistics_snapshot &out) const noexcept
+    {
+        for (std::size_t i = 0; i < out.opcodes.size(); ++i) {
+            auto const &op = m_counters->opcodes[i];
+            out.opcodes[i].submitted = op.submitted.load(std::memory_order_relaxed);
+            out.opcodes[i].completed = op.completed.load(std::memory_order_relaxed);
+            out.opcodes[i].errors = op.errors.load(std::memory_order_relaxed);
+            out.opcodes[i].bytes = op.bytes.load(std::memory_order_relaxed);
+            for (std::size_t j = 0; j < latency_histogram_snapshot::bucket_count; ++j)
+                out.opcodes[i].latency.counts[j] = op.latency[j].load(std::memory_order_relaxed);
+        }
+        out.sq_full_retries = m_counters->sq_full_retries.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct opcode_counters {
+        std::atomic_uint64_t submitted = 0;
+        std::atomic_uint64_t completed = 0;
+        std::atomic_uint64_t errors = 0;
+        std::atomic_uint64_t bytes = 0;
+        std::array<std::atomic_uint64_t, latency_histogram_snapshot::bucket_count> latency {};
+    };
+
+    struct counters {
+        std::array<opcode_counters, IORING_OP_LAST> opcodes {};
+        std::atomic_uint64_t sq_full_retries = 0;
+    };
+
+    static std::uint64_t now() noexcept
+    {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // opcodes unknown at compile time are accounted as the last known one
+    constexpr static std::size_t index(std::uint8_t opcode) noexcept
+    {
+        return opcode < IORING_OP_LAST ? opcode : IORING_OP_LAST - 1;
+    }
+
+    constexpr static bool transfers_data(std::uint8_t opcode) noexcept
+    {
+        switch (opcode) {
+        case IORING_OP_READV:
+        case IORING_OP_WRITEV:
+        case IORING_OP_READ_FIXED:
+        case IORING_OP_WRITE_FIXED:
+        case IORING_OP_SENDMSG:
+        case IORING_OP_RECVMSG:
+        case IORING_OP_READ:
+        case IORING_OP_WRITE:
+        case IORING_OP_SEND:
+        case IORING_OP_RECV:
+        case IORING_OP_SEND_ZC:
+        case IORING_OP_SENDMSG_ZC:
+        case IORING_OP_SPLICE:
+        case IORING_OP_TEE:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    std::unique_ptr<counters> m_counters = std::make_unique<counters>();
+};
+
+/**
+ * @brief statistics recorder used by the io_uring contexts
+ * @ingroup ioring_service
+ */
+using uring_statistics = basic_uring_statistics<static_cast<bool>(TCX_URING_STATS)>;
+
+} // namespace tcx
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef TCX_STRAND_HPP
+#define TCX_STRAND_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <tcx/unique_function.hpp>
+
+namespace tcx {
+
+namespace impl {
+
+    // the strand being drained by this thread, if any
+    inline thread_local void const *current_strand = nullptr;
+
+} // namespace impl
+
+/**
+ * @brief An executor running the handlers posted to it one at a time and in order, on another executor
+ *
+ * Handlers of a strand never run concurrently, even if the executor underneath runs handlers on many threads,
+ * so the state they share doesn't need a lock.
+ * The handlers are queued in a lock free list, and only the post that finds it empty posts to the executor,
+ * the handler it posts then runs up to `batch` of the queued handlers, and posts itself again if there's more left,
+ * so the other work of the executor isn't kept waiting by a busy strand.
+ * ```cpp
+ * tcx::thread_pool pool(4);
+ * tcx::strand connection(pool);
+ * tcx::async_recv(connection, service, fd, buffer, size, handler);
+ * ```
+ *
+ * The strand must outlive the handlers posted to it and can't be destroyed by one of them,
+ * destroying it destroys the queued handlers without running them.
+ */
+template <typename Executor>
+class strand {
+public:
+    using executor_type = Executor;
+    using function_storage = tcx::unique_function<void()>;
+
+    static constexpr std::size_t default_batch = 32;
+
+    explicit strand(executor_type &executor, std::size_t batch = default_batch) noexcept
+        : m_executor(executor)
+        , m_batch(std::max<std::size_t>(batch, 1))
+    {
+    }
+
+    strand(strand const &) = delete;
+    strand(strand &&) = delete;
+
+    strand &operator=(strand const &) = delete;
+    strand &operator=(strand &&) = delete;
+
+    ~strand()
+    {
+        for (node *n = m_head->next.load(std::memory_order_relaxed); n != nullptr;) {
+            node *const next = n->next.load(std::memory_order_relaxed);
+            if (n != &m_stub)
+                delete n;
+            n = next;
+        }
+        if (m_head != &m_stub)
+            delete m_head;
+    }
+
+    /**
+     * @brief queues the handler, can be called from any thread if posting to the executor can
+     */
+    template <typename F>
+    void post(F &&f) requires(std::is_invocable_r_v<void, F>)
+    {
+        push(new node { function_storage(std::forward<F>(f)) });
+        // only the post finding the strand idle schedules it
+        if (m_count.fetch_add(1, std::memory_order_acq_rel) == 0)
+            schedule();
+    }
+
+    /**
+     * @brief true if called from a handler of this strand
+     */
+    [[nodiscard]] bool running_in_this_thread() const noexcept
+    {
+        return impl::current_strand == this;
+    }
+
+    [[nodiscard]] executor_type &executor() const noexcept
+    {
+        return m_executor;
+    }
+
+private:
+    struct node {
+        explicit node(function_storage function = nullptr) noexcept
+            : f(std::move(function))
+        {
+        }
+
+        std::atomic<node *> next = nullptr;
+        function_storage f;
+    };
+
+    // marks the strand as run by this thread for as long as it's alive
+    struct running_guard {
+        explicit running_guard(strand *self) noexcept
+            : self(self)
+            , previous(std::exchange(impl::current_strand, self))
+        {
+        }
+
+        running_guard(running_guard const &) = delete;
+        running_guard &operator=(running_guard const &) = delete;
+
+        // also runs when a handler throws, so the strand isn't left thinking it's scheduled
+        ~running_guard()
+        {
+            impl::current_strand = previous;
+            if (self->m_count.fetch_sub(ran, std::memory_order_acq_rel) != ran)
+                self->schedule();
+        }
+
+        strand *self;
+        void const *previous;
+        std::size_t ran = 0;
+    };
+
+    void schedule()
+    {
+        m_executor.post([this] { drain(); });
+    }
+
+    void drain()
+    {
+        running_guard guard(this);
+        // only handlers counted when it started are taken, those are already linked or about to be
+        std::size_t const available = std::min(m_count.load(std::memory_order_acquire), m_batch);
+        while (guard.ran != available) {
+            node *const n = pop();
+            function_storage f = std::move(n->f);
+            delete n;
+            ++guard.ran;
+            f();
+        }
+    }
+
+    // any thread
+    void push(node *n) noexcept
+    {
+        n->next.store(nullptr, std::memory_order_relaxed);
+        node *const previous = m_tail.exchange(n, std::memory_order_acq_rel);
+        // until this store the node is queued but not reachable, pop() waits for it
+        previous->next.store(n, std::memory_order_release);
+    }
+
+    // only the draining thread, when there's at least one counted node
+    node *pop() noexcept
+    {
+        for (;;) {
+            node *head = m_head;
+            node *next = head->next.load(std::memory_order_acquire);
+            if (head == &m_stub) {
+                if (next == nullptr) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                m_head = next;
+                head = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+            if (next != nullptr) {
+                m_head = next;
+                return head;
+            }
+            if (head != m_tail.load(std::memory_order_acquire)) {
+                // a push swapped the tail but hasn't linked it yet
+                std::this_thread::yield();
+                continue;
+            }
+            // the last node can't be taken while it's the tail, the stub goes after it
+            push(&m_stub);
+            next = head->next.load(std::memory_order_acquire);
+            if (next != nullptr) {
+                m_head = next;
+                return head;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    executor_type &m_executor;
+    std::size_t m_batch;
+    node m_stub;
+    // only touched by the draining thread
+    node *m_head = &m_stub;
+    alignas(64) std::atomic<node *> m_tail = &m_stub;
+    // handlers posted and not yet ran, whoever makes it leave 0 schedules the strand
+    alignas(64) std::atomic_size_t m_count = 0;
+};
+
+template <typename E>
+strand(E &) -> strand<E>;
+
+template <typename E>
+strand(E &, std::size_t) -> strand<E>;
+
+} // namespace tcx
+
+#endif
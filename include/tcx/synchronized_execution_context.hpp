@@ -3,17 +3,52 @@
 
 #include <oneapi/tbb/concurrent_queue.h>
 
-#include <tcx/unique_function.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <type_traits>
 
+#include <tcx/priority.hpp>
+#include <tcx/unique_function.hpp>
+
 namespace tcx {
 
+/**
+ * @brief what a thread waiting for handlers does before blocking
+ *
+ * It first checks the queue `spins` times, with a pause between checks,
+ * then `yields` times, yielding it's time slice between checks, and then it blocks until a handler is posted.
+ */
+struct idle_policy {
+    unsigned spins = 128;
+    unsigned yields = 8;
+};
+
+/**
+ * @brief a queue of handlers, run by every thread calling `run()`
+ *
+ * Like `tcx::unsynchronized_execution_context`, handlers are queued in one of `lanes` lanes picked by their `tcx::priority`,
+ * and a lane skipped `aging_limit` times runs next.
+ * The counts are shared by every thread running it, so with many of them the limit is only roughly kept.
+ */
 class synchronized_execution_context {
 public:
     using function_storage = tcx::unique_function<void()>;
     static_assert(std::is_default_constructible_v<function_storage>, "function_storage type must be default constructible");
 
-    synchronized_execution_context() = default;
+    synchronized_execution_context()
+        : synchronized_execution_context(1)
+    {
+    }
+
+    explicit synchronized_execution_context(idle_policy policy)
+        : synchronized_execution_context(1, policy)
+    {
+    }
+
+    explicit synchronized_execution_context(std::size_t lanes, idle_policy policy = {}, std::size_t aging_limit = tcx::default_aging_limit);
 
     synchronized_execution_context(synchronized_execution_context const &) = delete;
     synchronized_execution_context(synchronized_execution_context &&) = delete;
@@ -21,18 +56,119 @@ public:
     synchronized_execution_context &operator=(synchronized_execution_context const &) = delete;
     synchronized_execution_context &operator=(synchronized_execution_context &&other) noexcept = delete;
 
+    /**
+     * @brief queues the handler, and wakes one blocked thread if there's any
+     *
+     * No system call is made while every thread running the context is busy.
+     */
     template <typename F>
     void post(F &&f) requires(std::is_invocable_r_v<void, F>)
     {
-        m_function_queue.emplace(std::forward<F>(f));
+        post(tcx::normal_priority, std::forward<F>(f));
+    }
+
+    /**
+     * @brief same as `post(f)`, but queues the handler in the lane `priority`
+     */
+    template <typename F>
+    void post(tcx::priority priority, F &&f) requires(std::is_invocable_r_v<void, F>)
+    {
+        m_lanes[std::min<std::size_t>(priority, m_lane_count - 1)].emplace(std::forward<F>(f));
+        // pairs with the fence of a thread about to block, either it sees the handler or we see it blocking
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_parked.load(std::memory_order_relaxed) != 0)
+            wake_one();
     }
 
-    [[nodiscard]] std::size_t run();
+    /**
+     * @brief runs handlers, waiting for more when there's none, until `stop()` is called
+     * @return the number of handlers ran
+     */
+    std::size_t run();
+
+    /**
+     * @brief runs handlers, waiting for more when there's none, until `stop()` is called or `duration` elapses
+     * @return the number of handlers ran
+     */
+    template <typename Rep, typename Period>
+    std::size_t run_for(std::chrono::duration<Rep, Period> duration)
+    {
+        return run_until(std::chrono::steady_clock::now() + duration);
+    }
+
+    /**
+     * @brief runs handlers, waiting for more when there's none, until `stop()` is called or `time` is reached
+     * @return the number of handlers ran
+     */
+    template <typename Clock, typename Duration>
+    std::size_t run_until(std::chrono::time_point<Clock, Duration> time)
+    {
+        if constexpr (std::is_same_v<Clock, std::chrono::steady_clock>) {
+            auto const deadline = std::chrono::time_point_cast<std::chrono::steady_clock::duration>(time);
+            return run(&deadline);
+        } else {
+            auto const deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(time - Clock::now());
+            return run(&deadline);
+        }
+    }
+
+    /**
+     * @brief runs the queued handlers without waiting, whether the context is stopped or not
+     * @return the number of handlers ran
+     */
+    std::size_t poll();
+
+    /**
+     * @brief makes every `run()`, `run_for()` and `run_until()` return once their current handler finishes
+     *
+     * They keep returning right away until `restart()` is called.
+     */
+    void stop() noexcept;
+
+    [[nodiscard]] bool stopped() const noexcept
+    {
+        return m_stopped.load(std::memory_order_relaxed);
+    }
+
+    void restart() noexcept
+    {
+        m_stopped.store(false, std::memory_order_relaxed);
+    }
+
+    void set_idle_policy(idle_policy policy) noexcept
+    {
+        m_policy = policy;
+    }
+
+    [[nodiscard]] std::size_t lanes() const noexcept
+    {
+        return m_lane_count;
+    }
+
+    /**
+     * @brief true if called from a handler run by this context
+     */
+    [[nodiscard]] bool running_in_this_thread() const noexcept;
 
     ~synchronized_execution_context() = default;
 
 private:
-    oneapi::tbb::concurrent_queue<function_storage> m_function_queue;
+    std::size_t run(std::chrono::steady_clock::time_point const *deadline);
+    bool wait(std::chrono::steady_clock::time_point const *deadline);
+    void wake_one() noexcept;
+    bool try_pop(function_storage &f);
+    [[nodiscard]] bool empty() const;
+
+    std::size_t m_lane_count;
+    std::size_t m_aging_limit;
+    std::unique_ptr<oneapi::tbb::concurrent_queue<function_storage>[]> m_lanes;
+    // times each lane was skipped while it had handlers waiting
+    std::unique_ptr<std::atomic_size_t[]> m_starved;
+    idle_policy m_policy;
+    // blocked threads wait for it to change
+    alignas(64) std::atomic_uint32_t m_epoch = 0;
+    std::atomic_uint32_t m_parked = 0;
+    std::atomic_bool m_stopped = false;
 };
 
 } // namespace tcx
@@ -0,0 +1,233 @@
+#ifndef TCX_THREAD_POOL_HPP
+#define TCX_THREAD_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <tcx/affinity.hpp>
+#include <tcx/unique_function.hpp>
+
+namespace tcx {
+
+namespace impl {
+
+    /**
+     * @brief Chase-Lev work stealing deque of pointers
+     *
+     * Only the owner pushes and pops, at the bottom, any thread steals from the top.
+     * @see [_Correct and Efficient Work-Stealing for Weak Memory Models_](https://fzn.fr/readings/ppopp13.pdf)
+     */
+    template <typename T>
+    class work_stealing_deque {
+        struct array {
+            explicit array(std::size_t capacity)
+                : mask(capacity - 1)
+                , slots(std::make_unique<std::atomic<T *>[]>(capacity))
+            {
+            }
+
+            [[nodiscard]] std::size_t capacity() const noexcept
+            {
+                return mask + 1;
+            }
+
+            [[nodiscard]] T *get(std::int64_t index) const noexcept
+            {
+                return slots[static_cast<std::size_t>(index) & mask].load(std::memory_order_relaxed);
+            }
+
+            void put(std::int64_t index, T *value) noexcept
+            {
+                slots[static_cast<std::size_t>(index) & mask].store(value, std::memory_order_relaxed);
+            }
+
+            std::size_t mask;
+            std::unique_ptr<std::atomic<T *>[]> slots;
+        };
+
+    public:
+        explicit work_stealing_deque(std::size_t capacity = 256)
+        {
+            m_arrays.push_back(std::make_unique<array>(capacity));
+            m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+        }
+
+        work_stealing_deque(work_stealing_deque const &) = delete;
+        work_stealing_deque &operator=(work_stealing_deque const &) = delete;
+
+        // owner only
+        void push(T *value)
+        {
+            std::int64_t const bottom = m_bottom.load(std::memory_order_relaxed);
+            std::int64_t const top = m_top.load(std::memory_order_acquire);
+            array *current = m_array.load(std::memory_order_relaxed);
+            if (bottom - top > static_cast<std::int64_t>(current->capacity()) - 1)
+                current = grow(current, top, bottom);
+            current->put(bottom, value);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+
+        // owner only
+        T *pop() noexcept
+        {
+            std::int64_t const bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+            array *const current = m_array.load(std::memory_order_relaxed);
+            m_bottom.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::int64_t top = m_top.load(std::memory_order_relaxed);
+            if (top > bottom) {
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            T *value = current->get(bottom);
+            if (top == bottom) {
+                // the last one, racing the thieves for it
+                if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    value = nullptr;
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+            return value;
+        }
+
+        // any thread, returns null when empty or when losing a race
+        T *steal() noexcept
+        {
+            std::int64_t top = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::int64_t const bottom = m_bottom.load(std::memory_order_acquire);
+            if (top >= bottom)
+                return nullptr;
+            T *const value = m_array.load(std::memory_order_acquire)->get(top);
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+            return value;
+        }
+
+        [[nodiscard]] bool empty() const noexcept
+        {
+            return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+        }
+
+    private:
+        array *grow(array *current, std::int64_t top, std::int64_t bottom)
+        {
+            auto grown = std::make_unique<array>(current->capacity() * 2);
+            for (std::int64_t i = top; i < bottom; ++i)
+                grown->put(i, current->get(i));
+            // thieves may still be reading the old array, it's kept until the deque is destroyed
+            m_arrays.push_back(std::move(grown));
+            m_array.store(m_arrays.back().get(), std::memory_order_release);
+            return m_arrays.back().get();
+        }
+
+        alignas(64) std::atomic<std::int64_t> m_top = 0;
+        alignas(64) std::atomic<std::int64_t> m_bottom = 0;
+        std::atomic<array *> m_array;
+        std::vector<std::unique_ptr<array>> m_arrays;
+    };
+
+} // namespace impl
+
+/**
+ * @brief An executor running the posted handlers on a fixed set of threads, with a work stealing queue per thread
+ *
+ * Handlers posted from one of the threads of the pool are run by that same thread, the last one posted first,
+ * so a completion runs where the handler that started the operation ran, while the data it touched is still in cache.
+ * Threads without work steal the oldest handlers of a random other thread, and handlers posted
+ * from any other thread go to a shared queue every worker takes from.
+ *
+ * Idle workers block, and are woken one at a time as handlers are posted.
+ * Destroying the pool stops the workers once they finish the handler they are running,
+ * the handlers still queued are destroyed without being run.
+ */
+class thread_pool {
+public:
+    using function_storage = tcx::unique_function<void()>;
+
+    /**
+     * @param threads number of workers, 0 for one per hardware thread
+     */
+    explicit thread_pool(std::size_t threads = 0);
+
+    /**
+     * @brief one worker per CPU in `cpus`, each pinned to it's CPU
+     * @throws std::system_error if a worker can't be pinned
+     */
+    explicit thread_pool(tcx::cpu_set const &cpus);
+
+    /**
+     * @brief one worker per set in `affinities`, each restricted to the CPUs of it's set
+     *
+     * A worker whose CPUs are all in one NUMA node also prefers that node for the memory it allocates,
+     * so the handlers posted from it, and the queue they go to, are allocated next to it.
+     * @throws std::system_error if a worker can't be pinned
+     */
+    explicit thread_pool(std::span<tcx::cpu_set const> affinities);
+
+    thread_pool(thread_pool const &) = delete;
+    thread_pool(thread_pool &&) = delete;
+
+    thread_pool &operator=(thread_pool const &) = delete;
+    thread_pool &operator=(thread_pool &&) = delete;
+
+    ~thread_pool();
+
+    template <typename F>
+    void post(F &&f) requires(std::is_invocable_r_v<void, F>)
+    {
+        schedule(new function_storage(std::forward<F>(f)));
+    }
+
+    /**
+     * @brief the number of workers
+     */
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return m_workers.size();
+    }
+
+    /**
+     * @brief true if called from a handler run by this pool
+     */
+    [[nodiscard]] bool running_in_this_thread() const noexcept;
+
+    /**
+     * @brief stops the workers and waits for them, the handlers still queued are destroyed
+     */
+    void stop() noexcept;
+
+private:
+    struct worker;
+
+    void start(std::span<tcx::cpu_set const> affinities);
+    void schedule(function_storage *task);
+    void work(worker &self);
+    function_storage *find(worker &self);
+    function_storage *steal(worker &self);
+    function_storage *take_injected();
+    void wake_one() noexcept;
+
+    std::vector<std::unique_ptr<worker>> m_workers;
+
+    std::mutex m_injected_mutex;
+    std::deque<function_storage *> m_injected;
+    std::atomic_size_t m_injected_size = 0;
+
+    // sleeping workers wait for it to change, posting changes it only if someone sleeps
+    alignas(64) std::atomic_uint32_t m_epoch = 0;
+    std::atomic_size_t m_sleeping = 0;
+    std::atomic_bool m_stopping = false;
+};
+
+} // namespace tcx
+
+#endif
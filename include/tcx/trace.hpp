@@ -0,0 +1,220 @@
+#ifndef TCX_TRACE_HPP
+#define TCX_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <type_traits>
+#include <utility>
+
+#include <tcx/dispatch.hpp>
+#include <tcx/priority.hpp>
+
+/**
+ * @def TCX_TRACE
+ * @brief when non-zero, the io_uring contexts and wrappers record operation lifecycle events
+ * Enabled with the `WITH_TRACE` CMake option, when disabled every hook compiles to nothing.
+ * Even when enabled, nothing is recorded until `tcx::trace::start()` is called.
+ */
+#ifndef TCX_TRACE
+#define TCX_TRACE 0
+#endif
+
+/**
+ * @def TCX_TRACE_BUFFER_SIZE
+ * @brief number of events each thread keeps before overwriting the oldest ones, must be a power of two
+ */
+#ifndef TCX_TRACE_BUFFER_SIZE
+#define TCX_TRACE_BUFFER_SIZE 65536
+#endif
+
+/**
+ * @brief Operation lifecycle tracing
+ *
+ * Every thread records into it's own ring of events, so recording is lock-free and takes a couple dozen nanoseconds.
+ * The recorded events can be exported as Chrome trace JSON, viewable in `chrome://tracing` or [Perfetto](https://ui.perfetto.dev).
+ *
+ * The lifetime of an operation is split in:
+ * - *in flight*: from the submission until the completion is reaped, this includes the time waiting in the submission queue,
+ *   which can be told apart using the `io_uring_enter` slices of the submitting thread
+ * - *queued*: from the completion posting the handler to the executor, until the executor runs it
+ * - *handler*: while the handler runs
+ */
+namespace tcx::trace {
+
+inline constexpr bool enabled = static_cast<bool>(TCX_TRACE);
+inline constexpr std::size_t buffer_size = TCX_TRACE_BUFFER_SIZE;
+
+static_assert(buffer_size != 0 && (buffer_size & (buffer_size - 1)) == 0, "TCX_TRACE_BUFFER_SIZE must be a power of two");
+
+enum class event_type : std::uint8_t {
+    submit, // value is the opcode
+    complete, // value is the result, flags are the completion queue entry flags
+    post,
+    handler_begin,
+    handler_end,
+    enter_begin, // value is the number of entries ready to be submitted
+    enter_end, // value is the result of the system call
+};
+
+struct event {
+    std::uint64_t timestamp; // nanoseconds, from std::chrono::steady_clock
+    std::uint64_t id; // the user_data of the operation
+    std::int64_t value;
+    std::uint32_t flags;
+    event_type type;
+};
+
+namespace impl {
+
+    struct thread_buffer {
+        std::uint32_t thread_index;
+        std::atomic_uint64_t head = 0; // events written since the thread started recording
+        event events[buffer_size];
+    };
+
+    inline std::atomic_bool recording = false;
+    inline thread_local thread_buffer *local_buffer = nullptr;
+
+    thread_buffer *register_thread();
+
+    inline std::uint64_t now() noexcept
+    {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+} // namespace impl
+
+/**
+ * @brief starts recording events on every thread
+ */
+inline void start() noexcept
+{
+    impl::recording.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * @brief stops recording events, the events recorded so far are kept until `tcx::trace::clear()`
+ */
+inline void stop() noexcept
+{
+    impl::recording.store(false, std::memory_order_relaxed);
+}
+
+[[nodiscard]] inline bool is_recording() noexcept
+{
+    return enabled && impl::recording.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief records an event in the ring of the calling thread
+ */
+inline void record(event_type type, std::uint64_t id, std::int64_t value = 0, std::uint32_t flags = 0) noexcept
+{
+    if constexpr (enabled) {
+        if (!impl::recording.load(std::memory_order_relaxed))
+            return;
+        auto *buffer = impl::local_buffer;
+        if (buffer == nullptr) [[unlikely]] {
+            buffer = impl::register_thread();
+            if (buffer == nullptr)
+                return;
+        }
+        auto const head = buffer->head.load(std::memory_order_relaxed);
+        buffer->events[head & (buffer_size - 1)] = event { impl::now(), id, value, flags, type };
+        buffer->head.store(head + 1, std::memory_order_release);
+    }
+}
+
+namespace impl {
+
+    // wraps `f` to record when it starts and when it ends
+    template <typename F>
+    auto traced(std::uint64_t id, F &&f)
+    {
+        return [id, f = std::forward<F>(f)]() mutable {
+            struct end_guard {
+                std::uint64_t id;
+                ~end_guard()
+                {
+                    record(event_type::handler_end, id);
+                }
+            };
+            record(event_type::handler_begin, id);
+            end_guard guard { id };
+            return f();
+        };
+    }
+
+} // namespace impl
+
+/**
+ * @brief posts `f` to `executor`, recording how long it waited and how long it ran
+
+ * Used by the asynchronous operations to trace the hop from the completion to the executor.
+ */
+template <typename E, typename F>
+decltype(auto) post(E &executor, std::uint64_t id, F &&f)
+{
+    if constexpr (enabled) {
+        record(event_type::post, id);
+        return executor.post(impl::traced(id, std::forward<F>(f)));
+    } else {
+        return executor.post(std::forward<F>(f));
+    }
+}
+
+/**
+ * @brief posts `f` to the lane `priority` of `executor`, recording how long it waited and how long it ran
+ */
+template <typename E, typename F>
+decltype(auto) post(E &executor, std::uint64_t id, tcx::priority priority, F &&f)
+{
+    if constexpr (enabled) {
+        record(event_type::post, id);
+        return tcx::impl::post(executor, priority, impl::traced(id, std::forward<F>(f)));
+    } else {
+        return tcx::impl::post(executor, priority, std::forward<F>(f));
+    }
+}
+
+/**
+ * @brief same as `post()`, but `f` runs right away if `executor` is running on this thread
+
+ * An `id` of 0 means there's no completion, the operation finished while being started,
+ * so `f` is always posted to not run the handler inside the function starting it.
+ * @see tcx::impl::dispatch
+ */
+template <typename E, typename F>
+void dispatch(E &executor, std::uint64_t id, tcx::priority priority, F &&f)
+{
+    if (id == 0) {
+        post(executor, id, priority, std::forward<F>(f));
+    } else if constexpr (enabled) {
+        record(event_type::post, id);
+        tcx::impl::dispatch(executor, priority, impl::traced(id, std::forward<F>(f)));
+    } else {
+        tcx::impl::dispatch(executor, priority, std::forward<F>(f));
+    }
+}
+
+/**
+ * @brief writes every recorded event as Chrome trace JSON
+
+ * Events that are being overwritten while exporting are skipped,
+ * stopping the recording first gives a consistent view.
+ * @return false if writing to `file` failed
+ */
+bool write_chrome_trace(std::FILE *file);
+
+/**
+ * @brief discards every recorded event
+ * @attention must not be called while other threads are recording
+ */
+void clear() noexcept;
+
+} // namespace tcx::trace
+
+#endif
@@ -1,40 +1,175 @@
 #ifndef TCX_UNSYNCHRONIZED_EXECUTION_CONTEXT_HPP
 #define TCX_UNSYNCHRONIZED_EXECUTION_CONTEXT_HPP
 
-#include <queue>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+#include <tcx/priority.hpp>
 #include <tcx/unique_function.hpp>
+#include <tcx/utilities/ring_queue.hpp>
 
 namespace tcx {
 
+/**
+ * @brief a queue of handlers, run by the thread calling `run()`
+ *
+ * Handlers are queued in one of `lanes` lanes, picked by their `tcx::priority`.
+ * Lower lanes run first, but once `aging_limit` handlers ran from lower lanes while a higher lane had handlers waiting,
+ * the oldest of them runs next, so no lane waits forever.
+ */
 class unsynchronized_execution_context {
 public:
     using function_storage = tcx::unique_function<void()>;
 
-    unsynchronized_execution_context() = default;
+    unsynchronized_execution_context()
+        : unsynchronized_execution_context(1)
+    {
+    }
+
+    explicit unsynchronized_execution_context(std::size_t lanes, std::size_t aging_limit = tcx::default_aging_limit)
+        : m_lanes(std::max<std::size_t>(lanes, 1))
+        , m_starved(m_lanes.size())
+        , m_aging_limit(aging_limit)
+    {
+    }
 
     unsynchronized_execution_context(unsynchronized_execution_context const &) = delete;
-    unsynchronized_execution_context(unsynchronized_execution_context &&) noexcept = default;
+
+    /**
+     * @brief takes the handlers queued in `other`, which is left empty with as many lanes as before
+     */
+    unsynchronized_execution_context(unsynchronized_execution_context &&other)
+        : unsynchronized_execution_context(other.lanes(), other.m_aging_limit)
+    {
+        swap(other);
+    }
 
     unsynchronized_execution_context &operator=(unsynchronized_execution_context const &) = delete;
-    unsynchronized_execution_context &operator=(unsynchronized_execution_context &&other) noexcept = default;
+
+    /**
+     * @brief drops the handlers queued in this context and takes those of `other`, which is left empty
+     */
+    unsynchronized_execution_context &operator=(unsynchronized_execution_context &&other)
+    {
+        unsynchronized_execution_context taken(std::move(other));
+        swap(taken);
+        return *this;
+    }
+
+    void swap(unsynchronized_execution_context &other) noexcept
+    {
+        using std::swap;
+        swap(m_lanes, other.m_lanes);
+        swap(m_starved, other.m_starved);
+        swap(m_aging_limit, other.m_aging_limit);
+        swap(m_pending, other.m_pending);
+    }
 
     template <typename F>
     void post(F &&f) requires(std::is_invocable_r_v<void, F>)
     {
-        m_function_queue.emplace(std::forward<F>(f));
+        post(tcx::normal_priority, std::forward<F>(f));
+    }
+
+    template <typename F>
+    void post(tcx::priority priority, F &&f) requires(std::is_invocable_r_v<void, F>)
+    {
+        m_lanes[lane(priority)].emplace(std::forward<F>(f));
+        ++m_pending;
+    }
+
+    /**
+     * @brief posts every handler in `handlers` with `tcx::normal_priority`, moving them out of it
+     *
+     * The queue grows once for the whole range when it's size is known.
+     */
+    template <std::ranges::input_range R>
+    void post_bulk(R &&handlers) requires(std::is_invocable_r_v<void, std::ranges::range_reference_t<R>>)
+    {
+        auto &queue = m_lanes[lane(tcx::normal_priority)];
+        if constexpr (std::ranges::sized_range<R>)
+            queue.reserve(queue.size() + std::ranges::size(handlers));
+        for (auto &&f : handlers) {
+            queue.emplace(std::move(f));
+            ++m_pending;
+        }
+    }
+
+    /**
+     * @brief runs as many handlers as were queued when called
+     *
+     * They're picked in lane order like always, so a handler posted while it runs to a lower lane
+     * can take the place of one queued before the call, which is then left for the next call.
+     * Either way a handler posting itself again can't keep it from returning.
+     * @return the number of handlers ran
+     */
+    std::size_t run()
+    {
+        return run(m_pending);
+    }
+
+    /**
+     * @brief runs queued handlers, including the ones they post, until `max_handlers` ran or there's none left
+     * @return the number of handlers ran
+     */
+    std::size_t run(std::size_t max_handlers);
+
+    /**
+     * @brief runs queued handlers, including the ones they post, until `duration` elapses or there's none left
+     *
+     * The clock is only checked every few handlers, so it may overrun by a few of them.
+     * @return the number of handlers ran
+     */
+    template <typename Rep, typename Period>
+    std::size_t run_for(std::chrono::duration<Rep, Period> duration)
+    {
+        return run_until(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+    }
+
+    /**
+     * @brief same as `run()`, nothing else can post while it runs so there's never anything to wait for
+     */
+    std::size_t poll()
+    {
+        return run();
     }
 
-    std::size_t run();
     [[nodiscard]] std::size_t pending() const
     {
-        return m_function_queue.size();
+        return m_pending;
     }
 
+    [[nodiscard]] std::size_t lanes() const noexcept
+    {
+        return m_lanes.size();
+    }
+
+    /**
+     * @brief true if called from a handler run by this context
+     */
+    [[nodiscard]] bool running_in_this_thread() const noexcept;
+
     ~unsynchronized_execution_context() = default;
 
 private:
-    std::queue<function_storage> m_function_queue;
+    [[nodiscard]] std::size_t lane(tcx::priority priority) const noexcept
+    {
+        return std::min<std::size_t>(priority, m_lanes.size() - 1);
+    }
+
+    std::size_t run_until(std::chrono::steady_clock::time_point deadline);
+    std::size_t next_lane() noexcept;
+
+    std::vector<tcx::utilities::ring_queue<function_storage>> m_lanes;
+    // handlers ran from lower lanes since each lane last ran one
+    std::vector<std::size_t> m_starved;
+    std::size_t m_aging_limit;
+    std::size_t m_pending = 0;
 };
 
 }
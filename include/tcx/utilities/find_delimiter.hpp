@@ -0,0 +1,44 @@
+#ifndef TCX_UTILITIES_FIND_DELIMITER_HPP
+#define TCX_UTILITIES_FIND_DELIMITER_HPP
+
+#include <cstddef>
+
+namespace tcx::utilities {
+
+/**
+ * @brief the instruction sets `tcx::utilities::find_delimiter()` can be implemented with
+ */
+enum class find_delimiter_isa {
+    scalar,
+    sse2,
+    avx2,
+};
+
+/**
+ * @brief returned by `tcx::utilities::find_delimiter()` when the delimiter isn't found
+ */
+inline constexpr std::size_t delimiter_not_found = static_cast<std::size_t>(-1);
+
+/**
+ * @brief offset of the first occurrence of the `delimiter_size` bytes at `delimiter` within the `size` bytes at `data`
+ *
+ * Candidates are found by comparing the first and last bytes of the delimiter against whole vectors of `data` at once,
+ * and only those are compared in full, so the cost per byte stays flat with the length of the delimiter.
+ * The widest instruction set supported by the CPU is picked on the first call.
+ * @return the offset, or `tcx::utilities::delimiter_not_found`
+ */
+[[nodiscard]] std::size_t find_delimiter(void const *data, std::size_t size, void const *delimiter, std::size_t delimiter_size) noexcept;
+
+/**
+ * @brief like the above, with the implementation for `isa`, which must be supported by the CPU
+ */
+[[nodiscard]] std::size_t find_delimiter(find_delimiter_isa isa, void const *data, std::size_t size, void const *delimiter, std::size_t delimiter_size) noexcept;
+
+/**
+ * @brief the instruction set `tcx::utilities::find_delimiter()` picked
+ */
+[[nodiscard]] find_delimiter_isa find_delimiter_dispatch() noexcept;
+
+} // namespace tcx::utilities
+
+#endif
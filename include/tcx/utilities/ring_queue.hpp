@@ -0,0 +1,180 @@
+#ifndef TCX_UTILITIES_RING_QUEUE_HPP
+#define TCX_UTILITIES_RING_QUEUE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace tcx::utilities {
+
+/**
+ * @brief FIFO queue stored in a ring of fixed size chunks
+ *
+ * Chunks emptied by `pop()` are reused by `push()` instead of being freed,
+ * so once the queue reached it's high water mark it doesn't allocate anymore.
+ * Elements never move once pushed, and growing only links a new chunk in.
+ *
+ * @tparam ChunkSize elements per chunk, a power of two
+ */
+template <typename T, std::size_t ChunkSize = 64>
+class ring_queue {
+    static_assert(ChunkSize != 0 && (ChunkSize & (ChunkSize - 1)) == 0, "ChunkSize must be a power of two");
+    static constexpr std::size_t mask = ChunkSize - 1;
+
+    struct chunk {
+        chunk *next = this;
+        alignas(T) std::byte storage[sizeof(T) * ChunkSize];
+
+        T *at(std::size_t position) noexcept
+        {
+            return std::launder(reinterpret_cast<T *>(storage) + (position & mask));
+        }
+    };
+
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+
+    ring_queue() noexcept = default;
+
+    ring_queue(ring_queue const &) = delete;
+    ring_queue &operator=(ring_queue const &) = delete;
+
+    ring_queue(ring_queue &&other) noexcept
+        : m_head_chunk(std::exchange(other.m_head_chunk, nullptr))
+        , m_tail_chunk(std::exchange(other.m_tail_chunk, nullptr))
+        , m_head(std::exchange(other.m_head, 0))
+        , m_tail(std::exchange(other.m_tail, 0))
+    {
+    }
+
+    ring_queue &operator=(ring_queue &&other) noexcept
+    {
+        if (this != &other) {
+            release();
+            m_head_chunk = std::exchange(other.m_head_chunk, nullptr);
+            m_tail_chunk = std::exchange(other.m_tail_chunk, nullptr);
+            m_head = std::exchange(other.m_head, 0);
+            m_tail = std::exchange(other.m_tail, 0);
+        }
+        return *this;
+    }
+
+    ~ring_queue()
+    {
+        release();
+    }
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return m_head == m_tail;
+    }
+
+    [[nodiscard]] size_type size() const noexcept
+    {
+        return m_tail - m_head;
+    }
+
+    T &front() noexcept
+    {
+        return *m_head_chunk->at(m_head);
+    }
+
+    template <typename... Args>
+    T &emplace(Args &&...args)
+    {
+        if (m_tail_chunk == nullptr) {
+            m_tail_chunk = new chunk;
+            m_head_chunk = m_tail_chunk;
+        }
+        chunk *target = m_tail_chunk;
+        if (m_tail != 0 && (m_tail & mask) == 0) {
+            // the tail chunk is full, the next one is free unless it's where the head is
+            if (target->next == m_head_chunk)
+                link_after(target);
+            target = target->next;
+        }
+        T *const value = ::new (static_cast<void *>(target->at(m_tail))) T(std::forward<Args>(args)...);
+        m_tail_chunk = target;
+        ++m_tail;
+        return *value;
+    }
+
+    void push(T &&value)
+    {
+        emplace(std::move(value));
+    }
+
+    void pop() noexcept
+    {
+        std::destroy_at(m_head_chunk->at(m_head));
+        ++m_head;
+        if (m_head == m_tail) {
+            // the last one was in the tail chunk, starting over from it's beginning
+            m_head_chunk = m_tail_chunk;
+            m_head = 0;
+            m_tail = 0;
+        } else if ((m_head & mask) == 0) {
+            m_head_chunk = m_head_chunk->next;
+        }
+    }
+
+    /**
+     * @brief links in enough free chunks to hold `count` elements in total without allocating, like `std::vector::reserve()`
+     */
+    void reserve(size_type count)
+    {
+        if (count <= size())
+            return;
+        if (m_tail_chunk == nullptr) {
+            m_tail_chunk = new chunk;
+            m_head_chunk = m_tail_chunk;
+        }
+        // room left in the tail chunk, then in the free chunks after it
+        size_type available = m_tail == 0 || (m_tail & mask) != 0 ? ChunkSize - (m_tail & mask) : 0;
+        chunk *last = m_tail_chunk;
+        while (last->next != m_head_chunk) {
+            last = last->next;
+            available += ChunkSize;
+        }
+        size_type const wanted = count - size();
+        while (available < wanted) {
+            link_after(last);
+            last = last->next;
+            available += ChunkSize;
+        }
+    }
+
+private:
+    static void link_after(chunk *where)
+    {
+        chunk *const created = new chunk;
+        created->next = where->next;
+        where->next = created;
+    }
+
+    void release() noexcept
+    {
+        while (!empty())
+            pop();
+        if (m_head_chunk == nullptr)
+            return;
+        chunk *current = m_head_chunk->next;
+        while (current != m_head_chunk)
+            delete std::exchange(current, current->next);
+        delete m_head_chunk;
+        m_head_chunk = nullptr;
+        m_tail_chunk = nullptr;
+    }
+
+    chunk *m_head_chunk = nullptr;
+    chunk *m_tail_chunk = nullptr;
+    // positions since the queue was last empty, the offset in a chunk is the position masked
+    size_type m_head = 0;
+    size_type m_tail = 0;
+};
+
+} // namespace tcx::utilities
+
+#endif
@@ -0,0 +1,137 @@
+#include <tcx/affinity.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+// parses the `0-3,8,10-11` format of the cpulist files
+tcx::cpu_set parse_cpu_list(std::string_view list)
+{
+    tcx::cpu_set result;
+    while (!list.empty()) {
+        std::size_t const comma = list.find(',');
+        std::string_view const range = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+
+        unsigned first = 0;
+        unsigned last = 0;
+        auto const [end, error] = std::from_chars(range.data(), range.data() + range.size(), first);
+        if (error != std::errc())
+            continue;
+        last = first;
+        if (end != range.data() + range.size() && *end == '-')
+            std::from_chars(end + 1, range.data() + range.size(), last);
+        for (unsigned cpu = first; cpu <= last; ++cpu)
+            result.add(cpu);
+    }
+    return result;
+}
+
+// every node with CPUs, sorted by id
+std::vector<tcx::numa_node> read_numa_nodes()
+{
+    std::vector<tcx::numa_node> nodes;
+    if (DIR *const directory = ::opendir("/sys/devices/system/node")) {
+        while (dirent const *const entry = ::readdir(directory)) {
+            std::string_view const name = entry->d_name;
+            unsigned id = 0;
+            if (!name.starts_with("node") || std::from_chars(name.data() + 4, name.data() + name.size(), id).ec != std::errc())
+                continue;
+            std::ifstream file("/sys/devices/system/node/" + std::string(name) + "/cpulist");
+            std::string list;
+            if (!std::getline(file, list))
+                continue;
+            // memory only nodes have no CPUs to run a worker on
+            if (auto cpus = parse_cpu_list(list); !cpus.empty())
+                nodes.push_back(tcx::numa_node { id, cpus });
+        }
+        ::closedir(directory);
+    }
+    std::sort(nodes.begin(), nodes.end(), [](tcx::numa_node const &a, tcx::numa_node const &b) { return a.id < b.id; });
+    return nodes;
+}
+
+} // namespace
+
+std::vector<unsigned> tcx::cpu_set::cpus() const
+{
+    std::vector<unsigned> result;
+    result.reserve(count());
+    for (unsigned cpu = 0; cpu < CPU_SETSIZE && result.size() != result.capacity(); ++cpu) {
+        if (CPU_ISSET(cpu, &m_set))
+            result.push_back(cpu);
+    }
+    return result;
+}
+
+std::vector<tcx::numa_node> tcx::numa_nodes()
+{
+    auto const affinity = this_thread_affinity();
+    std::vector<numa_node> nodes;
+    for (auto &node : read_numa_nodes()) {
+        if (affinity.has_value())
+            node.cpus = node.cpus & affinity.value();
+        if (!node.cpus.empty())
+            nodes.push_back(std::move(node));
+    }
+
+    if (nodes.empty())
+        nodes.push_back(numa_node { 0, affinity.has_value() ? affinity.value() : cpu_set {} });
+    return nodes;
+}
+
+unsigned tcx::numa_node_of(unsigned cpu)
+{
+    // the CPU's node doesn't depend on which ones the calling thread may run on
+    for (auto const &node : read_numa_nodes()) {
+        if (node.cpus.contains(cpu))
+            return node.id;
+    }
+    return 0;
+}
+
+unsigned tcx::current_cpu() noexcept
+{
+    int const cpu = ::sched_getcpu();
+    return cpu < 0 ? 0 : static_cast<unsigned>(cpu);
+}
+
+tcx::native::result<tcx::cpu_set> tcx::this_thread_affinity() noexcept
+{
+    cpu_set result;
+    if (::sched_getaffinity(0, sizeof(cpu_set_t), &result.native()) < 0)
+        return native::result<cpu_set>::from_error(errno);
+    return native::result<cpu_set>::from_value(result);
+}
+
+tcx::native::result<void> tcx::set_this_thread_affinity(cpu_set const &cpus) noexcept
+{
+    if (::sched_setaffinity(0, sizeof(cpu_set_t), &cpus.native()) < 0)
+        return native::result<void>::from_error(errno);
+    return {};
+}
+
+tcx::native::result<void> tcx::prefer_memory_node(unsigned node) noexcept
+{
+    constexpr unsigned long bits = sizeof(unsigned long) * CHAR_BIT;
+    unsigned long mask[1024 / bits] = {};
+    if (node >= sizeof(mask) * CHAR_BIT)
+        return native::result<void>::from_error(EINVAL);
+    mask[node / bits] = 1ul << (node % bits);
+    // glibc doesn't wrap it, and libnuma isn't worth a dependency for a single call
+    if (::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * CHAR_BIT) < 0)
+        return native::result<void>::from_error(errno);
+    return {};
+}
@@ -0,0 +1,95 @@
+#include <tcx/services/buffer_ring.hpp>
+
+#include <cerrno>
+#include <utility>
+
+#include <sys/mman.h>
+
+tcx::native::result<tcx::buffer_ring> tcx::buffer_ring::create(uring_context_storage &ring, std::uint16_t group, unsigned count, std::size_t size) noexcept
+{
+    if (count == 0 || count > 32768 || (count & (count - 1)) != 0 || size == 0)
+        return native::result<buffer_ring>::from_error(EINVAL);
+
+    buffer_ring created;
+    try {
+        created.m_mutex = std::make_unique<std::mutex>();
+    } catch (std::bad_alloc const &) {
+        return native::result<buffer_ring>::from_error(ENOMEM);
+    }
+    created.m_count = count;
+    created.m_size = size;
+    created.m_group = group;
+
+    // the ring has to be page aligned, the buffers are mapped too so they don't share pages with anything else
+    void *entries = ::mmap(nullptr, count * sizeof(io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (entries == MAP_FAILED)
+        return native::result<buffer_ring>::from_error(errno);
+    created.m_entries = static_cast<io_uring_buf_ring *>(entries);
+    void *buffers = ::mmap(nullptr, count * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers == MAP_FAILED)
+        return native::result<buffer_ring>::from_error(errno);
+    created.m_buffers = static_cast<std::byte *>(buffers);
+
+    io_uring_buf_ring_init(created.m_entries);
+    int const mask = io_uring_buf_ring_mask(count);
+    for (unsigned i = 0; i < count; ++i)
+        io_uring_buf_ring_add(created.m_entries, created.buffer(static_cast<std::uint16_t>(i)), static_cast<unsigned>(size), static_cast<unsigned short>(i), mask, static_cast<int>(i));
+    io_uring_buf_ring_advance(created.m_entries, static_cast<int>(count));
+
+    if (auto const registered = ring.register_buffer_ring(created.m_entries, count, group); registered.has_error())
+        return native::result<buffer_ring>::from_error(registered.error());
+    created.m_ring = &ring;
+    return native::result<buffer_ring>::from_value(std::move(created));
+}
+
+tcx::buffer_ring::buffer_ring(buffer_ring &&other) noexcept
+    : m_ring(std::exchange(other.m_ring, nullptr))
+    , m_entries(std::exchange(other.m_entries, nullptr))
+    , m_buffers(std::exchange(other.m_buffers, nullptr))
+    , m_count(std::exchange(other.m_count, 0))
+    , m_size(std::exchange(other.m_size, 0))
+    , m_group(other.m_group)
+    , m_mutex(std::move(other.m_mutex))
+{
+}
+
+tcx::buffer_ring &tcx::buffer_ring::operator=(buffer_ring &&other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_ring = std::exchange(other.m_ring, nullptr);
+        m_entries = std::exchange(other.m_entries, nullptr);
+        m_buffers = std::exchange(other.m_buffers, nullptr);
+        m_count = std::exchange(other.m_count, 0);
+        m_size = std::exchange(other.m_size, 0);
+        m_group = other.m_group;
+        m_mutex = std::move(other.m_mutex);
+    }
+    return *this;
+}
+
+tcx::buffer_ring::~buffer_ring()
+{
+    release();
+}
+
+void tcx::buffer_ring::recycle(std::uint16_t id) noexcept
+{
+    // the tail is only published by advance, the entry written before it isn't visible to the kernel yet
+    std::lock_guard lock(*m_mutex);
+    io_uring_buf_ring_add(m_entries, buffer(id), static_cast<unsigned>(m_size), id, io_uring_buf_ring_mask(m_count), 0);
+    io_uring_buf_ring_advance(m_entries, 1);
+}
+
+void tcx::buffer_ring::release() noexcept
+{
+    if (m_ring != nullptr)
+        (void)m_ring->unregister_buffer_ring(m_group);
+    if (m_entries != nullptr)
+        ::munmap(m_entries, m_count * sizeof(io_uring_buf));
+    if (m_buffers != nullptr)
+        ::munmap(m_buffers, m_count * m_size);
+    m_ring = nullptr;
+    m_entries = nullptr;
+    m_buffers = nullptr;
+}
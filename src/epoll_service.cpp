@@ -5,36 +5,43 @@ void tcx::epoll_service::poll_remove(int fd)
     if (epoll_ctl(m_handle, EPOLL_CTL_DEL, fd, nullptr) < 0)
         throw std::system_error(errno, std::system_category());
 
+    completion_pointer completion;
     if (data_map::accessor accessor; m_data.find(accessor, fd)) {
-        struct Completion {
-            void (*pfn_invoke)(Completion *self, int);
-            int fd;
-        };
-
-        auto *ptr = reinterpret_cast<Completion *>(accessor->second.get());
-        ptr->pfn_invoke(ptr, -ECANCELED);
+        completion = std::move(accessor->second);
         m_data.erase(accessor);
     }
+    if (completion != nullptr) {
+        m_pending.fetch_sub(1, std::memory_order_relaxed);
+        completion->pfn_invoke(completion.get(), -ECANCELED);
+    }
 }
 
-void tcx::epoll_service::poll()
+std::size_t tcx::epoll_service::poll(int timeout)
 {
-    sigset_t prev {};
-    std::vector<epoll_event> events;
-    int result = epoll_pwait(m_handle, events.data(), events.size(), -1, &prev);
-    if (result < 0)
-        throw std::system_error(errno, std::system_category(), "epoll_pwait");
-    for (auto const &event : events) {
-        struct Completion {
-            void (*pfn_invoke)(Completion *self, int err_nr);
-            int fd;
-        };
+    epoll_event events[64];
+    int const result = epoll_wait(m_handle, events, static_cast<int>(std::size(events)), timeout);
+    if (result < 0) {
+        if (errno == EINTR)
+            return 0;
+        throw std::system_error(errno, std::system_category(), "epoll_wait");
+    }
 
-        auto *ptr = reinterpret_cast<Completion *>(event.data.ptr);
-        ptr->pfn_invoke(ptr, event.events);
-        if (data_map::accessor accessor; m_data.find(accessor, ptr->fd))
+    std::size_t count = 0;
+    for (int i = 0; i < result; ++i) {
+        completion_pointer completion;
+        if (data_map::accessor accessor; m_data.find(accessor, events[i].data.fd)) {
+            completion = std::move(accessor->second);
             m_data.erase(accessor);
+        }
+        // removed while we were waiting
+        if (completion == nullptr)
+            continue;
+
+        m_pending.fetch_sub(1, std::memory_order_relaxed);
+        completion->pfn_invoke(completion.get(), static_cast<std::int32_t>(events[i].events));
+        ++count;
     }
+    return count;
 }
 
 #include <cassert>
@@ -46,4 +53,4 @@ tcx::epoll_service::~epoll_service()
         ::close(m_handle);
         m_handle = invalid_handle;
     }
-}
\ No newline at end of file
+}
@@ -1,27 +1,291 @@
+#include <tcx/dispatch.hpp>
 #include <tcx/synchronized_execution_context.hpp>
 #include <tcx/unsynchronized_execution_context.hpp>
+#include <tcx/utilities/ring_queue.hpp>
 
-std::size_t tcx::unsynchronized_execution_context::run()
+#include <algorithm>
+#include <climits>
+#include <thread>
+#include <utility>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+void cpu_relax() noexcept
 {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+#if defined(__linux__)
+
+static_assert(sizeof(std::atomic_uint32_t) == sizeof(std::uint32_t) && std::atomic_uint32_t::is_always_lock_free);
+
+// blocks while `word` is `expected`, until woken or until the deadline, which like steady_clock is on CLOCK_MONOTONIC
+void futex_wait(std::atomic_uint32_t &word, std::uint32_t expected, std::chrono::steady_clock::time_point const *deadline) noexcept
+{
+    timespec time;
+    if (deadline != nullptr) {
+        auto const since_epoch = deadline->time_since_epoch();
+        auto const seconds = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+        time.tv_sec = static_cast<time_t>(seconds.count());
+        time.tv_nsec = static_cast<long>(std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch - seconds).count());
+    }
+    // EAGAIN, EINTR and ETIMEDOUT all mean the caller has to look again
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG, expected, deadline != nullptr ? &time : nullptr, nullptr, FUTEX_BITSET_MATCH_ANY);
+}
+
+void futex_wake(std::atomic_uint32_t &word, int count) noexcept
+{
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAKE | FUTEX_PRIVATE_FLAG, count);
+}
+
+#else
+
+void futex_wait(std::atomic_uint32_t &word, std::uint32_t expected, std::chrono::steady_clock::time_point const *deadline) noexcept
+{
+    if (deadline == nullptr)
+        word.wait(expected, std::memory_order_relaxed);
+    else if (auto const now = std::chrono::steady_clock::now(); now < *deadline)
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(*deadline - now, std::chrono::milliseconds(1)));
+}
+
+void futex_wake(std::atomic_uint32_t &word, int count) noexcept
+{
+    if (count == 1)
+        word.notify_one();
+    else
+        word.notify_all();
+}
+
+#endif
+
+// handlers posted to an inline_executor too deep in the stack, ran by the outermost one
+thread_local tcx::utilities::ring_queue<tcx::inline_executor::function_storage> deferred;
+
+// the execution context running handlers on this thread
+thread_local void const *current_context = nullptr;
+
+// marks `context` as run by this thread for as long as it's alive
+struct running_guard {
+    explicit running_guard(void const *context) noexcept
+        : previous(std::exchange(current_context, context))
+    {
+    }
+
+    running_guard(running_guard const &) = delete;
+    running_guard &operator=(running_guard const &) = delete;
+
+    ~running_guard()
+    {
+        current_context = previous;
+    }
+
+    void const *previous;
+};
+
+} // namespace
+
+void tcx::inline_executor::defer(function_storage f)
+{
+    deferred.push(std::move(f));
+}
+
+void tcx::inline_executor::run_deferred()
+{
+    while (!deferred.empty()) {
+        auto f = std::move(deferred.front());
+        deferred.pop();
+        impl::dispatch_depth_guard const guard;
+        f();
+    }
+}
+
+bool tcx::unsynchronized_execution_context::running_in_this_thread() const noexcept
+{
+    return current_context == this;
+}
+
+std::size_t tcx::unsynchronized_execution_context::run(std::size_t max_handlers)
+{
+    running_guard const guard(this);
     std::size_t count = 0;
-    while (!m_function_queue.empty()) {
-        auto f = std::move(m_function_queue.front());
-        m_function_queue.pop();
+    while (count < max_handlers && m_pending != 0) {
+        auto &queue = m_lanes[next_lane()];
+        auto f = std::move(queue.front());
+        queue.pop();
+        --m_pending;
         f();
         ++count;
     }
     return count;
 }
 
-std::size_t tcx::synchronized_execution_context::run()
+std::size_t tcx::unsynchronized_execution_context::next_lane() noexcept
+{
+    std::size_t first = 0;
+    while (m_lanes[first].empty())
+        ++first;
+    // every waiting lane after the first one ages, the first of them to pass the limit goes instead
+    for (std::size_t lane = first + 1; lane < m_lanes.size(); ++lane) {
+        if (!m_lanes[lane].empty() && ++m_starved[lane] > m_aging_limit) {
+            m_starved[lane] = 0;
+            return lane;
+        }
+    }
+    m_starved[first] = 0;
+    return first;
+}
+
+std::size_t tcx::unsynchronized_execution_context::run_until(std::chrono::steady_clock::time_point deadline)
 {
+    // reading the clock costs about as much as a small handler
+    constexpr std::size_t handlers_per_check = 16;
+    std::size_t count = 0;
+    while (m_pending != 0) {
+        count += run(handlers_per_check);
+        if (std::chrono::steady_clock::now() >= deadline)
+            break;
+    }
+    return count;
+}
+
+tcx::synchronized_execution_context::synchronized_execution_context(std::size_t lanes, idle_policy policy, std::size_t aging_limit)
+    : m_lane_count(std::max<std::size_t>(lanes, 1))
+    , m_aging_limit(aging_limit)
+    , m_lanes(std::make_unique<oneapi::tbb::concurrent_queue<function_storage>[]>(m_lane_count))
+    , m_starved(std::make_unique<std::atomic_size_t[]>(m_lane_count))
+    , m_policy(policy)
+{
+}
+
+bool tcx::synchronized_execution_context::try_pop(function_storage &f)
+{
+    std::size_t first = 0;
+    while (first < m_lane_count && m_lanes[first].empty())
+        ++first;
+    if (first == m_lane_count)
+        return false;
+    // every waiting lane after the first one ages, the first of them to pass the limit goes instead
+    for (std::size_t lane = first + 1; lane < m_lane_count; ++lane) {
+        if (!m_lanes[lane].empty() && m_starved[lane].fetch_add(1, std::memory_order_relaxed) >= m_aging_limit) {
+            m_starved[lane].store(0, std::memory_order_relaxed);
+            if (m_lanes[lane].try_pop(f))
+                return true;
+        }
+    }
+    // another thread may have emptied the lane since, so every lane is tried in order
+    for (std::size_t lane = first; lane < m_lane_count; ++lane) {
+        if (m_lanes[lane].try_pop(f)) {
+            m_starved[lane].store(0, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool tcx::synchronized_execution_context::empty() const
+{
+    for (std::size_t lane = 0; lane < m_lane_count; ++lane) {
+        if (!m_lanes[lane].empty())
+            return false;
+    }
+    return true;
+}
+
+bool tcx::synchronized_execution_context::running_in_this_thread() const noexcept
+{
+    return current_context == this;
+}
+
+std::size_t tcx::synchronized_execution_context::poll()
+{
+    running_guard const guard(this);
     std::size_t count = 0;
     function_storage f;
     for (;;) {
-        if (!m_function_queue.try_pop(f))
+        if (!try_pop(f))
             break;
         f();
         ++count;
     }
     return count;
-}
\ No newline at end of file
+}
+
+std::size_t tcx::synchronized_execution_context::run()
+{
+    return run(nullptr);
+}
+
+std::size_t tcx::synchronized_execution_context::run(std::chrono::steady_clock::time_point const *deadline)
+{
+    running_guard const guard(this);
+    std::size_t count = 0;
+    function_storage f;
+    while (!m_stopped.load(std::memory_order_relaxed)) {
+        if (try_pop(f)) {
+            f();
+            f = nullptr;
+            ++count;
+            if (deadline != nullptr && std::chrono::steady_clock::now() >= *deadline)
+                break;
+        } else if (!wait(deadline)) {
+            break;
+        }
+    }
+    return count;
+}
+
+// false once the deadline is reached
+bool tcx::synchronized_execution_context::wait(std::chrono::steady_clock::time_point const *deadline)
+{
+    auto const ready = [this] {
+        return !empty() || m_stopped.load(std::memory_order_relaxed);
+    };
+
+    idle_policy const policy = m_policy;
+    for (unsigned i = 0; i < policy.spins; ++i) {
+        if (ready())
+            return true;
+        cpu_relax();
+    }
+    for (unsigned i = 0; i < policy.yields; ++i) {
+        if (ready())
+            return true;
+        if (deadline != nullptr && std::chrono::steady_clock::now() >= *deadline)
+            return false;
+        std::this_thread::yield();
+    }
+
+    std::uint32_t const epoch = m_epoch.load(std::memory_order_acquire);
+    m_parked.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!ready())
+        futex_wait(m_epoch, epoch, deadline);
+    m_parked.fetch_sub(1, std::memory_order_relaxed);
+    return deadline == nullptr || std::chrono::steady_clock::now() < *deadline;
+}
+
+void tcx::synchronized_execution_context::wake_one() noexcept
+{
+    m_epoch.fetch_add(1, std::memory_order_release);
+    futex_wake(m_epoch, 1);
+}
+
+void tcx::synchronized_execution_context::stop() noexcept
+{
+    m_stopped.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_parked.load(std::memory_order_relaxed) != 0) {
+        m_epoch.fetch_add(1, std::memory_order_release);
+        futex_wake(m_epoch, INT_MAX);
+    }
+}
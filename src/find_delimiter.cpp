@@ -0,0 +1,159 @@
+#include <tcx/utilities/find_delimiter.hpp>
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TCX_FIND_DELIMITER_X86 1
+#endif
+
+namespace {
+
+using find_function = std::size_t (*)(unsigned char const *, std::size_t, unsigned char const *, std::size_t) noexcept;
+
+std::size_t find_scalar(unsigned char const *data, std::size_t size, unsigned char const *delimiter, std::size_t delimiter_size) noexcept
+{
+    if (size < delimiter_size)
+        return tcx::utilities::delimiter_not_found;
+    // memchr is vectorized by the C library too, but only looks for one byte
+    std::size_t const end = size - delimiter_size + 1;
+    for (std::size_t i = 0; i < end; ++i) {
+        auto const *const candidate = static_cast<unsigned char const *>(std::memchr(data + i, delimiter[0], end - i));
+        if (!candidate)
+            break;
+        i = static_cast<std::size_t>(candidate - data);
+        if (std::memcmp(candidate + 1, delimiter + 1, delimiter_size - 1) == 0)
+            return i;
+    }
+    return tcx::utilities::delimiter_not_found;
+}
+
+// the candidate positions of the vector are already known to match the first and last bytes
+inline std::size_t match_candidates(unsigned mask, std::size_t offset, unsigned char const *data, unsigned char const *delimiter, std::size_t delimiter_size) noexcept
+{
+    for (; mask != 0; mask &= mask - 1) {
+        std::size_t const i = offset + static_cast<std::size_t>(__builtin_ctz(mask));
+        if (delimiter_size <= 2 || std::memcmp(data + i + 1, delimiter + 1, delimiter_size - 2) == 0)
+            return i;
+    }
+    return tcx::utilities::delimiter_not_found;
+}
+
+inline std::size_t find_tail(std::size_t offset, unsigned char const *data, std::size_t size, unsigned char const *delimiter, std::size_t delimiter_size) noexcept
+{
+    std::size_t const found = find_scalar(data + offset, size - offset, delimiter, delimiter_size);
+    return found == tcx::utilities::delimiter_not_found ? found : offset + found;
+}
+
+#if TCX_FIND_DELIMITER_X86
+
+// only SSE2, which every x86-64 CPU has
+__attribute__((target("sse2"))) std::size_t find_sse2(unsigned char const *data, std::size_t size, unsigned char const *delimiter, std::size_t delimiter_size) noexcept
+{
+    if (size < delimiter_size)
+        return tcx::utilities::delimiter_not_found;
+    std::size_t const last = delimiter_size - 1;
+    std::size_t const end = size - last; // candidate positions are [0; end)
+    __m128i const first_byte = _mm_set1_epi8(static_cast<char>(delimiter[0]));
+    __m128i const last_byte = _mm_set1_epi8(static_cast<char>(delimiter[last]));
+
+    std::size_t i = 0;
+    for (; i + 16 <= end; i += 16) {
+        __m128i const firsts = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + i));
+        __m128i const lasts = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + i + last));
+        auto const mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(firsts, first_byte), _mm_cmpeq_epi8(lasts, last_byte))));
+        if (mask == 0)
+            continue;
+        if (std::size_t const found = match_candidates(mask, i, data, delimiter, delimiter_size); found != tcx::utilities::delimiter_not_found)
+            return found;
+    }
+    return find_tail(i, data, size, delimiter, delimiter_size);
+}
+
+__attribute__((target("avx2"))) std::size_t find_avx2(unsigned char const *data, std::size_t size, unsigned char const *delimiter, std::size_t delimiter_size) noexcept
+{
+    if (size < delimiter_size)
+        return tcx::utilities::delimiter_not_found;
+    std::size_t const last = delimiter_size - 1;
+    std::size_t const end = size - last;
+    __m256i const first_byte = _mm256_set1_epi8(static_cast<char>(delimiter[0]));
+    __m256i const last_byte = _mm256_set1_epi8(static_cast<char>(delimiter[last]));
+
+    std::size_t i = 0;
+    for (; i + 32 <= end; i += 32) {
+        __m256i const firsts = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(data + i));
+        __m256i const lasts = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(data + i + last));
+        auto const mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(firsts, first_byte), _mm256_cmpeq_epi8(lasts, last_byte))));
+        if (mask == 0)
+            continue;
+        if (std::size_t const found = match_candidates(mask, i, data, delimiter, delimiter_size); found != tcx::utilities::delimiter_not_found)
+            return found;
+    }
+    return find_tail(i, data, size, delimiter, delimiter_size);
+}
+
+#endif
+
+tcx::utilities::find_delimiter_isa detect() noexcept
+{
+#if TCX_FIND_DELIMITER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return tcx::utilities::find_delimiter_isa::avx2;
+#if defined(__x86_64__)
+    return tcx::utilities::find_delimiter_isa::sse2;
+#else
+    if (__builtin_cpu_supports("sse2"))
+        return tcx::utilities::find_delimiter_isa::sse2;
+#endif
+#endif
+    return tcx::utilities::find_delimiter_isa::scalar;
+}
+
+find_function implementation(tcx::utilities::find_delimiter_isa isa) noexcept
+{
+    switch (isa) {
+#if TCX_FIND_DELIMITER_X86
+    case tcx::utilities::find_delimiter_isa::avx2:
+        return find_avx2;
+    case tcx::utilities::find_delimiter_isa::sse2:
+        return find_sse2;
+#endif
+    default:
+        return find_scalar;
+    }
+}
+
+// the C library dispatches memchr to the widest vectors already, it's as fast as a loop of our own
+std::size_t find_byte(void const *data, std::size_t size, void const *delimiter, std::size_t delimiter_size) noexcept
+{
+    if (delimiter_size == 0)
+        return 0;
+    if (size == 0)
+        return tcx::utilities::delimiter_not_found;
+    auto const *const found = static_cast<unsigned char const *>(std::memchr(data, *static_cast<unsigned char const *>(delimiter), size));
+    return found ? static_cast<std::size_t>(found - static_cast<unsigned char const *>(data)) : tcx::utilities::delimiter_not_found;
+}
+
+} // namespace
+
+tcx::utilities::find_delimiter_isa tcx::utilities::find_delimiter_dispatch() noexcept
+{
+    static find_delimiter_isa const isa = detect();
+    return isa;
+}
+
+std::size_t tcx::utilities::find_delimiter(void const *data, std::size_t size, void const *delimiter, std::size_t delimiter_size) noexcept
+{
+    static find_function const function = implementation(find_delimiter_dispatch());
+    if (delimiter_size <= 1)
+        return find_byte(data, size, delimiter, delimiter_size);
+    return function(static_cast<unsigned char const *>(data), size, static_cast<unsigned char const *>(delimiter), delimiter_size);
+}
+
+std::size_t tcx::utilities::find_delimiter(find_delimiter_isa isa, void const *data, std::size_t size, void const *delimiter, std::size_t delimiter_size) noexcept
+{
+    if (delimiter_size <= 1)
+        return find_byte(data, size, delimiter, delimiter_size);
+    return implementation(isa)(static_cast<unsigned char const *>(data), size, static_cast<unsigned char const *>(delimiter), delimiter_size);
+}
@@ -0,0 +1,180 @@
+#include <tcx/io_context.hpp>
+
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+
+thread_local tcx::io_context const *current_context = nullptr;
+
+// marks the context as run by this thread for as long as it's alive
+struct running_guard {
+    explicit running_guard(tcx::io_context const *context) noexcept
+        : previous(std::exchange(current_context, context))
+    {
+    }
+
+    running_guard(running_guard const &) = delete;
+    running_guard &operator=(running_guard const &) = delete;
+
+    ~running_guard()
+    {
+        current_context = previous;
+    }
+
+    tcx::io_context const *previous;
+};
+
+} // namespace
+
+tcx::io_context::io_context(service_type ring, std::size_t lanes, std::size_t aging_limit)
+    : m_ring(std::move(ring))
+    , m_local(lanes, aging_limit)
+    , m_wakeup_fd(::eventfd(0, EFD_CLOEXEC))
+{
+    if (m_wakeup_fd < 0)
+        throw std::system_error(errno, std::system_category(), "eventfd");
+    try {
+        arm_wakeup();
+    } catch (...) {
+        ::close(m_wakeup_fd);
+        throw;
+    }
+}
+
+tcx::io_context::~io_context()
+{
+    if (m_wakeup_armed.raised()) {
+        bool cancelled = false;
+        if (m_ring.async_cancel_fd(m_wakeup_fd, 0, [&cancelled](service_type &, io_uring_cqe const *) { cancelled = true; }).has_error())
+            cancelled = true;
+        while (m_wakeup_armed.raised() || !cancelled) {
+            if (m_ring.run_once(1).has_error())
+                break;
+        }
+    }
+    ::close(m_wakeup_fd);
+
+    // anything posted by completions reaped while closing is dropped too
+    for (auto *handler = m_remote.exchange(nullptr, std::memory_order_acquire); handler != nullptr;)
+        delete std::exchange(handler, handler->next);
+}
+
+bool tcx::io_context::running_in_this_thread() const noexcept
+{
+    return current_context == this;
+}
+
+std::size_t tcx::io_context::run()
+{
+    running_guard const guard(this);
+    std::size_t count = 0;
+    while (!stopped()) {
+        take_remote();
+        count += m_local.run();
+        if (m_local.pending() != 0 || m_remote.load(std::memory_order_relaxed) != nullptr) {
+            // more handlers are ready, the completions are reaped without waiting and the next batch runs
+            reap(0);
+            continue;
+        }
+        if (!has_operations() && m_work.load(std::memory_order_relaxed) == 0)
+            break;
+
+        m_sleeping.store(true, std::memory_order_relaxed);
+        // pairs with the fence in post_remote() and release_work(), either they see the loop sleeping or the loop sees what they did
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_remote.load(std::memory_order_relaxed) == nullptr && !stopped() && (has_operations() || m_work.load(std::memory_order_relaxed) != 0))
+            reap(1);
+        m_sleeping.store(false, std::memory_order_relaxed);
+    }
+    return count;
+}
+
+std::size_t tcx::io_context::poll()
+{
+    running_guard const guard(this);
+    take_remote();
+    std::size_t const count = m_local.run();
+    reap(0);
+    return count;
+}
+
+void tcx::io_context::stop() noexcept
+{
+    m_stopped.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_relaxed) && m_sleeping.exchange(false, std::memory_order_relaxed))
+        wake();
+}
+
+void tcx::io_context::release_work() noexcept
+{
+    if (m_work.fetch_sub(1, std::memory_order_relaxed) != 1)
+        return;
+    // the loop may be sleeping only because of the guard
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_relaxed) && m_sleeping.exchange(false, std::memory_order_relaxed))
+        wake();
+}
+
+void tcx::io_context::post_remote(remote_handler *handler) noexcept
+{
+    handler->next = m_remote.load(std::memory_order_relaxed);
+    while (!m_remote.compare_exchange_weak(handler->next, handler, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // only one of the posters racing a sleeping loop writes to the eventfd
+    if (m_sleeping.load(std::memory_order_relaxed) && m_sleeping.exchange(false, std::memory_order_relaxed))
+        wake();
+}
+
+void tcx::io_context::take_remote()
+{
+    auto *handler = m_remote.exchange(nullptr, std::memory_order_acquire);
+    if (handler == nullptr)
+        return;
+
+    // the list is newest first
+    remote_handler *ordered = nullptr;
+    while (handler != nullptr) {
+        auto *const next = handler->next;
+        handler->next = ordered;
+        ordered = handler;
+        handler = next;
+    }
+    while (ordered != nullptr) {
+        m_local.post(ordered->priority, std::move(ordered->f));
+        delete std::exchange(ordered, ordered->next);
+    }
+}
+
+void tcx::io_context::reap(std::uint32_t wait_nr)
+{
+    if (auto const result = m_ring.run_once(wait_nr); result.has_error())
+        throw std::system_error(result.error(), std::system_category(), "io_uring_submit_and_wait");
+    if (!m_wakeup_armed.raised())
+        arm_wakeup();
+}
+
+void tcx::io_context::arm_wakeup()
+{
+    io_uring_sqe op {};
+    io_uring_prep_read(&op, m_wakeup_fd, &m_wakeup_value, sizeof(m_wakeup_value), 0);
+    if (auto const result = m_ring.submit_flagged(&op, m_wakeup_armed); result.has_error())
+        throw std::system_error(result.error(), std::system_category(), "io_uring_get_sqe");
+}
+
+void tcx::io_context::wake() noexcept
+{
+    std::uint64_t const one = 1;
+    (void)::write(m_wakeup_fd, &one, sizeof(one));
+}
+
+bool tcx::io_context::has_operations() const noexcept
+{
+    return m_ring.pending() > (m_wakeup_armed.raised() ? 1u : 0u);
+}
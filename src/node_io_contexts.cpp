@@ -0,0 +1,81 @@
+#include <tcx/node_io_contexts.hpp>
+
+#include <future>
+#include <system_error>
+#include <utility>
+
+tcx::node_io_contexts::node_io_contexts(std::uint32_t entries, io_uring_params const &params)
+{
+    // only the CPUs this thread may run on, a node outside of it's cpuset gets no context
+    auto nodes = numa_nodes();
+    m_nodes.reserve(nodes.size());
+    try {
+        for (auto &node : nodes) {
+            auto &current = m_nodes.emplace_back(per_node { std::move(node), nullptr, {} });
+            std::promise<void> ready;
+            auto created = ready.get_future();
+            current.thread = std::thread([&current, entries, params, ready = std::move(ready)]() mutable {
+                try {
+                    if (auto const result = set_this_thread_affinity(current.node.cpus); result.has_error())
+                        throw std::system_error(result.error(), std::system_category(), "sched_setaffinity");
+                    // without NUMA support there's nothing to prefer, so it failing doesn't matter
+                    (void)prefer_memory_node(current.node.id);
+
+                    io_uring_params node_params = params;
+                    if (node_params.flags & IORING_SETUP_SQPOLL) {
+                        node_params.flags |= IORING_SETUP_SQ_AFF;
+                        node_params.sq_thread_cpu = current.node.cpus.cpus().front();
+                    }
+                    auto ring = unsynchronized_uring_context<>::create(entries, &node_params);
+                    if (ring.has_error())
+                        throw std::system_error(ring.error(), std::system_category(), "io_uring_queue_init_params");
+                    // older kernels don't have it, the workers then run anywhere
+                    (void)ring.value().register_iowq_affinity(current.node.cpus);
+                    current.context = std::make_unique<io_context>(std::move(ring).value());
+                } catch (...) {
+                    ready.set_exception(std::current_exception());
+                    return;
+                }
+
+                io_context::work_guard const guard(*current.context);
+                ready.set_value();
+                current.context->run();
+            });
+            created.get();
+        }
+    } catch (...) {
+        stop();
+        for (auto &node : m_nodes) {
+            if (node.thread.joinable())
+                node.thread.join();
+        }
+        throw;
+    }
+}
+
+tcx::node_io_contexts::~node_io_contexts()
+{
+    stop();
+    for (auto &node : m_nodes) {
+        if (node.thread.joinable())
+            node.thread.join();
+    }
+}
+
+tcx::io_context &tcx::node_io_contexts::nearest() noexcept
+{
+    unsigned const cpu = current_cpu();
+    for (auto &node : m_nodes) {
+        if (node.node.cpus.contains(cpu))
+            return *node.context;
+    }
+    return *m_nodes.front().context;
+}
+
+void tcx::node_io_contexts::stop() noexcept
+{
+    for (auto &node : m_nodes) {
+        if (node.context)
+            node.context->stop();
+    }
+}
@@ -0,0 +1,60 @@
+#include <tcx/pipe_pool.hpp>
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+tcx::pipe_pool::~pipe_pool()
+{
+    for (auto &idle : m_idle)
+        close(idle);
+}
+
+tcx::native::result<tcx::pipe_pool::pipe> tcx::pipe_pool::acquire() noexcept
+{
+    {
+        std::lock_guard lock(m_mutex);
+        if (!m_idle.empty()) {
+            pipe const acquired = m_idle.back();
+            m_idle.pop_back();
+            return native::result<pipe>::from_value(acquired);
+        }
+    }
+
+    int fds[2];
+    if (::pipe2(fds, O_CLOEXEC | O_NONBLOCK) < 0)
+        return native::result<pipe>::from_error(errno);
+    if (m_pipe_size != 0)
+        (void)::fcntl(fds[1], F_SETPIPE_SZ, static_cast<int>(m_pipe_size)); // a smaller pipe still works
+    int const capacity = ::fcntl(fds[1], F_GETPIPE_SZ);
+    return native::result<pipe>::from_value(pipe { .read = fds[0], .write = fds[1], .capacity = capacity > 0 ? static_cast<std::size_t>(capacity) : 4096u });
+}
+
+void tcx::pipe_pool::release(pipe released, bool empty) noexcept
+{
+    if (empty) {
+        std::lock_guard lock(m_mutex);
+        if (m_idle.size() < m_max_idle) {
+            try {
+                m_idle.push_back(released);
+                return;
+            } catch (...) {
+            }
+        }
+    }
+    close(released);
+}
+
+tcx::pipe_pool &tcx::pipe_pool::shared() noexcept
+{
+    static pipe_pool pool;
+    return pool;
+}
+
+void tcx::pipe_pool::close(pipe &closed) noexcept
+{
+    ::close(closed.read);
+    ::close(closed.write);
+    closed = pipe {};
+}
@@ -0,0 +1,258 @@
+#include <tcx/thread_pool.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <optional>
+#include <system_error>
+#include <utility>
+
+#include <pthread.h>
+
+namespace {
+
+// consecutive handlers taken from the LIFO slot before letting the older ones run, so two handlers posting each other can't starve them
+constexpr unsigned max_lifo_streak = 3;
+// every this many handlers a worker looks at the shared queue and the oldest of it's own first
+constexpr unsigned fairness_interval = 61;
+
+} // namespace
+
+struct tcx::thread_pool::worker {
+    impl::work_stealing_deque<function_storage> deque;
+    // the handler posted last by this worker, only this worker touches it
+    function_storage *lifo = nullptr;
+    unsigned lifo_streak = 0;
+    unsigned tick = 0;
+    std::uint64_t random = 0;
+    std::thread thread;
+};
+
+namespace {
+
+thread_local tcx::thread_pool const *current_pool = nullptr;
+// the worker of current_pool running on this thread
+thread_local void *current_worker = nullptr;
+
+} // namespace
+
+tcx::thread_pool::thread_pool(std::size_t threads)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    start(std::vector<cpu_set>(threads));
+}
+
+tcx::thread_pool::thread_pool(tcx::cpu_set const &cpus)
+{
+    std::vector<cpu_set> affinities;
+    for (unsigned const cpu : cpus.cpus())
+        affinities.push_back(cpu_set { cpu });
+    start(affinities);
+}
+
+tcx::thread_pool::thread_pool(std::span<tcx::cpu_set const> affinities)
+{
+    start(affinities);
+}
+
+// an empty set leaves the worker unpinned
+void tcx::thread_pool::start(std::span<tcx::cpu_set const> affinities)
+{
+    cpu_set const unpinned;
+    if (affinities.empty())
+        affinities = std::span<cpu_set const>(&unpinned, 1);
+
+    std::vector<numa_node> nodes;
+    if (std::any_of(affinities.begin(), affinities.end(), [](cpu_set const &cpus) { return !cpus.empty(); }))
+        nodes = numa_nodes();
+    // the node all of the CPUs are on, if there's one
+    auto const node_of = [&nodes](cpu_set const &cpus) -> std::optional<unsigned> {
+        for (auto const &node : nodes) {
+            auto const all = cpus.cpus();
+            if (!all.empty() && std::all_of(all.begin(), all.end(), [&node](unsigned cpu) { return node.cpus.contains(cpu); }))
+                return node.id;
+        }
+        return std::nullopt;
+    };
+
+    m_workers.reserve(affinities.size());
+    for (std::size_t i = 0; i < affinities.size(); ++i) {
+        m_workers.push_back(std::make_unique<worker>());
+        m_workers.back()->random = 0x9e3779b97f4a7c15ull * (i + 1);
+    }
+    // every deque exists before any worker can try to steal from it
+    for (std::size_t i = 0; i < affinities.size(); ++i) {
+        auto &w = *m_workers[i];
+        w.thread = std::thread([this, &w, node = node_of(affinities[i])] {
+            // without NUMA support there's nothing to prefer, so it failing doesn't matter
+            if (node)
+                (void)prefer_memory_node(*node);
+            work(w);
+        });
+        if (affinities[i].empty())
+            continue;
+        if (int const error = ::pthread_setaffinity_np(w.thread.native_handle(), sizeof(cpu_set_t), &affinities[i].native()); error != 0) {
+            stop();
+            throw std::system_error(error, std::system_category(), "pthread_setaffinity_np");
+        }
+    }
+}
+
+tcx::thread_pool::~thread_pool()
+{
+    stop();
+}
+
+bool tcx::thread_pool::running_in_this_thread() const noexcept
+{
+    return current_pool == this;
+}
+
+void tcx::thread_pool::stop() noexcept
+{
+    if (m_stopping.exchange(true))
+        return;
+    m_epoch.fetch_add(1, std::memory_order_release);
+    m_epoch.notify_all();
+    for (auto &w : m_workers) {
+        if (w->thread.joinable())
+            w->thread.join();
+    }
+
+    for (auto &w : m_workers) {
+        delete std::exchange(w->lifo, nullptr);
+        while (auto *task = w->deque.pop())
+            delete task;
+    }
+    std::lock_guard lock(m_injected_mutex);
+    for (auto *task : m_injected)
+        delete task;
+    m_injected.clear();
+    m_injected_size.store(0, std::memory_order_relaxed);
+}
+
+void tcx::thread_pool::schedule(function_storage *task)
+{
+    if (current_pool == this) {
+        auto &self = *static_cast<worker *>(current_worker);
+        if (self.lifo == nullptr) {
+            // nobody else can take it from the slot, so there's nobody to wake either
+            self.lifo = task;
+            return;
+        }
+        self.deque.push(std::exchange(self.lifo, task));
+    } else {
+        {
+            std::lock_guard lock(m_injected_mutex);
+            m_injected.push_back(task);
+        }
+        m_injected_size.fetch_add(1, std::memory_order_relaxed);
+    }
+    wake_one();
+}
+
+void tcx::thread_pool::wake_one() noexcept
+{
+    // pairs with the fence of a worker going to sleep, either it sees the handler or we see it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_relaxed) != 0) {
+        m_epoch.fetch_add(1, std::memory_order_release);
+        m_epoch.notify_one();
+    }
+}
+
+void tcx::thread_pool::work(worker &self)
+{
+    current_pool = this;
+    current_worker = &self;
+
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+        if (auto *task = find(self)) {
+            (*task)();
+            delete task;
+            continue;
+        }
+
+        auto const epoch = m_epoch.load(std::memory_order_acquire);
+        m_sleeping.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto *task = m_stopping.load(std::memory_order_relaxed) ? nullptr : find(self);
+        if (task == nullptr && !m_stopping.load(std::memory_order_relaxed))
+            m_epoch.wait(epoch, std::memory_order_acquire);
+        m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+        if (task != nullptr) {
+            // somebody may have posted more while this one was going to sleep
+            wake_one();
+            (*task)();
+            delete task;
+        }
+    }
+
+    current_pool = nullptr;
+    current_worker = nullptr;
+}
+
+tcx::thread_pool::function_storage *tcx::thread_pool::find(worker &self)
+{
+    if (self.lifo != nullptr) {
+        if (self.lifo_streak < max_lifo_streak) {
+            ++self.lifo_streak;
+            return std::exchange(self.lifo, nullptr);
+        }
+        // the oldest runs instead, popping would just give the same one back
+        self.lifo_streak = 0;
+        self.deque.push(std::exchange(self.lifo, nullptr));
+        if (auto *task = self.deque.steal())
+            return task;
+    }
+    self.lifo_streak = 0;
+
+    if (++self.tick % fairness_interval == 0) {
+        if (auto *task = take_injected())
+            return task;
+        if (auto *task = self.deque.steal())
+            return task;
+    }
+    if (auto *task = self.deque.pop())
+        return task;
+    if (auto *task = take_injected())
+        return task;
+    return steal(self);
+}
+
+tcx::thread_pool::function_storage *tcx::thread_pool::steal(worker &self)
+{
+    std::size_t const count = m_workers.size();
+    if (count < 2)
+        return nullptr;
+
+    // xorshift64
+    self.random ^= self.random << 13;
+    self.random ^= self.random >> 7;
+    self.random ^= self.random << 17;
+    std::size_t const start = self.random % count;
+    for (std::size_t i = 0; i < count; ++i) {
+        auto &victim = *m_workers[(start + i) % count];
+        if (&victim == &self)
+            continue;
+        // losing a race to another thief doesn't mean it's empty
+        while (!victim.deque.empty()) {
+            if (auto *task = victim.deque.steal())
+                return task;
+        }
+    }
+    return nullptr;
+}
+
+tcx::thread_pool::function_storage *tcx::thread_pool::take_injected()
+{
+    if (m_injected_size.load(std::memory_order_relaxed) == 0)
+        return nullptr;
+    std::lock_guard lock(m_injected_mutex);
+    if (m_injected.empty())
+        return nullptr;
+    auto *const task = m_injected.front();
+    m_injected.pop_front();
+    m_injected_size.fetch_sub(1, std::memory_order_relaxed);
+    return task;
+}
@@ -0,0 +1,157 @@
+#include <tcx/trace.hpp>
+
+#include <algorithm>
+#include <cinttypes>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+// buffers outlive their threads, so that the events of finished threads can still be exported
+struct registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<tcx::trace::impl::thread_buffer>> buffers;
+};
+
+registry &get_registry()
+{
+    static registry instance;
+    return instance;
+}
+
+// copies the events that weren't overwritten, oldest first
+std::vector<tcx::trace::event> copy_events(tcx::trace::impl::thread_buffer const &buffer)
+{
+    constexpr auto size = tcx::trace::buffer_size;
+    std::uint64_t const head = buffer.head.load(std::memory_order_acquire);
+    std::uint64_t first = head > size ? head - size : 0;
+
+    std::vector<tcx::trace::event> result;
+    result.reserve(static_cast<std::size_t>(head - first));
+    for (std::uint64_t i = first; i < head; ++i)
+        result.push_back(buffer.events[i & (size - 1)]);
+
+    // anything the thread wrote meanwhile may have overwritten the oldest copied events
+    std::uint64_t const new_head = buffer.head.load(std::memory_order_acquire);
+    std::uint64_t const new_first = new_head > size ? new_head - size : 0;
+    if (new_first > first)
+        result.erase(result.begin(), result.begin() + static_cast<std::ptrdiff_t>(std::min(new_first - first, head - first)));
+    return result;
+}
+
+struct writer {
+    std::FILE *file;
+    long pid;
+    std::uint64_t epoch;
+    bool first = true;
+
+    void begin_event()
+    {
+        std::fputs(first ? "\n" : ",\n", file);
+        first = false;
+    }
+
+    void write(char const *name, char const *category, char phase, std::uint32_t tid, tcx::trace::event const &e)
+    {
+        begin_event();
+        std::fprintf(file, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"pid\":%ld,\"tid\":%" PRIu32 ",", name, category, phase, pid, tid);
+        std::fprintf(file, "\"ts\":%" PRIu64 ".%03u,\"id\":\"0x%" PRIx64 "\"", (e.timestamp - epoch) / 1000, static_cast<unsigned>((e.timestamp - epoch) % 1000), e.id);
+    }
+
+    void write(tcx::trace::event const &e, std::uint32_t tid)
+    {
+        using tcx::trace::event_type;
+        switch (e.type) {
+        case event_type::submit:
+            write("in flight", "io_uring", 'b', tid, e);
+            std::fprintf(file, ",\"args\":{\"opcode\":%" PRId64 "}}", e.value);
+            break;
+        case event_type::complete:
+            // a multishot operation keeps going until it's last completion
+            write(e.flags & 2u /* IORING_CQE_F_MORE */ ? "completion" : "in flight", "io_uring", e.flags & 2u ? 'n' : 'e', tid, e);
+            std::fprintf(file, ",\"args\":{\"res\":%" PRId64 ",\"flags\":%" PRIu32 "}}", e.value, e.flags);
+            break;
+        case event_type::post:
+            write("queued", "executor", 'b', tid, e);
+            std::fputc('}', file);
+            break;
+        case event_type::handler_begin:
+            write("queued", "executor", 'e', tid, e);
+            std::fputc('}', file);
+            write("handler", "executor", 'b', tid, e);
+            std::fputc('}', file);
+            break;
+        case event_type::handler_end:
+            write("handler", "executor", 'e', tid, e);
+            std::fputc('}', file);
+            break;
+        case event_type::enter_begin:
+            write("io_uring_enter", "io_uring", 'B', tid, e);
+            std::fprintf(file, ",\"args\":{\"ready\":%" PRId64 "}}", e.value);
+            break;
+        case event_type::enter_end:
+            write("io_uring_enter", "io_uring", 'E', tid, e);
+            std::fprintf(file, ",\"args\":{\"result\":%" PRId64 "}}", e.value);
+            break;
+        }
+    }
+};
+
+} // namespace
+
+tcx::trace::impl::thread_buffer *tcx::trace::impl::register_thread()
+{
+    auto &instance = get_registry();
+    std::unique_ptr<thread_buffer> buffer(new (std::nothrow) thread_buffer);
+    if (buffer == nullptr)
+        return nullptr;
+
+    std::unique_lock lock(instance.mutex);
+    try {
+        buffer->thread_index = static_cast<std::uint32_t>(instance.buffers.size());
+        instance.buffers.push_back(std::move(buffer));
+    } catch (std::bad_alloc const &) {
+        return nullptr;
+    }
+    return local_buffer = instance.buffers.back().get();
+}
+
+bool tcx::trace::write_chrome_trace(std::FILE *file)
+{
+    auto &instance = get_registry();
+    std::unique_lock lock(instance.mutex);
+
+    std::vector<std::vector<event>> events;
+    events.reserve(instance.buffers.size());
+    std::uint64_t epoch = std::numeric_limits<std::uint64_t>::max();
+    for (auto const &buffer : instance.buffers) {
+        events.push_back(copy_events(*buffer));
+        if (!events.back().empty())
+            epoch = std::min(epoch, events.back().front().timestamp);
+    }
+
+    writer out { file, static_cast<long>(::getpid()), epoch };
+    std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        std::uint32_t const tid = instance.buffers[i]->thread_index;
+        out.begin_event();
+        std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%" PRIu32 ",\"args\":{\"name\":\"tcx thread %" PRIu32 "\"}}", out.pid, tid, tid);
+        for (auto const &e : events[i])
+            out.write(e, tid);
+    }
+    std::fputs("\n]}\n", file);
+    return std::fflush(file) == 0 && !std::ferror(file);
+}
+
+void tcx::trace::clear() noexcept
+{
+    auto &instance = get_registry();
+    std::unique_lock lock(instance.mutex);
+    for (auto &buffer : instance.buffers)
+        buffer->head.store(0, std::memory_order_relaxed);
+}
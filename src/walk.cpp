@@ -0,0 +1,200 @@
+#include <tcx/async/ioring/walk.hpp>
+
+#include <algorithm>
+
+#include <dirent.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+
+// names handed to the ring at once
+constexpr std::size_t batch_names = 128;
+
+bool is_dot_or_dot_dot(char const *name) noexcept
+{
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+} // namespace
+
+tcx::impl::walk_directory::~walk_directory()
+{
+    if (fd >= 0)
+        ::close(fd);
+    readers.directory_closed();
+}
+
+tcx::impl::walk_readers::walk_readers(walk_options const &options)
+    : event_fd(::eventfd(0, EFD_CLOEXEC))
+    , m_max_ready_names(std::max<std::size_t>(options.max_in_flight * 4, batch_names))
+    , m_max_open_directories(std::max<std::size_t>(options.max_open_directories, 1))
+{
+    if (event_fd < 0)
+        throw std::system_error(errno, std::system_category(), "eventfd");
+
+    try {
+        for (std::size_t i = 0; i < std::max<std::size_t>(options.readers, 1); ++i)
+            m_threads.emplace_back([this] { run(); });
+    } catch (...) {
+        close();
+        throw;
+    }
+}
+
+tcx::impl::walk_readers::~walk_readers()
+{
+    close();
+}
+
+void tcx::impl::walk_readers::close() noexcept
+{
+    {
+        std::lock_guard lock(mutex);
+        m_closing = true;
+    }
+    m_jobs_cv.notify_all();
+    m_space_cv.notify_all();
+    for (auto &thread : m_threads)
+        thread.join();
+    m_threads.clear();
+
+    // releasing the batches may close directories, which takes the lock
+    auto ready = std::move(m_ready);
+    ready.clear();
+    if (event_fd >= 0)
+        ::close(event_fd);
+    event_fd = -1;
+}
+
+void tcx::impl::walk_readers::push(std::string path, std::size_t depth)
+{
+    m_jobs.emplace_back(std::move(path), depth);
+    m_jobs_cv.notify_one();
+}
+
+void tcx::impl::walk_readers::take(std::deque<std::shared_ptr<walk_batch>> &into)
+{
+    for (auto &batch : m_ready)
+        into.push_back(std::move(batch));
+    m_ready.clear();
+    m_ready_names = 0;
+    m_space_cv.notify_all();
+}
+
+void tcx::impl::walk_readers::abandon()
+{
+    m_abandoned = true;
+
+    // every directory that was pushed is answered with a last batch
+    for (std::size_t i = 0; i < m_jobs.size(); ++i) {
+        auto batch = std::make_shared<walk_batch>();
+        batch->last = true;
+        m_ready.push_back(std::move(batch));
+    }
+    if (!m_jobs.empty())
+        signal();
+    m_jobs.clear();
+    m_space_cv.notify_all();
+}
+
+void tcx::impl::walk_readers::directory_closed() noexcept
+{
+    {
+        std::lock_guard lock(mutex);
+        --m_open_directories;
+    }
+    m_space_cv.notify_all();
+}
+
+void tcx::impl::walk_readers::signal() noexcept
+{
+    std::uint64_t const one = 1;
+    [[maybe_unused]] auto const written = ::write(event_fd, &one, sizeof(one));
+}
+
+void tcx::impl::walk_readers::run()
+{
+    for (;;) {
+        std::unique_lock lock(mutex);
+        m_jobs_cv.wait(lock, [this] { return !m_jobs.empty() || m_closing; });
+        if (m_closing)
+            return;
+        auto [path, depth] = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        lock.unlock();
+
+        read(std::move(path), depth);
+    }
+}
+
+void tcx::impl::walk_readers::read(std::string path, std::size_t depth)
+{
+    {
+        std::unique_lock lock(mutex);
+        m_space_cv.wait(lock, [this] { return m_open_directories < m_max_open_directories || m_abandoned || m_closing; });
+        ++m_open_directories;
+    }
+    auto directory = std::make_shared<walk_directory>(*this, std::move(path), depth);
+
+    auto batch = std::make_shared<walk_batch>();
+    batch->directory = directory;
+
+    bool abandoned = false;
+    if (!m_abandoned)
+        directory->fd = ::open(directory->path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directory->fd < 0) {
+        if (!m_abandoned)
+            batch->error = std::error_code(errno, std::system_category());
+        batch->last = true;
+        deliver(std::move(batch));
+        return;
+    }
+
+    alignas(::dirent64) char buffer[32 * 1024];
+    while (!abandoned) {
+        auto const read = ::getdents64(directory->fd, buffer, sizeof(buffer));
+        if (read < 0) {
+            batch->error = std::error_code(errno, std::system_category());
+            break;
+        }
+        if (read == 0)
+            break;
+
+        for (std::size_t offset = 0; offset < static_cast<std::size_t>(read);) {
+            auto const *const entry = reinterpret_cast<::dirent64 const *>(buffer + offset);
+            offset += entry->d_reclen;
+            if (is_dot_or_dot_dot(entry->d_name))
+                continue;
+
+            batch->offsets.push_back(static_cast<std::uint32_t>(batch->names.size()));
+            batch->names.append(entry->d_name);
+            batch->names.push_back('\0');
+            if (batch->offsets.size() == batch_names) {
+                abandoned = !deliver(std::exchange(batch, std::make_shared<walk_batch>()));
+                batch->directory = directory;
+                if (abandoned)
+                    break;
+            }
+        }
+    }
+
+    batch->last = true;
+    directory.reset();
+    deliver(std::move(batch));
+}
+
+bool tcx::impl::walk_readers::deliver(std::shared_ptr<walk_batch> batch)
+{
+    bool abandoned;
+    {
+        std::unique_lock lock(mutex);
+        m_space_cv.wait(lock, [this] { return m_ready_names < m_max_ready_names || m_abandoned || m_closing; });
+        m_ready_names += batch->offsets.size();
+        m_ready.push_back(std::move(batch));
+        abandoned = m_abandoned || m_closing;
+    }
+
+    signal();
+    return !abandoned;
+}